@@ -0,0 +1,183 @@
+// Micro-benchmarks for the portable firmware core.
+// Prints nanoseconds per event (or per operation) for each stage so that
+// firmware changes can be compared on a Linux host.
+
+#include "hid_port_host.h"
+#include "hid_server.h"
+#include "keymap_table.h"
+#include "packet_parser.h"
+#include "packet_queue.h"
+#include "hid_proto.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_ITERATIONS 200000
+
+static volatile uint32_t sink;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void report(const char *name, uint64_t elapsed_ns, uint64_t ops) {
+    printf("%-28s %8.1f ns/op  (%llu ops)\n", name,
+           (double)elapsed_ns / (double)ops, (unsigned long long)ops);
+}
+
+// A typical mixed packet: a key tap plus a few motion samples and a click
+static const char text_packet[] =
+    "K,30,1;K,30,0;M,0,3;M,1,-2;M,0,4;M,1,-1;M,272,1;M,272,0;";
+#define PACKET_EVENTS 8
+
+static uint16_t build_binary_packet(uint8_t *buf, size_t cap) {
+    hp_writer w;
+    hp_writer_init(&w, buf, cap);
+    hp_put_event(&w, HP_EV_KEY, 30, 1);
+    hp_put_event(&w, HP_EV_KEY, 30, 0);
+    hp_put_event(&w, HP_EV_REL, 0, 3);
+    hp_put_event(&w, HP_EV_REL, 1, -2);
+    hp_put_event(&w, HP_EV_REL, 0, 4);
+    hp_put_event(&w, HP_EV_REL, 1, -1);
+    hp_put_event(&w, HP_EV_KEY, 272, 1);
+    hp_put_event(&w, HP_EV_KEY, 272, 0);
+    return (uint16_t)w.len;
+}
+
+static void bench_text_parse(long iters) {
+    uint64_t t0 = now_ns();
+    for (long i = 0; i < iters; i++) process_packet(text_packet, sizeof(text_packet) - 1);
+    report("parse+dispatch text", now_ns() - t0, (uint64_t)iters * PACKET_EVENTS);
+}
+
+static void bench_binary_parse(long iters) {
+    uint8_t buf[64];
+    uint16_t len = build_binary_packet(buf, sizeof(buf));
+    uint64_t t0 = now_ns();
+    for (long i = 0; i < iters; i++) process_packet((const char *)buf, len);
+    report("parse+dispatch binary", now_ns() - t0, (uint64_t)iters * PACKET_EVENTS);
+}
+
+static void bench_text_encode(long iters) {
+    char buf[1024];
+    uint64_t t0 = now_ns();
+    for (long i = 0; i < iters; i++) {
+        int len = 0;
+        for (int e = 0; e < PACKET_EVENTS; e++)
+            len += snprintf(buf + len, sizeof(buf) - len, "M,%d,%d;", e, (int)i & 0x3F);
+        sink += (uint32_t)len;
+    }
+    report("encode text", now_ns() - t0, (uint64_t)iters * PACKET_EVENTS);
+}
+
+static void bench_binary_encode(long iters) {
+    uint8_t buf[1024];
+    hp_writer w;
+    uint64_t t0 = now_ns();
+    for (long i = 0; i < iters; i++) {
+        hp_writer_init(&w, buf, sizeof(buf));
+        for (int e = 0; e < PACKET_EVENTS; e++)
+            hp_put_event(&w, HP_EV_REL, (uint16_t)e, (int32_t)(i & 0x3F));
+        sink += (uint32_t)w.len;
+    }
+    report("encode binary", now_ns() - t0, (uint64_t)iters * PACKET_EVENTS);
+}
+
+static void bench_queue(long iters) {
+    uint64_t t0 = now_ns();
+    for (long i = 0; i < iters; i++) {
+        enqueue_packet(text_packet, sizeof(text_packet) - 1);
+        const Packet *pkt = packet_queue_peek();
+        sink += pkt->len;
+        packet_queue_release();
+    }
+    report("queue enqueue+peek+release", now_ns() - t0, (uint64_t)iters);
+}
+
+// Stand-in for an lwIP pbuf chain
+typedef struct seg {
+    const struct seg *next;
+    const uint8_t *data;
+    size_t len;
+} seg;
+
+static bool seg_next(const void **s, const uint8_t **data, size_t *len) {
+    const seg *cur = (const seg *)*s;
+    if (!cur) return false;
+    *data = cur->data;
+    *len = cur->len;
+    *s = cur->next;
+    return true;
+}
+
+// Copy of the datagram into the ring on receive, parse from the slot
+static void bench_rx_copy(long iters, const uint8_t *buf, uint16_t len, int events) {
+    packet_queue_reset();
+    uint64_t t0 = now_ns();
+    for (long i = 0; i < iters; i++) {
+        enqueue_packet((const char *)buf, len);
+        const Packet *pkt = packet_queue_peek();
+        process_packet(pkt->data, pkt->len);
+        packet_queue_release();
+    }
+    report("rx copy path", now_ns() - t0, (uint64_t)iters * events);
+}
+
+// Buffer reference through the ring, parse straight out of the chain
+static void bench_rx_zero_copy(long iters, const seg *chain, uint16_t len, int events,
+                               const char *name) {
+    packet_queue_reset();
+    uint64_t t0 = now_ns();
+    for (long i = 0; i < iters; i++) {
+        enqueue_packet_ref((void *)chain, len);
+        const Packet *pkt = packet_queue_peek();
+        process_packet_chain(pkt->ref, seg_next);
+        packet_queue_release();
+        while (packet_queue_reclaim()) {}
+    }
+    report(name, now_ns() - t0, (uint64_t)iters * events);
+}
+
+static void bench_rx_paths(long iters) {
+    // A full motion batch: 64 small deltas, ~130 bytes
+    uint8_t buf[256];
+    hp_writer w;
+    hp_writer_init(&w, buf, sizeof(buf));
+    for (int e = 0; e < 64; e++) hp_put_event(&w, HP_EV_REL, (uint16_t)(e & 1), (e & 2) ? -3 : 3);
+    uint16_t len = (uint16_t)w.len;
+
+    seg single = {NULL, buf, len};
+    seg second = {NULL, buf + len / 2, len - len / 2};
+    seg first = {&second, buf, len / 2};
+
+    bench_rx_copy(iters, buf, len, 64);
+    bench_rx_zero_copy(iters, &single, len, 64, "rx zero-copy (1 pbuf)");
+    bench_rx_zero_copy(iters, &first, len, 64, "rx zero-copy (2 pbufs)");
+    packet_queue_reset();
+}
+
+static void bench_keymap(long iters) {
+    uint64_t t0 = now_ns();
+    for (long i = 0; i < iters; i++) sink += keymap_linux_to_hid((uint16_t)(i & 0x7F));
+    report("keymap lookup", now_ns() - t0, (uint64_t)iters);
+}
+
+int main(int argc, char **argv) {
+    long iters = argc > 1 ? atol(argv[1]) : DEFAULT_ITERATIONS;
+    if (iters <= 0) iters = DEFAULT_ITERATIONS;
+
+    hid_port_host_reset();
+    hid_server_reset();
+
+    bench_text_encode(iters);
+    bench_binary_encode(iters);
+    bench_text_parse(iters);
+    bench_binary_parse(iters);
+    bench_queue(iters);
+    bench_rx_paths(iters / 4);
+    bench_keymap(iters * 10);
+    return 0;
+}
@@ -0,0 +1,211 @@
+// pi_client flush policies on synthetic input, in virtual time.
+//
+// Compares the old policy (send after 64 events or once 5 ms have passed
+// since the last datagram, checked on every event and on a 2 ms select
+// tick) with the SYN_REPORT-aligned policy in client/flush_policy.c.
+// Reports how long events wait in the client and how many datagrams a
+// second go out.
+//
+// Usage: flush_bench [seconds]
+
+#include "flush_policy.h"
+#include "latency_hist.h"
+#include <linux/input-event-codes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_SECONDS   10
+#define LEGACY_MAX_EVENTS 64
+#define LEGACY_TIMEOUT_US 5000
+#define LEGACY_TICK_US    2000
+
+typedef struct {
+    uint64_t t_us;
+    uint16_t type;
+} sim_event;
+
+typedef struct {
+    sim_event *ev;
+    size_t count;
+    size_t cap;
+} workload;
+
+static void push(workload *w, uint64_t t, uint16_t type) {
+    if (w->count == w->cap) {
+        w->cap = w->cap ? w->cap * 2 : 1024;
+        w->ev = realloc(w->ev, w->cap * sizeof(*w->ev));
+    }
+    w->ev[w->count++] = (sim_event){t, type};
+}
+
+// Key taps every 80-200 ms (press and release frames 40-100 ms apart)
+static void gen_typing(workload *w, uint64_t duration_us) {
+    for (uint64_t t = 1000; t < duration_us; t += 80000 + (uint64_t)(drand48() * 120000)) {
+        push(w, t, EV_KEY); push(w, t, EV_SYN);
+        uint64_t up = t + 40000 + (uint64_t)(drand48() * 60000);
+        push(w, up, EV_KEY); push(w, up, EV_SYN);
+    }
+}
+
+// Continuous motion: X and Y every frame at the given report rate
+static void gen_motion(workload *w, uint64_t duration_us, uint32_t hz) {
+    uint64_t period = 1000000u / hz;
+    for (uint64_t t = 500; t < duration_us; t += period) {
+        push(w, t, EV_REL); push(w, t, EV_REL); push(w, t, EV_SYN);
+    }
+}
+
+static int cmp_event(const void *a, const void *b) {
+    const sim_event *x = a, *y = b;
+    if (x->t_us != y->t_us) return x->t_us < y->t_us ? -1 : 1;
+    return 0;
+}
+
+typedef struct {
+    latency_hist key_wait;
+    latency_hist all_wait;
+    unsigned long datagrams;
+} result;
+
+// Events waiting in the current datagram
+typedef struct {
+    uint64_t t_us[4096];
+    bool key[4096];
+    size_t n;
+} pending;
+
+static void send_now(pending *p, uint64_t now, result *r) {
+    if (p->n == 0) return;
+    for (size_t i = 0; i < p->n; i++) {
+        uint32_t wait = (uint32_t)(now - p->t_us[i]);
+        latency_hist_record(&r->all_wait, wait);
+        if (p->key[i]) latency_hist_record(&r->key_wait, wait);
+    }
+    p->n = 0;
+    r->datagrams++;
+}
+
+static void run_legacy(const workload *w, result *r) {
+    static pending p;
+    p.n = 0;
+    uint64_t last_send = 0, next_tick = LEGACY_TICK_US;
+    for (size_t i = 0; i < w->count; i++) {
+        const sim_event *e = &w->ev[i];
+        // select() timeouts between events
+        while (next_tick <= e->t_us) {
+            if (p.n > 0 && next_tick - last_send >= LEGACY_TIMEOUT_US) {
+                send_now(&p, next_tick, r);
+                last_send = next_tick;
+            }
+            next_tick += LEGACY_TICK_US;
+        }
+        if (e->type != EV_SYN) {
+            p.t_us[p.n] = e->t_us;
+            p.key[p.n++] = e->type == EV_KEY;
+            if (p.n >= LEGACY_MAX_EVENTS) {
+                send_now(&p, e->t_us, r);
+                last_send = e->t_us;
+            }
+        }
+        // select() returns right after a read
+        if (p.n > 0 && e->t_us - last_send >= LEGACY_TIMEOUT_US) {
+            send_now(&p, e->t_us, r);
+            last_send = e->t_us;
+        }
+        next_tick = e->t_us + LEGACY_TICK_US;
+    }
+}
+
+static void run_framed(const workload *w, const flush_config *cfg, result *r) {
+    static pending p;
+    p.n = 0;
+    flush_policy fp;
+    flush_policy_init(&fp, cfg);
+    for (size_t i = 0; i < w->count; i++) {
+        const sim_event *e = &w->ev[i];
+        // timerfd deadline between events
+        uint64_t d = flush_deadline(&fp);
+        if (d != 0 && d <= e->t_us) {
+            send_now(&p, d, r);
+            flush_sent(&fp, d);
+        }
+        if (e->type == EV_SYN) {
+            if (flush_frame_end(&fp, e->t_us)) {
+                send_now(&p, e->t_us, r);
+                flush_sent(&fp, e->t_us);
+            }
+        } else {
+            p.t_us[p.n] = e->t_us;
+            p.key[p.n++] = e->type == EV_KEY;
+            flush_note_event(&fp, e->type, e->t_us);
+        }
+    }
+}
+
+static void print_result(const char *name, const result *r, double seconds) {
+    printf("%-34s %8.0f datagrams/s  wait avg %6.0f us  p99 <=%6u us",
+           name, (double)r->datagrams / seconds,
+           r->all_wait.count ? (double)r->all_wait.sum_us / r->all_wait.count : 0.0,
+           latency_hist_percentile(&r->all_wait, 99));
+    if (r->key_wait.count) {
+        printf("  keys avg %6.0f us  max %6u us",
+               (double)r->key_wait.sum_us / r->key_wait.count, r->key_wait.max_us);
+    }
+    printf("\n");
+}
+
+static void compare(const char *name, workload *w, double seconds) {
+    qsort(w->ev, w->count, sizeof(*w->ev), cmp_event);
+    printf("%s\n", name);
+
+    result r;
+    memset(&r, 0, sizeof(r));
+    latency_hist_reset(&r.key_wait);
+    latency_hist_reset(&r.all_wait);
+    run_legacy(w, &r);
+    print_result("  64 events / 5 ms", &r, seconds);
+
+    const flush_config cfgs[] = {
+        {FLUSH_DEFAULT_PACE_US, FLUSH_DEFAULT_DELAY_US, true},
+        {125, FLUSH_DEFAULT_DELAY_US, true},
+        {4000, FLUSH_DEFAULT_DELAY_US, true},
+    };
+    for (size_t i = 0; i < sizeof(cfgs) / sizeof(cfgs[0]); i++) {
+        char label[64];
+        snprintf(label, sizeof(label), "  SYN-aligned, pace %u us", cfgs[i].motion_pace_us);
+        memset(&r, 0, sizeof(r));
+        latency_hist_reset(&r.key_wait);
+        latency_hist_reset(&r.all_wait);
+        run_framed(w, &cfgs[i], &r);
+        print_result(label, &r, seconds);
+    }
+}
+
+int main(int argc, char **argv) {
+    int seconds = argc > 1 ? atoi(argv[1]) : DEFAULT_SECONDS;
+    if (seconds <= 0) seconds = DEFAULT_SECONDS;
+    uint64_t duration = (uint64_t)seconds * 1000000u;
+    srand48(1);
+
+    workload w = {0};
+    gen_typing(&w, duration);
+    compare("typing", &w, seconds);
+
+    w.count = 0;
+    gen_motion(&w, duration, 1000);
+    compare("1 kHz mouse", &w, seconds);
+
+    w.count = 0;
+    gen_motion(&w, duration, 8000);
+    compare("8 kHz mouse", &w, seconds);
+
+    w.count = 0;
+    gen_motion(&w, duration, 1000);
+    gen_typing(&w, duration);
+    compare("typing while moving (1 kHz)", &w, seconds);
+
+    free(w.ev);
+    return 0;
+}
@@ -0,0 +1,197 @@
+// The firmware main loop on Linux, for load testing over loopback.
+//
+// A receive thread stands in for core1: it reads datagrams from the HID
+// port into the packet queue (stamping the sender) and answers the stats
+// channel. The main thread stands in for core0: it drains the queue through
+// the parser and HID core, and runs the simulated USB frame clock so
+// reports complete at 1 ms polls like on a full-speed host. With -x the
+// receive thread also parses, like PIHIDFI_SPLIT_PIPELINE, and the main
+// thread only applies the decoded events.
+//
+// Usage: host_receiver [-x] [-p PORT] [-s STATS_PORT]
+
+#include "event_ring.h"
+#include "hid_port.h"
+#include "hid_port_host.h"
+#include "hid_server.h"
+#include "packet_parser.h"
+#include "packet_queue.h"
+#include "pipeline_stats.h"
+#include "telemetry.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define DEFAULT_PORT 50037
+#define IDLE_WAKE_US 10000
+
+static bool split = false;
+static int hid_fd = -1;
+static int stats_fd = -1;
+static _Atomic uint32_t udp_rx;
+
+static int open_udp(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return -1;
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    // Room for bursts while core0 is busy, like lwIP's pbuf pool
+    int rcvbuf = 1 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    return fd;
+}
+
+// ───────────────────────────────
+// "core1": UDP receive and stats channel
+// ───────────────────────────────
+static void receive_hid(void) {
+    // One byte more than a record holds tells truncation apart
+    char buf[PACKET_MAX_LEN + 1];
+    struct sockaddr_in from;
+    socklen_t flen = sizeof(from);
+    ssize_t n = recvfrom(hid_fd, buf, sizeof(buf), 0, (struct sockaddr *)&from, &flen);
+    if (n <= 0) return;
+    atomic_fetch_add_explicit(&udp_rx, 1, memory_order_relaxed);
+
+    bool truncated = n > PACKET_MAX_LEN;
+    if (truncated) n = PACKET_MAX_LEN;
+    Packet *slot = packet_queue_reserve((uint16_t)n);
+    if (!slot) {
+        packet_queue_count_drop();
+        return;
+    }
+    if (truncated) packet_queue_count_truncated();
+    memcpy(slot->data, buf, (size_t)n);
+    slot->len = (uint16_t)n;
+    slot->ref = NULL;
+    packet_queue_set_source(from.sin_addr.s_addr, ntohs(from.sin_port));
+    packet_queue_publish();
+    if (!split) hid_port_doorbell_ring();
+}
+
+static void answer_stats(void) {
+    uint8_t req = HS_REQ_SNAPSHOT;
+    struct sockaddr_in from;
+    socklen_t flen = sizeof(from);
+    if (recvfrom(stats_fd, &req, 1, 0, (struct sockaddr *)&from, &flen) < 0) return;
+
+    uint8_t reply[HS_MAX_REPLY];
+    hs_writer w;
+    hs_writer_init(&w, reply, sizeof(reply));
+    telemetry_link link = {atomic_load_explicit(&udp_rx, memory_order_relaxed), 0};
+    telemetry_write(&w, &link);
+    size_t len = hs_writer_finish(&w);
+    if (len > 0) sendto(stats_fd, reply, len, 0, (struct sockaddr *)&from, flen);
+    if (req == HS_REQ_RESET) pipeline_stats_request_reset();
+}
+
+static void parse_queued_packets(void) {
+    const Packet *pkt;
+    while ((pkt = packet_queue_peek()) != NULL) {
+        pipeline_packet_begin(pkt->rx_us);
+        process_packet_from(&pkt->from, pkt->data, pkt->len);
+        pipeline_packet_end();
+        packet_queue_release();
+    }
+}
+
+static void *core1(void *arg) {
+    (void)arg;
+    struct pollfd fds[2] = {{hid_fd, POLLIN, 0}, {stats_fd, POLLIN, 0}};
+    while (true) {
+        int n = poll(fds, 2, split ? IDLE_WAKE_US / 1000 : -1);
+        if (n > 0 && (fds[0].revents & POLLIN)) receive_hid();
+        if (n > 0 && (fds[1].revents & POLLIN)) answer_stats();
+        if (split) {
+            if (packet_queue_depth() > 0) {
+                parse_queued_packets();
+                hid_port_doorbell_ring();
+            }
+            packet_parser_expire(hid_port_time_us());
+            pipeline_stats_service_parser();
+        }
+    }
+    return NULL;
+}
+
+// ───────────────────────────────
+// "core0": parser, HID core and USB frames
+// ───────────────────────────────
+int main(int argc, char **argv) {
+    uint16_t port = DEFAULT_PORT, stats_port = HS_PORT;
+    int opt;
+    while ((opt = getopt(argc, argv, "xp:s:")) != -1) {
+        switch (opt) {
+            case 'x': split = true; break;
+            case 'p': port = (uint16_t)atoi(optarg); break;
+            case 's': stats_port = (uint16_t)atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-x] [-p PORT] [-s STATS_PORT]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    hid_fd = open_udp(port);
+    stats_fd = open_udp(stats_port);
+    if (hid_fd < 0 || stats_fd < 0) {
+        perror("bind");
+        return 1;
+    }
+
+    hid_port_host_reset();
+    hid_port_host_use_real_clock(true);
+    hid_port_host_usb_poll(1);
+    hid_server_reset();
+    hid_server_set_mouse_hires(true);
+    hid_server_set_nkro(true);
+    packet_parser_reset();
+    packet_parser_set_split(split);
+    packet_queue_reset();
+    event_ring_reset();
+    pipeline_stats_reset();
+
+    pthread_t tid;
+    pthread_create(&tid, NULL, core1, NULL);
+    printf("host_receiver: HID on udp/%u, stats on udp/%u%s\n", port, stats_port,
+           split ? ", parsing on the receive thread" : "");
+    fflush(stdout);
+
+    uint64_t next_frame = (hid_port_time_us() / HOST_FRAME_US + 1) * HOST_FRAME_US;
+    while (true) {
+        if (split) {
+            packet_parser_apply_events();
+        } else {
+            parse_queued_packets();
+            packet_parser_expire(hid_port_time_us());
+        }
+        hid_server_service();
+
+        uint64_t now = hid_port_time_us();
+        if (now >= next_frame) {
+            hid_port_host_frame();   // SOF plus the host reading the endpoints
+            next_frame = (now / HOST_FRAME_US + 1) * HOST_FRAME_US;
+        }
+        if (split) pipeline_stats_service_hid();
+        else pipeline_stats_service();
+
+        // Idle: sleep until the next frame unless core1 rings first
+        if ((split ? event_ring_depth() : packet_queue_depth()) == 0) {
+            now = hid_port_time_us();
+            uint64_t wait = next_frame > now ? next_frame - now : 0;
+            hid_port_wait_event((uint32_t)(wait < IDLE_WAKE_US ? wait : IDLE_WAKE_US));
+        }
+    }
+}
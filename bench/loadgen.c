@@ -0,0 +1,383 @@
+// Load generator for a pihidfi receiver: a device on Wi-Fi, or host_receiver
+// (the firmware core on Linux) over loopback.
+//
+// Sends one of the streams below at a fixed datagram rate, then reads the
+// receiver's stats channel (HS_PORT) before and after the run to report
+// throughput, drops and the receiver's per-stage latency percentiles.
+//
+//   typing  bursts of 20 key transitions with a snapshot every 10, 250 ms apart
+//   mouse   REL_X/REL_Y per datagram (8000/s is an 8 kHz mouse)
+//   text    worst-case legacy text datagrams, a full queue slot of records
+//   replay  a recorded stream: "<time_us> <type> <code> <value>" per line,
+//           type 0 (EV_SYN) closes a datagram; replayed at recorded times
+//
+// Usage: loadgen [-s STREAM] [-r RATE] [-d SECONDS] [-f FILE] [-p PORT] [-j] HOST
+
+#include "hid_proto.h"
+#include "hid_stats.h"
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_PORT     50037
+#define DEFAULT_RATE     1000
+#define DEFAULT_SECONDS  5
+#define MAX_DATAGRAM     256    // well under PACKET_MAX_LEN on the receiver
+#define SETTLE_US        200000 // let the receiver drain before the last poll
+#define BURST_LEN        20
+#define BURST_GAP_US     250000
+#define SNAPSHOT_EVERY   10
+#define MAX_REPLAY       16384  // datagrams
+
+typedef enum { STREAM_TYPING, STREAM_MOUSE, STREAM_TEXT, STREAM_REPLAY } stream_kind;
+
+static const char *const stream_names[] = {"typing", "mouse", "text", "replay"};
+
+// One datagram of a replayed recording
+typedef struct {
+    uint64_t t_us;          // offset from the first event
+    hp_writer w;            // over data, stamped when sent
+    uint8_t data[MAX_DATAGRAM];
+} replay_datagram;
+
+typedef struct {
+    int fd;
+    struct sockaddr_in hid;
+    struct sockaddr_in stats;
+} link_t;
+
+// Receiver state read from the stats channel
+typedef struct {
+    bool ok;
+    uint32_t ctr[HS_CTR_COUNT];
+    hs_latency lat[HS_STAGE_COUNT];
+} remote_stats;
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static void sleep_until_us(uint64_t t_us) {
+    struct timespec ts = {(time_t)(t_us / 1000000u), (long)(t_us % 1000000u) * 1000};
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+// ───────────────────────────────
+// Streams
+// ───────────────────────────────
+typedef struct {
+    uint32_t seq;
+    uint16_t held[BURST_LEN];
+    size_t nheld;
+    int burst_pos;
+} typing_state;
+
+// Next datagram of the current burst; burst_pos wraps to 0 at its end
+static size_t build_typing(typing_state *s, uint8_t *buf, uint64_t t_us) {
+    hp_writer w;
+    hp_writer_init_flags(&w, buf, MAX_DATAGRAM, HP_FLAG_SEQ | HP_FLAG_TIME);
+
+    // Press/release pairs over KEY_Q..KEY_P (16-25), everything up by the burst end
+    int pos = s->burst_pos++;
+    uint16_t code = (uint16_t)(16 + (pos / 2) % 10);
+    bool press = (pos & 1) == 0;
+    hp_put_event(&w, HP_EV_KEY, code, press);
+    if (press) {
+        s->held[s->nheld++] = code;
+    } else if (s->nheld > 0) {
+        s->nheld--;
+    }
+    if (s->seq % SNAPSHOT_EVERY == 0) hp_put_state(&w, s->held, s->nheld);
+    hp_writer_stamp(&w, s->seq++, (uint32_t)t_us, 0);
+    if (s->burst_pos == BURST_LEN) s->burst_pos = 0;
+    return w.len;
+}
+
+static size_t build_mouse(uint32_t seq, uint8_t *buf, uint64_t t_us) {
+    hp_writer w;
+    hp_writer_init_flags(&w, buf, MAX_DATAGRAM, HP_FLAG_SEQ | HP_FLAG_TIME);
+    // Small circle: keeps the carry bounded whatever the rate
+    static const int8_t dx[8] = {2, 1, 0, -1, -2, -1, 0, 1};
+    hp_put_event(&w, HP_EV_REL, 0, dx[seq % 8]);
+    hp_put_event(&w, HP_EV_REL, 1, dx[(seq + 2) % 8]);
+    hp_writer_stamp(&w, seq, (uint32_t)t_us, 0);
+    return w.len;
+}
+
+// As many three-digit motion and key records as fit a queue slot
+static size_t build_text(uint8_t *buf) {
+    size_t len = 0;
+    for (int i = 0; ; i++) {
+        char rec[24];
+        int n = i % 4 == 3 ? snprintf(rec, sizeof(rec), "K,%d,%d;", 16 + i % 10, (i / 4) & 1)
+                           : snprintf(rec, sizeof(rec), "M,%d,%d;", i & 1, (i & 2) ? -100 : 100);
+        if (len + (size_t)n > MAX_DATAGRAM) break;
+        memcpy(buf + len, rec, (size_t)n);
+        len += (size_t)n;
+    }
+    return len;
+}
+
+// Loads a recording into datagrams; returns the count or -1
+static long load_replay(const char *path, replay_datagram **out) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    replay_datagram *d = calloc(MAX_REPLAY, sizeof(*d));
+    long n = 0;
+    bool open = false;
+    uint64_t t0 = 0, t;
+    unsigned type, code;
+    long value;
+    char line[128];
+    while (d && fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%" SCNu64 " %u %u %ld", &t, &type, &code, &value) != 4) continue;
+        if (n == 0 && !open) t0 = t;
+        if (!open) {
+            if (n == MAX_REPLAY) break;
+            hp_writer_init_flags(&d[n].w, d[n].data, MAX_DATAGRAM, HP_FLAG_SEQ | HP_FLAG_TIME);
+            d[n].t_us = t - t0;
+            open = true;
+        }
+        if (type == 0) {            // EV_SYN closes the datagram
+            if (!hp_writer_empty(&d[n].w)) n++;
+            open = false;
+            continue;
+        }
+        hp_put_event(&d[n].w, (uint8_t)type, (uint16_t)code, (int32_t)value);
+    }
+    fclose(f);
+    *out = d;
+    return d ? n : -1;
+}
+
+// ───────────────────────────────
+// Stats channel
+// ───────────────────────────────
+static remote_stats query_stats(const link_t *l, uint8_t req) {
+    remote_stats rs;
+    memset(&rs, 0, sizeof(rs));
+    uint8_t buf[HS_MAX_REPLY];
+    ssize_t len = -1;
+    for (int attempt = 0; attempt < 3 && len < 0; attempt++) {
+        sendto(l->fd, &req, 1, 0, (const struct sockaddr *)&l->stats, sizeof(l->stats));
+        len = recv(l->fd, buf, sizeof(buf), 0);
+    }
+
+    hs_reader r, sec;
+    uint8_t id;
+    if (len < 0 || hs_reader_init(&r, buf, (size_t)len) < 0) return rs;
+    while (hs_next_section(&r, &id, &sec) == 1) {
+        if (id == HS_SEC_COUNTERS) {
+            uint8_t c;
+            uint32_t v;
+            while (hs_next_counter(&sec, &c, &v) == 1) {
+                if (c < HS_CTR_COUNT) rs.ctr[c] = v;
+            }
+        } else if (id == HS_SEC_LATENCY) {
+            hs_latency lat;
+            while (hs_next_latency(&sec, &lat) == 1) {
+                if (lat.stage < HS_STAGE_COUNT) rs.lat[lat.stage] = lat;
+            }
+        }
+    }
+    rs.ok = true;
+    return rs;
+}
+
+// ───────────────────────────────
+// Run and report
+// ───────────────────────────────
+typedef struct {
+    stream_kind stream;
+    double rate;
+    double seconds;
+    bool json;
+    const char *host;
+} run_config;
+
+static void print_result(const run_config *c, uint64_t sent, uint64_t send_errors, double elapsed_s,
+                         const remote_stats *before, const remote_stats *after) {
+    uint32_t d[HS_CTR_COUNT] = {0};
+    for (int i = 0; i < HS_CTR_COUNT; i++) d[i] = after->ctr[i] - before->ctr[i];
+    uint32_t rx = d[HS_CTR_UDP_RX];
+    uint64_t lost_net = sent > rx ? sent - rx : 0;
+    uint64_t dropped = lost_net + d[HS_CTR_QUEUE_DROPPED];
+    double drop_pct = sent ? 100.0 * (double)dropped / (double)sent : 0;
+
+    if (c->json) {
+        printf("{\"stream\":\"%s\",\"host\":\"%s\",\"rate\":%.0f,\"seconds\":%.3f,"
+               "\"sent\":%llu,\"send_errors\":%llu,\"tx_pps\":%.1f,\"received\":%u,\"processed\":%u,"
+               "\"lost_network\":%llu,\"dropped_queue\":%u,\"drop_pct\":%.3f,\"parse_errors\":%u,"
+               "\"reports\":%u,\"ready_stalls\":%u,\"queue_high\":%u,\"queue_bytes_high\":%u,"
+               "\"latency_us\":{",
+               stream_names[c->stream], c->host, c->rate, elapsed_s,
+               (unsigned long long)sent, (unsigned long long)send_errors, (double)sent / elapsed_s,
+               rx, d[HS_CTR_PACKETS], (unsigned long long)lost_net, d[HS_CTR_QUEUE_DROPPED],
+               drop_pct, d[HS_CTR_PARSE_ERRORS], d[HS_CTR_REPORTS_SENT], d[HS_CTR_READY_STALLS],
+               after->ctr[HS_CTR_QUEUE_HIGH], after->ctr[HS_CTR_QUEUE_BYTES_HIGH]);
+        for (int s = 0; s < HS_STAGE_COUNT; s++) {
+            const hs_latency *l = &after->lat[s];
+            printf("%s\"%s\":{\"n\":%u,\"p50\":%u,\"p99\":%u,\"max\":%u}", s ? "," : "",
+                   hs_stage_names[s], l->count, hs_latency_percentile(l, 50),
+                   hs_latency_percentile(l, 99), l->max_us);
+        }
+        printf("}}\n");
+        return;
+    }
+
+    if (c->stream == STREAM_REPLAY) printf("replay for %.2f s → %s\n", elapsed_s, c->host);
+    else printf("%s @ %.0f/s for %.2f s → %s\n", stream_names[c->stream], c->rate, elapsed_s, c->host);
+    printf("  sent %llu (%.1f/s, %llu send errors), received %u, processed %u\n",
+           (unsigned long long)sent, (double)sent / elapsed_s, (unsigned long long)send_errors,
+           rx, d[HS_CTR_PACKETS]);
+    printf("  dropped %.3f%% (network %llu, queue full %u), parse errors %u, queue high %u (%u bytes)\n",
+           drop_pct, (unsigned long long)lost_net, d[HS_CTR_QUEUE_DROPPED],
+           d[HS_CTR_PARSE_ERRORS], after->ctr[HS_CTR_QUEUE_HIGH], after->ctr[HS_CTR_QUEUE_BYTES_HIGH]);
+    printf("  reports %u, endpoint stalls %u\n", d[HS_CTR_REPORTS_SENT], d[HS_CTR_READY_STALLS]);
+    printf("  %-8s %9s %8s %8s %8s\n", "stage", "n", "p50<=", "p99<=", "max");
+    for (int s = 0; s < HS_STAGE_COUNT; s++) {
+        const hs_latency *l = &after->lat[s];
+        printf("  %-8s %9u %8u %8u %8u\n", hs_stage_names[s], l->count,
+               hs_latency_percentile(l, 50), hs_latency_percentile(l, 99), l->max_us);
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-s STREAM] [-r RATE] [-d SECONDS] [-f FILE] [-p PORT] [-j] HOST\n", prog);
+    fprintf(stderr, "  -s STREAM   typing, mouse, text or replay (default typing)\n");
+    fprintf(stderr, "  -r RATE     datagrams per second (default %d; replay keeps recorded times)\n",
+            DEFAULT_RATE);
+    fprintf(stderr, "  -d SECONDS  run time (default %d; replay runs once through the file)\n",
+            DEFAULT_SECONDS);
+    fprintf(stderr, "  -f FILE     recording for -s replay\n");
+    fprintf(stderr, "  -p PORT     receiver HID port (default %d); stats are read from %d\n",
+            DEFAULT_PORT, HS_PORT);
+    fprintf(stderr, "  -j          one JSON object per run instead of text\n");
+}
+
+int main(int argc, char **argv) {
+    run_config c = {STREAM_TYPING, DEFAULT_RATE, DEFAULT_SECONDS, false, NULL};
+    const char *replay_path = NULL;
+    int port = DEFAULT_PORT;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:r:d:f:p:j")) != -1) {
+        switch (opt) {
+            case 's': {
+                int k = -1;
+                for (int i = 0; i < 4; i++) {
+                    if (strcmp(optarg, stream_names[i]) == 0) k = i;
+                }
+                if (k < 0) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                c.stream = (stream_kind)k;
+                break;
+            }
+            case 'r': c.rate = atof(optarg); break;
+            case 'd': c.seconds = atof(optarg); break;
+            case 'f': replay_path = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 'j': c.json = true; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (argc - optind != 1 || c.rate <= 0 || c.seconds <= 0 ||
+        (c.stream == STREAM_REPLAY && !replay_path)) {
+        usage(argv[0]);
+        return 1;
+    }
+    c.host = argv[optind];
+
+    link_t l;
+    memset(&l, 0, sizeof(l));
+    l.hid.sin_family = l.stats.sin_family = AF_INET;
+    l.hid.sin_port = htons((uint16_t)port);
+    l.stats.sin_port = htons(HS_PORT);
+    if (inet_pton(AF_INET, c.host, &l.hid.sin_addr) != 1) {
+        fprintf(stderr, "bad address: %s\n", c.host);
+        return 1;
+    }
+    l.stats.sin_addr = l.hid.sin_addr;
+    l.fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (l.fd < 0) {
+        perror("socket");
+        return 1;
+    }
+    struct timeval tv = {0, 500000};
+    setsockopt(l.fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    replay_datagram *replay = NULL;
+    long nreplay = 0;
+    if (c.stream == STREAM_REPLAY) {
+        nreplay = load_replay(replay_path, &replay);
+        if (nreplay <= 0) {
+            fprintf(stderr, "%s: no datagrams\n", replay_path);
+            return 1;
+        }
+    }
+
+    // Histograms start empty; counters are differenced
+    remote_stats before = query_stats(&l, HS_REQ_RESET);
+    if (!before.ok) {
+        fprintf(stderr, "no stats reply from %s:%d\n", c.host, HS_PORT);
+        return 1;
+    }
+
+    uint8_t buf[MAX_DATAGRAM];
+    typing_state typing = {0};
+    uint64_t sent = 0, send_errors = 0;
+    uint64_t interval = (uint64_t)(1e6 / c.rate);
+    if (interval == 0) interval = 1;
+    uint64_t start = now_us(), end = start + (uint64_t)(c.seconds * 1e6);
+    uint64_t t = start;
+    for (uint32_t i = 0; ; i++) {
+        const uint8_t *data = buf;
+        size_t len;
+        if (c.stream == STREAM_REPLAY) {
+            if (i == (uint32_t)nreplay) break;
+            t = start + replay[i].t_us;
+            data = replay[i].data;
+            len = replay[i].w.len;
+            hp_writer_stamp(&replay[i].w, i, (uint32_t)t, 0);
+        } else {
+            if (t >= end) break;
+            switch (c.stream) {
+                case STREAM_TYPING: len = build_typing(&typing, buf, t); break;
+                case STREAM_MOUSE:  len = build_mouse(i, buf, t); break;
+                default:            len = build_text(buf); break;
+            }
+        }
+        sleep_until_us(t);
+        if (sendto(l.fd, data, len, 0, (struct sockaddr *)&l.hid, sizeof(l.hid)) < 0) send_errors++;
+        else sent++;
+
+        if (c.stream == STREAM_TYPING && typing.burst_pos == 0) t += BURST_GAP_US;
+        else if (c.stream != STREAM_REPLAY) t += interval;
+    }
+    double elapsed_s = (double)(now_us() - start) / 1e6;
+
+    sleep_until_us(now_us() + SETTLE_US);
+    remote_stats after = query_stats(&l, HS_REQ_SNAPSHOT);
+    if (!after.ok) {
+        fprintf(stderr, "no stats reply from %s:%d after the run\n", c.host, HS_PORT);
+        return 1;
+    }
+    print_result(&c, sent, send_errors, elapsed_s, &before, &after);
+
+    free(replay);
+    close(l.fd);
+    return 0;
+}
@@ -0,0 +1,117 @@
+// Receive-to-dequeue latency of the firmware main loop, old vs. new design.
+//
+// Two threads stand in for the two cores. "core1" turns a fixed arrival
+// schedule into queued packets, "core0" dequeues them. The poll variant
+// reproduces the old loops (core1: poll + sleep 1 ms, core0: drain +
+// sleep 100 µs); the event variant enqueues on arrival, rings the doorbell
+// and lets core0 block in hid_port_wait_event().
+
+#include "hid_port.h"
+#include "hid_port_host.h"
+#include "latency_hist.h"
+#include "packet_queue.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_PACKETS 2000
+#define CORE1_POLL_US   1000
+#define CORE0_POLL_US   100
+#define IDLE_WAKE_US    10000
+
+typedef struct {
+    bool event_driven;
+    int packets;
+    uint64_t *arrival_us;      // absolute schedule
+    volatile bool done;
+} run_ctx;
+
+static void sleep_until_us(uint64_t t_us) {
+    struct timespec ts = {(time_t)(t_us / 1000000u), (long)(t_us % 1000000u) * 1000};
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+static void push(uint64_t arrival) {
+    Packet *slot;
+    while ((slot = packet_queue_reserve(sizeof(arrival))) == NULL) sched_yield();
+    memcpy(slot->data, &arrival, sizeof(arrival));
+    slot->len = sizeof(arrival);
+    slot->ref = NULL;
+    packet_queue_publish();
+}
+
+static void *core1(void *arg) {
+    run_ctx *ctx = (run_ctx *)arg;
+    int next = 0;
+    if (ctx->event_driven) {
+        for (; next < ctx->packets; next++) {
+            sleep_until_us(ctx->arrival_us[next]);
+            push(ctx->arrival_us[next]);
+            hid_port_doorbell_ring();
+        }
+    } else {
+        while (next < ctx->packets) {
+            uint64_t now = hid_port_time_us();
+            while (next < ctx->packets && ctx->arrival_us[next] <= now) push(ctx->arrival_us[next++]);
+            usleep(CORE1_POLL_US);
+        }
+    }
+    return NULL;
+}
+
+static void run(bool event_driven, int packets, unsigned seed) {
+    run_ctx ctx = {event_driven, packets, calloc((size_t)packets, sizeof(uint64_t)), false};
+    srand(seed);
+    uint64_t t = hid_port_time_us() + 10000;
+    for (int i = 0; i < packets; i++) {
+        t += 200 + (uint64_t)(rand() % 600);   // 200-800 µs between datagrams
+        ctx.arrival_us[i] = t;
+    }
+
+    packet_queue_reset();
+    latency_hist hist;
+    latency_hist_reset(&hist);
+    uint64_t wakeups = 0;
+    uint64_t start = hid_port_time_us();
+
+    pthread_t tid;
+    pthread_create(&tid, NULL, core1, &ctx);
+
+    int received = 0;
+    while (received < packets) {
+        const Packet *pkt;
+        while ((pkt = packet_queue_peek()) != NULL) {
+            uint64_t arrival;
+            memcpy(&arrival, pkt->data, sizeof(arrival));
+            latency_hist_record(&hist, (uint32_t)(hid_port_time_us() - arrival));
+            packet_queue_release();
+            received++;
+        }
+        wakeups++;
+        if (event_driven) {
+            if (packet_queue_depth() == 0) hid_port_wait_event(IDLE_WAKE_US);
+        } else {
+            usleep(CORE0_POLL_US);
+        }
+    }
+    pthread_join(tid, NULL);
+
+    double secs = (double)(hid_port_time_us() - start) / 1e6;
+    latency_hist_print(&hist, event_driven ? "event-driven arrival->dequeue" : "polling arrival->dequeue");
+    printf("  core0 wakeups: %.0f/s\n\n", (double)wakeups / secs);
+    free(ctx.arrival_us);
+}
+
+int main(int argc, char **argv) {
+    int packets = argc > 1 ? atoi(argv[1]) : DEFAULT_PACKETS;
+    if (packets <= 0) packets = DEFAULT_PACKETS;
+
+    hid_port_host_use_real_clock(true);
+    run(false, packets, 1);
+    run(true, packets, 1);
+    return 0;
+}
@@ -0,0 +1,170 @@
+// Key-state recovery under packet loss, over a real localhost UDP socket.
+//
+// A simulated typist produces one key transition per datagram (2 ms apart).
+// The sender drops a configurable share of datagrams before sendto(), the
+// receiver feeds what arrives into the firmware core. After every datagram
+// the keys in the last keyboard report are compared with what the typist
+// actually holds. Each loss level is run without protection, with snapshots
+// only (pi_client default) and with snapshots plus repeated transitions.
+//
+// Usage: loss_bench [datagrams] [loss% ...]
+
+#include "hid_port_host.h"
+#include "hid_server.h"
+#include "keymap_table.h"
+#include "packet_parser.h"
+#include "hid_proto.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define DEFAULT_DATAGRAMS  20000
+#define STEP_US            2000
+#define SNAPSHOT_EVERY     10     // datagrams, i.e. 20 ms like pi_client
+#define TYPIST_KEYS        8      // KEY_A .. KEY_K
+#define TYPIST_MAX_HELD    4
+
+typedef struct {
+    int redundancy;        // -r N
+    bool snapshots;
+} protection;
+
+typedef struct {
+    int tx;
+    int rx;
+    struct sockaddr_in rx_addr;
+} udp_link;
+
+static int open_link(udp_link *l) {
+    l->tx = socket(AF_INET, SOCK_DGRAM, 0);
+    l->rx = socket(AF_INET, SOCK_DGRAM, 0);
+    if (l->tx < 0 || l->rx < 0) return -1;
+
+    memset(&l->rx_addr, 0, sizeof(l->rx_addr));
+    l->rx_addr.sin_family = AF_INET;
+    l->rx_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(l->rx, (struct sockaddr *)&l->rx_addr, sizeof(l->rx_addr)) < 0) return -1;
+    socklen_t alen = sizeof(l->rx_addr);
+    getsockname(l->rx, (struct sockaddr *)&l->rx_addr, &alen);
+
+    struct timeval tv = {1, 0};
+    setsockopt(l->rx, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return 0;
+}
+
+// Keys of the last keyboard report, as a bitmask over the typist's keys
+static unsigned reported_keys(void) {
+    size_t n = hid_port_host_report_count();
+    for (size_t i = n; i > 0; i--) {
+        const host_report *r = hid_port_host_report(i - 1);
+        if (r->kind != HOST_REPORT_KEYBOARD) continue;
+        unsigned mask = 0;
+        for (int k = 0; k < 6; k++) {
+            for (int t = 0; t < TYPIST_KEYS; t++) {
+                if (r->kbd.keycode[k] && r->kbd.keycode[k] == keymap_linux_to_hid(30 + t))
+                    mask |= 1u << t;
+            }
+        }
+        return mask;
+    }
+    return 0;
+}
+
+static void run(udp_link *l, int datagrams, double loss_pct, protection p) {
+    hid_port_host_reset();
+    hid_port_host_set_time(1000000);
+    hid_server_reset();
+    packet_parser_reset();
+    srand48(1);
+
+    uint8_t buf[256];
+    hp_writer w;
+    hp_history history = {0};
+    unsigned held = 0;
+    int dropped = 0, wrong_steps = 0, lost_transitions = 0;
+    int wrong_run = 0, longest_wrong = 0;
+
+    for (int seq = 0; seq < datagrams; seq++) {
+        hp_writer_init_flags(&w, buf, sizeof(buf), HP_FLAG_SEQ);
+        if (p.redundancy) hp_put_history(&w, &history, (uint32_t)seq, (size_t)p.redundancy);
+
+        // One transition: release a held key or press a new one
+        int t = (int)(drand48() * TYPIST_KEYS);
+        bool press = !(held & (1u << t)) && __builtin_popcount(held) < TYPIST_MAX_HELD;
+        bool transition = press || (held & (1u << t));
+        if (transition) {
+            held ^= 1u << t;
+            hp_put_event(&w, HP_EV_KEY, (uint16_t)(30 + t), press);
+            hp_history_add(&history, (uint32_t)seq, (uint16_t)(30 + t), press);
+        }
+
+        if (p.snapshots && seq % SNAPSHOT_EVERY == 0) {
+            uint16_t codes[TYPIST_KEYS];
+            size_t n = 0;
+            for (int k = 0; k < TYPIST_KEYS; k++) {
+                if (held & (1u << k)) codes[n++] = (uint16_t)(30 + k);
+            }
+            hp_put_state(&w, codes, n);
+        }
+        hp_writer_stamp(&w, (uint32_t)seq, 0, 0);
+
+        hid_port_host_advance(STEP_US);
+        if (drand48() * 100.0 < loss_pct) {
+            dropped++;
+            lost_transitions += transition;
+        } else {
+            sendto(l->tx, buf, w.len, 0, (struct sockaddr *)&l->rx_addr, sizeof(l->rx_addr));
+            char rx[256];
+            ssize_t n = recv(l->rx, rx, sizeof(rx), 0);
+            if (n > 0) process_packet(rx, (uint16_t)n);
+        }
+
+        if (reported_keys() != held) {
+            wrong_steps++;
+            if (++wrong_run > longest_wrong) longest_wrong = wrong_run;
+        } else {
+            wrong_run = 0;
+        }
+    }
+
+    const parser_stats *ps = packet_parser_stats();
+    printf("loss %5.1f%%  r=%-2d snap=%-3s  dropped %5d  recovered %5lu/%-5d  resyncs %5lu  "
+           "wrong state %6.2f%% of time, longest %4d ms\n",
+           loss_pct, p.redundancy, p.snapshots ? "yes" : "no", dropped,
+           (unsigned long)ps->recovered, lost_transitions, (unsigned long)ps->resyncs,
+           100.0 * wrong_steps / datagrams, longest_wrong * STEP_US / 1000);
+}
+
+int main(int argc, char **argv) {
+    int datagrams = argc > 1 ? atoi(argv[1]) : DEFAULT_DATAGRAMS;
+    if (datagrams <= 0) datagrams = DEFAULT_DATAGRAMS;
+
+    double default_loss[] = {1, 5, 10, 20};
+    double *loss = default_loss;
+    int nloss = 4;
+    if (argc > 2) {
+        nloss = argc - 2;
+        loss = calloc((size_t)nloss, sizeof(double));
+        for (int i = 0; i < nloss; i++) loss[i] = atof(argv[i + 2]);
+    }
+
+    udp_link l;
+    if (open_link(&l) < 0) {
+        perror("socket");
+        return 1;
+    }
+
+    const protection modes[] = {{0, false}, {0, true}, {4, true}};
+    for (int i = 0; i < nloss; i++) {
+        for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) run(&l, datagrams, loss[i], modes[m]);
+    }
+
+    close(l.tx);
+    close(l.rx);
+    return 0;
+}
@@ -0,0 +1,36 @@
+#!/bin/bash
+# Standard load matrix, one JSON line per run, for before/after comparisons.
+#
+#   bench/run_loadgen.sh [BUILD_DIR] [HOST]
+#
+# Without HOST the firmware core is started locally (host_receiver) and
+# driven over loopback; with HOST a device on the network is measured.
+set -euo pipefail
+
+BUILD_DIR="${1:-build}"
+HOST="${2:-}"
+SECONDS_PER_RUN="${SECONDS_PER_RUN:-3}"
+PORT="${PORT:-50037}"
+
+RECEIVER_PID=""
+cleanup() {
+    if [ -n "$RECEIVER_PID" ]; then kill "$RECEIVER_PID" 2>/dev/null || true; fi
+}
+trap cleanup EXIT
+
+if [ -z "$HOST" ]; then
+    HOST=127.0.0.1
+    "$BUILD_DIR/host_receiver" -p "$PORT" >/dev/null &
+    RECEIVER_PID=$!
+    sleep 0.2
+fi
+
+run() {
+    "$BUILD_DIR/loadgen" -j -p "$PORT" -d "$SECONDS_PER_RUN" "$@" "$HOST"
+}
+
+run -s typing -r 1000
+run -s mouse -r 1000
+run -s mouse -r 8000
+run -s text -r 500
+run -s text -r 2000
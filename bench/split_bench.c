@@ -0,0 +1,185 @@
+// Parser and HID core throughput: one core vs. the split pipeline.
+//
+// Two threads stand in for the two cores and push a mixed corpus (binary
+// typing with snapshots, binary mouse motion, legacy text) through the
+// packet queue as fast as it drains:
+//   single  "core1" queues datagrams, "core0" parses and applies them
+//           (PIHIDFI_SPLIT_PIPELINE 0)
+//   split   "core1" queues and parses into the event ring, "core0" only
+//           applies the decoded events (PIHIDFI_SPLIT_PIPELINE 1)
+// Per stage it prints the CPU time each thread spends per datagram (waits
+// excluded); core0's share is what stands between tud_task() calls.
+//
+// Usage: split_bench [datagrams]
+
+#include "event_ring.h"
+#include "hid_port.h"
+#include "hid_port_host.h"
+#include "hid_server.h"
+#include "packet_parser.h"
+#include "packet_queue.h"
+#include "pipeline_stats.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_DATAGRAMS 200000
+#define CORPUS_LEN        1000
+#define IDLE_WAKE_US      100
+
+typedef struct {
+    uint16_t len;
+    char data[PACKET_MAX_LEN];
+} datagram;
+
+static datagram corpus[CORPUS_LEN];
+
+typedef struct {
+    bool split;
+    int datagrams;
+    atomic_bool done;
+    uint64_t core1_ns;
+} run_ctx;
+
+static uint64_t cpu_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t wall_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// ───────────────────────────────
+// Corpus
+// ───────────────────────────────
+static void build_corpus(void) {
+    uint32_t rng = 7;
+    for (int i = 0; i < CORPUS_LEN; i++) {
+        rng = rng * 1103515245u + 12345u;
+        datagram *d = &corpus[i];
+        hp_writer w;
+        switch (i % 4) {
+            case 0: {   // typing burst closed by a snapshot
+                uint16_t key = (uint16_t)(16 + (rng >> 16) % 34);
+                hp_writer_init_flags(&w, (uint8_t *)d->data, sizeof(d->data), HP_FLAG_TIME);
+                hp_put_event(&w, HP_EV_KEY, 42, 1);
+                hp_put_event(&w, HP_EV_KEY, key, 1);
+                hp_put_event(&w, HP_EV_KEY, key, 0);
+                hp_put_event(&w, HP_EV_KEY, 42, 0);
+                hp_put_state(&w, NULL, 0);
+                d->len = (uint16_t)w.len;
+                break;
+            }
+            case 1:
+            case 2: {   // mouse motion, now and then a click
+                hp_writer_init_flags(&w, (uint8_t *)d->data, sizeof(d->data), HP_FLAG_TIME);
+                for (int k = 0; k < 4; k++) {
+                    hp_put_event(&w, HP_EV_REL, 0, (int32_t)((rng >> (k * 4)) % 21) - 10);
+                    hp_put_event(&w, HP_EV_REL, 1, (int32_t)((rng >> (k * 4 + 2)) % 21) - 10);
+                }
+                if (i % 40 == 1) hp_put_event(&w, HP_EV_KEY, 272, 1);
+                if (i % 40 == 21) hp_put_event(&w, HP_EV_KEY, 272, 0);
+                d->len = (uint16_t)w.len;
+                break;
+            }
+            default: {  // legacy text client
+                int n = snprintf(d->data, sizeof(d->data), "K,%u,1;M,0,%d;M,1,%d;K,%u,0;",
+                                 16 + (rng >> 16) % 34, (int)(rng % 7) - 3, (int)(rng >> 4) % 5,
+                                 16 + (rng >> 16) % 34);
+                d->len = (uint16_t)n;
+                break;
+            }
+        }
+    }
+}
+
+// ───────────────────────────────
+// The two cores
+// ───────────────────────────────
+static void parse_queued_packets(void) {
+    const Packet *pkt;
+    while ((pkt = packet_queue_peek()) != NULL) {
+        pipeline_packet_begin(pkt->rx_us);
+        process_packet_from(&pkt->from, pkt->data, pkt->len);
+        pipeline_packet_end();
+        packet_queue_release();
+    }
+}
+
+static void *core1(void *arg) {
+    run_ctx *ctx = (run_ctx *)arg;
+    uint64_t t0 = cpu_ns();
+    for (int i = 0; i < ctx->datagrams; i++) {
+        const datagram *d = &corpus[i % CORPUS_LEN];
+        Packet *slot;
+        while ((slot = packet_queue_reserve(d->len)) == NULL) sched_yield();
+        memcpy(slot->data, d->data, d->len);
+        slot->len = d->len;
+        slot->ref = NULL;
+        packet_queue_publish();
+        if (ctx->split) parse_queued_packets();
+        hid_port_doorbell_ring();
+    }
+    ctx->core1_ns = cpu_ns() - t0;
+    atomic_store(&ctx->done, true);
+    return NULL;
+}
+
+static void run(bool split, int datagrams) {
+    hid_port_host_reset();
+    hid_port_host_use_real_clock(true);
+    hid_server_reset();
+    hid_server_set_mouse_hires(true);
+    packet_parser_reset();
+    packet_parser_set_split(split);
+    packet_queue_reset();
+    event_ring_reset();
+    pipeline_stats_reset();
+
+    run_ctx ctx = {split, datagrams, false, 0};
+    uint64_t start = wall_ns();
+    uint64_t t0 = cpu_ns();
+    pthread_t tid;
+    pthread_create(&tid, NULL, core1, &ctx);
+
+    while (true) {
+        bool done = atomic_load(&ctx.done);
+        if (split) packet_parser_apply_events();
+        else parse_queued_packets();
+        hid_server_service();
+        if (done && packet_queue_depth() == 0 && event_ring_depth() == 0) break;
+        if ((split ? event_ring_depth() : packet_queue_depth()) == 0) hid_port_wait_event(IDLE_WAKE_US);
+    }
+    uint64_t core0_ns = cpu_ns() - t0;
+    pthread_join(tid, NULL);
+    double wall_s = (double)(wall_ns() - start) / 1e9;
+
+    const parser_stats *ps = packet_parser_stats();
+    event_ring_stats es;
+    event_ring_get_stats(&es);
+    printf("%-7s %9.0f datagrams/s   core1 %6.2f µs/datagram   core0 %6.2f µs/datagram"
+           "   events %lu  ring high %lu  full waits %lu\n",
+           split ? "split" : "single", (double)ps->packets / wall_s,
+           (double)ctx.core1_ns / 1e3 / datagrams, (double)core0_ns / 1e3 / datagrams,
+           (unsigned long)es.pushed, (unsigned long)es.high_watermark,
+           (unsigned long)es.full_waits);
+}
+
+int main(int argc, char **argv) {
+    int datagrams = argc > 1 ? atoi(argv[1]) : DEFAULT_DATAGRAMS;
+    if (datagrams <= 0) datagrams = DEFAULT_DATAGRAMS;
+
+    build_corpus();
+    run(false, datagrams);
+    run(true, datagrams);
+    return 0;
+}
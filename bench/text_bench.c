@@ -0,0 +1,212 @@
+// Legacy text parsing: the old strtok_r/sscanf path against hp_text_reader.
+//
+// Packets are rendered the way pi_client -t sends them ("%c,%d,%d;" per
+// event, 'M' for mouse devices) from a recording in loadgen's replay format
+// ("<time_us> <type> <code> <value>", type 0 closes a datagram), or from a
+// built-in session of typing, mouse motion and clicks. Both parsers must
+// decode the same events; then each is timed over the whole corpus.
+//
+// Usage: text_bench [-f FILE] [-n PASSES]
+
+#include "hid_proto.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_PACKET_LEN  1024   // pi_client
+#define MAX_PACKETS     16384
+#define MAX_EVENTS      256    // per packet
+#define DEFAULT_PASSES  200
+
+typedef struct {
+    uint16_t len;
+    char data[MAX_PACKET_LEN];
+} text_packet;
+
+static text_packet *packets;
+static size_t npackets;
+static volatile uint32_t sink;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// ───────────────────────────────
+// Corpus
+// ───────────────────────────────
+static text_packet *packet_open(void) {
+    if (npackets == MAX_PACKETS) return NULL;
+    text_packet *p = &packets[npackets];
+    p->len = 0;
+    return p;
+}
+
+static void packet_add(text_packet *p, unsigned type, unsigned code, long value) {
+    bool mouse = type == HP_EV_REL || (code >= 272 && code <= 274);
+    char entry[64];
+    int n = snprintf(entry, sizeof(entry), "%c,%u,%ld;", mouse ? 'M' : 'K', code, value);
+    if (p->len + n >= MAX_PACKET_LEN) return;
+    memcpy(p->data + p->len, entry, (size_t)n);
+    p->len = (uint16_t)(p->len + n);
+}
+
+static void packet_close(text_packet *p) {
+    if (p && p->len > 0) npackets++;
+}
+
+static bool load_recording(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    text_packet *p = NULL;
+    uint64_t t;
+    unsigned type, code;
+    long value;
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%" SCNu64 " %u %u %ld", &t, &type, &code, &value) != 4) continue;
+        if (type == 0) {            // EV_SYN closes the datagram
+            packet_close(p);
+            p = NULL;
+            continue;
+        }
+        if (!p && !(p = packet_open())) break;
+        packet_add(p, type, code, value);
+    }
+    packet_close(p);
+    fclose(f);
+    return true;
+}
+
+// Typing bursts, mouse motion at 1 kHz with the odd wheel step, clicks and drags
+static void build_session(void) {
+    uint32_t rng = 1;
+    for (int i = 0; i < 4000; i++) {
+        rng = rng * 1103515245u + 12345u;
+        text_packet *p = packet_open();
+        if (!p) return;
+        if (i % 5 == 0) {
+            unsigned key = 16 + (rng >> 16) % 34;
+            packet_add(p, HP_EV_KEY, key, 1);
+            if (rng & 0x100) packet_add(p, HP_EV_KEY, key, 0);
+        } else {
+            packet_add(p, HP_EV_REL, 0, (long)((rng >> 8) % 41) - 20);
+            packet_add(p, HP_EV_REL, 1, (long)((rng >> 14) % 41) - 20);
+            if (i % 50 == 7) packet_add(p, HP_EV_REL, 11, 120);
+            if (i % 200 == 13) packet_add(p, HP_EV_KEY, 272, 1);
+            if (i % 200 == 113) packet_add(p, HP_EV_KEY, 272, 0);
+        }
+        packet_close(p);
+    }
+}
+
+// ───────────────────────────────
+// Parsers
+// ───────────────────────────────
+// The firmware's parser before hp_text_reader: NUL-terminated copy,
+// strtok_r on ';', sscanf per token
+static size_t parse_old(const char *data, uint16_t len, hp_event *out) {
+    char msg[MAX_PACKET_LEN + 1];
+    if (len > MAX_PACKET_LEN) len = MAX_PACKET_LEN;
+    memcpy(msg, data, len);
+    msg[len] = '\0';
+
+    size_t n = 0;
+    char *saveptr;
+    char *cmd = strtok_r(msg, ";", &saveptr);
+    while (cmd != NULL && n < MAX_EVENTS) {
+        while (*cmd == ' ') cmd++;
+        int code, value;
+        if (cmd[0] == 'M' && sscanf(cmd, "M,%d,%d", &code, &value) == 2) {
+            bool button = code >= 272 && code <= 274;
+            out[n++] = (hp_event){button ? HP_EV_KEY : HP_EV_REL, (uint16_t)code, value, 0};
+        } else if (cmd[0] == 'K' && sscanf(cmd, "K,%d,%d", &code, &value) == 2) {
+            out[n++] = (hp_event){HP_EV_KEY, (uint16_t)code, value, 0};
+        }
+        cmd = strtok_r(NULL, ";", &saveptr);
+    }
+    return n;
+}
+
+static size_t parse_new(const char *data, uint16_t len, hp_event *out) {
+    hp_text_reader r;
+    hp_text_init(&r, data, len);
+    size_t n = 0;
+    while (n < MAX_EVENTS && hp_text_next(&r, &out[n]) > 0) n++;
+    return n;
+}
+
+typedef size_t (*parse_fn)(const char *data, uint16_t len, hp_event *out);
+
+static void run(const char *name, parse_fn parse, long passes, size_t events, size_t bytes) {
+    hp_event ev[MAX_EVENTS];
+    uint64_t t0 = now_ns();
+    for (long pass = 0; pass < passes; pass++) {
+        for (size_t i = 0; i < npackets; i++) {
+            size_t n = parse(packets[i].data, packets[i].len, ev);
+            sink += (uint32_t)n + (n ? (uint32_t)ev[n - 1].value : 0);
+        }
+    }
+    double ns = (double)(now_ns() - t0);
+    double total_packets = (double)npackets * (double)passes;
+    printf("%-20s %8.1f ns/packet %7.1f ns/event %8.1f MB/s\n", name,
+           ns / total_packets, ns / ((double)events * (double)passes),
+           (double)bytes * (double)passes / ns * 1000.0);
+}
+
+int main(int argc, char **argv) {
+    const char *path = NULL;
+    long passes = DEFAULT_PASSES;
+    int opt;
+    while ((opt = getopt(argc, argv, "f:n:")) != -1) {
+        switch (opt) {
+            case 'f': path = optarg; break;
+            case 'n': passes = atol(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-f FILE] [-n PASSES]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (passes <= 0) passes = DEFAULT_PASSES;
+
+    packets = calloc(MAX_PACKETS, sizeof(*packets));
+    if (!packets) return 1;
+    if (!path) build_session();
+    else if (!load_recording(path)) return 1;
+    if (npackets == 0) {
+        fprintf(stderr, "no packets\n");
+        return 1;
+    }
+
+    // Same events from both parsers, or the timings mean nothing
+    size_t events = 0, bytes = 0;
+    for (size_t i = 0; i < npackets; i++) {
+        hp_event a[MAX_EVENTS], b[MAX_EVENTS];
+        size_t na = parse_old(packets[i].data, packets[i].len, a);
+        size_t nb = parse_new(packets[i].data, packets[i].len, b);
+        bool same = na == nb;
+        for (size_t k = 0; same && k < na; k++) {
+            same = a[k].type == b[k].type && a[k].code == b[k].code && a[k].value == b[k].value;
+        }
+        if (!same) {
+            fprintf(stderr, "packet %zu decodes differently: %.*s\n", i, packets[i].len, packets[i].data);
+            return 1;
+        }
+        events += na;
+        bytes += packets[i].len;
+    }
+
+    printf("%zu packets, %zu events, %zu bytes, %ld passes\n", npackets, events, bytes, passes);
+    run("strtok_r + sscanf", parse_old, passes, events, bytes);
+    run("hp_text_reader", parse_new, passes, events, bytes);
+    free(packets);
+    return 0;
+}
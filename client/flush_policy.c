@@ -0,0 +1,51 @@
+#include "flush_policy.h"
+#include <linux/input-event-codes.h>
+#include <string.h>
+
+void flush_policy_init(flush_policy *fp, const flush_config *cfg) {
+    memset(fp, 0, sizeof(*fp));
+    fp->cfg = *cfg;
+}
+
+void flush_note_event(flush_policy *fp, uint16_t type, uint64_t now_us) {
+    if (!fp->frame_events && !fp->pending) fp->first_us = now_us;
+    fp->frame_events = true;
+    if (type == EV_KEY) fp->frame_key = true;
+}
+
+bool flush_frame_end(flush_policy *fp, uint64_t now_us) {
+    if (!fp->frame_events) return false;   // empty frame (e.g. filtered events)
+    bool key = fp->frame_key;
+    fp->frame_events = false;
+    fp->frame_key = false;
+    fp->pending = true;
+
+    if (key && fp->cfg.key_immediate) return true;
+    return flush_due(fp, now_us);
+}
+
+uint64_t flush_deadline(const flush_policy *fp) {
+    if (!fp->pending && !fp->frame_events) return 0;
+
+    uint64_t deadline = fp->first_us + fp->cfg.max_delay_us;
+    if (fp->pending) {
+        // 1/8 slack so that sends drift onto the device's frame times
+        // instead of locking in a constant delay behind them
+        uint32_t pace = fp->cfg.motion_pace_us;
+        uint64_t paced = fp->last_send_us + pace - pace / 8;
+        if (paced < deadline) deadline = paced;
+    }
+    return deadline;
+}
+
+bool flush_due(const flush_policy *fp, uint64_t now_us) {
+    uint64_t deadline = flush_deadline(fp);
+    return deadline != 0 && now_us >= deadline;
+}
+
+void flush_sent(flush_policy *fp, uint64_t now_us) {
+    fp->pending = false;
+    fp->frame_events = false;
+    fp->frame_key = false;
+    fp->last_send_us = now_us;
+}
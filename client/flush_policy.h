@@ -0,0 +1,60 @@
+#ifndef FLUSH_POLICY_H
+#define FLUSH_POLICY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ───────────────────────────────
+// When pi_client sends the pending datagram
+// ───────────────────────────────
+// Decisions are taken at SYN_REPORT frame boundaries:
+//   - a frame with a key/button transition goes out at once
+//   - motion-only frames are held so that datagrams are about
+//     motion_pace_us apart (the host's USB polling interval); frames
+//     arriving in between travel together
+//   - nothing waits longer than max_delay_us after its first event
+
+#define FLUSH_DEFAULT_PACE_US   1000
+#define FLUSH_DEFAULT_DELAY_US  5000
+
+typedef struct {
+    uint32_t motion_pace_us;
+    uint32_t max_delay_us;
+    bool key_immediate;
+} flush_config;
+
+typedef struct {
+    flush_config cfg;
+    bool frame_key;          // open frame carries a key transition
+    bool frame_events;       // open frame carries anything
+    bool pending;            // closed frames not sent yet
+    uint64_t first_us;       // first unsent event
+    uint64_t last_send_us;
+} flush_policy;
+
+void flush_policy_init(flush_policy *fp, const flush_config *cfg);
+
+// An event of this EV_* type was added to the datagram
+void flush_note_event(flush_policy *fp, uint16_t type, uint64_t now_us);
+
+// SYN_REPORT seen. Returns true if the datagram should be sent now.
+bool flush_frame_end(flush_policy *fp, uint64_t now_us);
+
+// Time by which the datagram has to go out, 0 if nothing is pending
+uint64_t flush_deadline(const flush_policy *fp);
+
+// True once the deadline has passed
+bool flush_due(const flush_policy *fp, uint64_t now_us);
+
+// The datagram was sent (for whatever reason)
+void flush_sent(flush_policy *fp, uint64_t now_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLUSH_POLICY_H
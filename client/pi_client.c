@@ -9,33 +9,379 @@
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <time.h>
-#include <sys/select.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/timerfd.h>
+#include <stdint.h>
+#include "hid_proto.h"
+#include "flush_policy.h"
+
+// Build: gcc -O2 -I../common pi_client.c flush_policy.c ../common/hid_proto.c -o pi_client
 
 #define MAX_PACKET_LEN        1024
 #define MAX_EVENTS_PER_BATCH  64
-#define BATCH_SEND_TIMEOUT_US 5000
 #define MAX_INPUT_DEVS        8  // up to 8 devices
+#define READ_BATCH            64 // input_events per read()
+
+// Key-state snapshots (binary protocol): sent every SNAPSHOT_INTERVAL_US
+// while anything is held and for SNAPSHOT_LINGER_US after the last key
+// change, so a lost release is repaired within one interval.
+#define SNAPSHOT_INTERVAL_US  20000
+#define SNAPSHOT_LINGER_US    100000
+
+static uint64_t timespec_us(const struct timespec *t) {
+    return (uint64_t)t->tv_sec * 1000000u + (uint64_t)t->tv_nsec / 1000u;
+}
+
+// Same truncation as timespec_us(), so it agrees with timer deadlines
+static long diff_us_since(const struct timespec *a, const struct timespec *b) {
+    return (long)(int64_t)(timespec_us(a) - timespec_us(b));
+}
+
+static uint64_t event_us(const struct input_event *ev) {
+    return (uint64_t)ev->input_event_sec * 1000000u + (uint64_t)ev->input_event_usec;
+}
+
+// ───────────────────────────────
+// Pending datagram
+// ───────────────────────────────
+typedef struct {
+    int sock;
+    struct sockaddr_in addr;
+    int text_mode;
+
+    char packet[MAX_PACKET_LEN];
+    int len;
+    int empty_len;
+    int events;
+    hp_writer writer;
+
+    // Relative motion merged until the datagram goes out (REL_* 0..15)
+    int32_t rel[16];
+    uint16_t rel_mask;
 
-static void sleep_us_rel(unsigned int us) {
+    uint32_t seq;
+    uint64_t oldest_us;   // capture time of the first event in the batch
+    struct timespec last_send;
+    int packets_sent;
+    flush_policy flush;
+
+    hp_history history;   // recent key transitions, repeated in later datagrams
+    int redundancy;       // how many to repeat (-r)
+    double loss_pct;      // simulated loss (-L)
+    int packets_dropped;
+} batch;
+
+static void batch_init(batch *b, int sock, const struct sockaddr_in *addr, int text_mode,
+                       uint8_t hdr_flags, int redundancy, double loss_pct, const flush_config *fc) {
+    memset(b, 0, sizeof(*b));
+    flush_policy_init(&b->flush, fc);
+    b->sock = sock;
+    b->addr = *addr;
+    b->text_mode = text_mode;
+    b->redundancy = redundancy;
+    b->loss_pct = loss_pct;
+    hp_writer_init_flags(&b->writer, (uint8_t *)b->packet, sizeof(b->packet), hdr_flags);
+    // New epoch per run: the receiver tells a restart from reordered datagrams
     struct timespec ts;
-    ts.tv_sec = us / 1000000;
-    ts.tv_nsec = (us % 1000000) * 1000;
-    nanosleep(&ts, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    hp_writer_set_epoch(&b->writer, (uint16_t)(ts.tv_nsec ^ getpid()));
+    if (!text_mode) b->len = (int)b->writer.len;
+    b->empty_len = b->len;
+    clock_gettime(CLOCK_MONOTONIC, &b->last_send);
+}
+
+// Starts the next datagram with the repeated transitions, if enabled
+static void batch_begin(batch *b) {
+    b->len = b->empty_len;
+    hp_writer_reset(&b->writer);
+    b->events = 0;
+    if (b->redundancy > 0) {
+        hp_put_history(&b->writer, &b->history, b->seq, (size_t)b->redundancy);
+        b->len = (int)b->writer.len;
+    }
+}
+
+static int encode_event(batch *b, const struct input_event *ev, int is_mouse) {
+    if (b->text_mode) {
+        char entry[64];
+        int n = snprintf(entry, sizeof(entry), "%c,%d,%d;",
+                         is_mouse ? 'M' : 'K', ev->code, ev->value);
+        if (b->len + n >= MAX_PACKET_LEN) return 0;
+        memcpy(b->packet + b->len, entry, n);
+        b->len += n;
+    } else {
+        uint8_t type = ev->type == EV_REL ? HP_EV_REL : HP_EV_KEY;
+        if (!hp_put_event(&b->writer, type, ev->code, ev->value)) return 0;
+        b->len = (int)b->writer.len;
+    }
+    return 1;
+}
+
+// Writes the merged motion, one record per axis. Returns false if the
+// datagram filled up first; the rest stays merged.
+static int batch_emit_motion(batch *b) {
+    while (b->rel_mask) {
+        uint16_t code = (uint16_t)__builtin_ctz(b->rel_mask);
+        if (b->rel[code] != 0) {
+            struct input_event ev = {.type = EV_REL, .code = code, .value = b->rel[code]};
+            if (!encode_event(b, &ev, 1)) return 0;
+        }
+        b->rel[code] = 0;
+        b->rel_mask &= (uint16_t)~(1u << code);
+    }
+    return 1;
+}
+
+static void batch_transmit(batch *b) {
+    clock_gettime(CLOCK_MONOTONIC, &b->last_send);
+    uint64_t now_us = timespec_us(&b->last_send);
+    flush_sent(&b->flush, now_us);
+    if (!b->text_mode) {
+        uint64_t age = now_us > b->oldest_us ? now_us - b->oldest_us : 0;
+        hp_writer_stamp(&b->writer, b->seq++, (uint32_t)now_us,
+                        age > UINT32_MAX ? UINT32_MAX : (uint32_t)age);
+    }
+    if (b->loss_pct > 0 && drand48() * 100.0 < b->loss_pct) {
+        b->packets_dropped++;   // loss injection: pretend it went out
+    } else {
+        sendto(b->sock, b->packet, b->len, 0, (struct sockaddr *)&b->addr, sizeof(b->addr));
+    }
+    b->packets_sent++;
+    batch_begin(b);
+}
+
+// Sends the pending datagram, stamping the header extension first
+static void batch_send(batch *b) {
+    while (!batch_emit_motion(b)) batch_transmit(b);
+    batch_transmit(b);
+}
+
+static int32_t sat_add(int32_t a, int32_t v) {
+    int64_t sum = (int64_t)a + v;
+    return sum > INT32_MAX ? INT32_MAX : (sum < INT32_MIN ? INT32_MIN : (int32_t)sum);
+}
+
+// Appends one event to the pending datagram, sending it first if full.
+// Relative motion is merged per axis and written when the datagram goes
+// out, or before the next key/button so their order is kept.
+// Returns false when the event is not forwarded.
+static int batch_append(batch *b, const struct input_event *ev) {
+    int is_mouse = ev->type == EV_REL || ev->code == BTN_LEFT ||
+                   ev->code == BTN_RIGHT || ev->code == BTN_MIDDLE;
+    if (!is_mouse && !(ev->type == EV_KEY && ev->value < 2)) return 0;
+
+    if (ev->type == EV_REL && ev->code < 16) {
+        b->rel[ev->code] = sat_add(b->rel[ev->code], ev->value);
+        b->rel_mask |= (uint16_t)(1u << ev->code);
+    } else {
+        if (!batch_emit_motion(b) || !encode_event(b, ev, is_mouse)) {
+            if (b->events == 0) return 0;   // cannot be encoded at all
+            batch_send(b);
+            if (!encode_event(b, ev, is_mouse)) return 0;
+        }
+    }
+
+    if (b->events++ == 0) b->oldest_us = event_us(ev);
+    if (ev->type == EV_KEY) hp_history_add(&b->history, b->seq, ev->code, ev->value == 1);
+    return 1;
+}
+
+// ───────────────────────────────
+// Held keys and buttons (for snapshots)
+// ───────────────────────────────
+typedef struct {
+    uint16_t codes[HP_MAX_STATE_CODES];
+    size_t count;
+    size_t untracked;   // held but not listed: snapshots go out partial
+    struct timespec last_change;
+    struct timespec last_snapshot;
+} key_state;
+
+static void key_state_update(key_state *ks, const struct input_event *ev) {
+    if (ev->type != EV_KEY || ev->value > 1) return;
+    clock_gettime(CLOCK_MONOTONIC, &ks->last_change);
+
+    for (size_t i = 0; i < ks->count; i++) {
+        if (ks->codes[i] == ev->code) {
+            if (ev->value == 0) ks->codes[i] = ks->codes[--ks->count];
+            return;
+        }
+    }
+    if (ev->value == 1) {
+        if (ks->count < HP_MAX_STATE_CODES) ks->codes[ks->count++] = ev->code;
+        else ks->untracked++;
+    } else if (ks->untracked > 0) {
+        ks->untracked--;
+    }
+}
+
+static int snapshot_due(const key_state *ks, const struct timespec *now) {
+    if (ks->count == 0 && ks->untracked == 0 && diff_us_since(now, &ks->last_change) >= SNAPSHOT_LINGER_US) return 0;
+    return diff_us_since(now, &ks->last_snapshot) >= SNAPSHOT_INTERVAL_US;
 }
 
-static long diff_us_since(struct timespec *a, struct timespec *b) {
-    return (a->tv_sec - b->tv_sec) * 1000000L + (a->tv_nsec - b->tv_nsec) / 1000L;
+static int put_snapshot(hp_writer *w, const key_state *ks) {
+    if (ks->untracked > 0) return hp_put_partial_state(w, ks->codes, ks->count);
+    return hp_put_state(w, ks->codes, ks->count);
+}
+
+// Appends the snapshot (after whatever is pending) and sends right away.
+// With more keys held than it can list the snapshot is partial, so the
+// receiver adds the listed ones and releases nothing.
+static void send_snapshot(batch *b, key_state *ks, const struct timespec *now) {
+    if (!batch_emit_motion(b) || !put_snapshot(&b->writer, ks)) {
+        batch_send(b);
+        put_snapshot(&b->writer, ks);
+    }
+    if (b->events == 0) b->oldest_us = timespec_us(now);
+    b->len = (int)b->writer.len;
+    batch_send(b);
+    ks->last_snapshot = *now;
+}
+
+// ───────────────────────────────
+// Capture engine: epoll over the input devices plus a timerfd for the
+// next flush/snapshot deadline, so an idle client does not wake at all
+// ───────────────────────────────
+#define CAPTURE_TIMER_TAG UINT32_MAX
+
+typedef struct {
+    int epfd;
+    int timer_fd;
+    uint64_t armed_us;     // deadline the timer is set to, 0 when disarmed
+
+    // Counters printed on exit
+    unsigned long wakeups;
+    unsigned long reads;
+    unsigned long events;
+} capture;
+
+static volatile sig_atomic_t stop_requested;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static int capture_open(capture *c, const int *fds, int count) {
+    memset(c, 0, sizeof(*c));
+    c->epfd = epoll_create1(EPOLL_CLOEXEC);
+    c->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (c->epfd < 0 || c->timer_fd < 0) return -1;
+
+    struct epoll_event ee = {.events = EPOLLIN};
+    for (int i = 0; i < count; i++) {
+        ee.data.u32 = (uint32_t)i;
+        if (epoll_ctl(c->epfd, EPOLL_CTL_ADD, fds[i], &ee) < 0) return -1;
+    }
+    ee.data.u32 = CAPTURE_TIMER_TAG;
+    return epoll_ctl(c->epfd, EPOLL_CTL_ADD, c->timer_fd, &ee);
+}
+
+// Arms the timer for an absolute CLOCK_MONOTONIC deadline (0 disarms)
+static void capture_arm(capture *c, uint64_t deadline_us) {
+    if (deadline_us == c->armed_us) return;
+    struct itimerspec its = {0};
+    its.it_value.tv_sec = (time_t)(deadline_us / 1000000u);
+    its.it_value.tv_nsec = (long)(deadline_us % 1000000u) * 1000;
+    timerfd_settime(c->timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+    c->armed_us = deadline_us;
+}
+
+// Reads everything pending on fd. Returns -1 if the device failed.
+static int capture_drain(capture *c, int fd, batch *out, key_state *held) {
+    struct input_event evs[READ_BATCH];
+    while (1) {
+        ssize_t r = read(fd, evs, sizeof(evs));
+        if (r < 0) return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        if (r == 0) return -1;
+        c->reads++;
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t now_us = timespec_us(&now);
+
+        size_t n = (size_t)r / sizeof(evs[0]);
+        c->events += n;
+        for (size_t i = 0; i < n; i++) {
+            const struct input_event *ev = &evs[i];
+            if (ev->type == EV_SYN) {
+                // SYN_DROPPED also closes the frame; the next snapshot repairs state
+                if (flush_frame_end(&out->flush, now_us)) batch_send(out);
+            } else if (batch_append(out, ev)) {
+                flush_note_event(&out->flush, ev->type, now_us);
+                key_state_update(held, ev);
+                if (out->events >= MAX_EVENTS_PER_BATCH) batch_send(out);
+            }
+        }
+        if (n < READ_BATCH) return 0;   // short read: queue is empty
+    }
+}
+
+// Earliest time something has to be sent, 0 if nothing is pending
+static uint64_t next_deadline(const batch *out, const key_state *held, const struct timespec *now) {
+    uint64_t deadline = flush_deadline(&out->flush);
+    if (!out->text_mode &&
+        (held->count > 0 || held->untracked > 0 || diff_us_since(now, &held->last_change) < SNAPSHOT_LINGER_US)) {
+        uint64_t snap = timespec_us(&held->last_snapshot) + SNAPSHOT_INTERVAL_US;
+        if (deadline == 0 || snap < deadline) deadline = snap;
+    }
+    return deadline;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-t] [-S] [-r N] [-L PCT] [-p US] [-d US] [-K] DEST_IP DEST_PORT /dev/input/eventX [/dev/input/eventY ...]\n", prog);
+    fprintf(stderr, "  -t      send the legacy text protocol instead of binary\n");
+    fprintf(stderr, "  -S      omit the sequence number, timestamps and epoch from binary datagrams\n");
+    fprintf(stderr, "  -r N    repeat the last N key transitions in every datagram (max %d)\n", HP_MAX_REDUNDANT);
+    fprintf(stderr, "  -L PCT  drop PCT %% of datagrams before sending (loss testing)\n");
+    fprintf(stderr, "  -p US   minimum spacing of motion-only datagrams (default %d, host poll interval)\n",
+            FLUSH_DEFAULT_PACE_US);
+    fprintf(stderr, "  -d US   longest any event is held back (default %d)\n", FLUSH_DEFAULT_DELAY_US);
+    fprintf(stderr, "  -K      pace key transitions like motion instead of sending them at once\n");
 }
 
 int main(int argc, char **argv) {
-    if (argc < 5) {
-        fprintf(stderr, "Usage: %s DEST_IP DEST_PORT /dev/input/eventX [/dev/input/eventY ...]\n", argv[0]);
+    int text_mode = 0;
+    uint8_t hdr_flags = HP_FLAG_SEQ | HP_FLAG_TIME | HP_FLAG_EPOCH;
+    int redundancy = 0;
+    double loss_pct = 0;
+    flush_config fc = {FLUSH_DEFAULT_PACE_US, FLUSH_DEFAULT_DELAY_US, true};
+    int opt;
+    while ((opt = getopt(argc, argv, "tSr:L:p:d:K")) != -1) {
+        switch (opt) {
+            case 't': text_mode = 1; break;  // legacy "K,code,value;" encoding for old receivers
+            case 'S': hdr_flags = 0; break;
+            case 'r': redundancy = atoi(optarg); break;
+            case 'L': loss_pct = atof(optarg); break;
+            case 'p': fc.motion_pace_us = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'd': fc.max_delay_us = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'K': fc.key_immediate = false; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    int argi = optind;
+
+    if (argc - argi < 3) {
+        usage(argv[0]);
         return 1;
     }
+    if (redundancy < 0 || redundancy > HP_MAX_REDUNDANT) {
+        fprintf(stderr, "-r must be between 0 and %d\n", HP_MAX_REDUNDANT);
+        return 1;
+    }
+    if (redundancy > 0 && (text_mode || !(hdr_flags & HP_FLAG_SEQ))) {
+        fprintf(stderr, "-r needs the binary protocol with sequence numbers\n");
+        return 1;
+    }
+    if (loss_pct > 0) srand48((long)time(NULL));
 
-    const char *dest_ip = argv[1];
-    int dest_port = atoi(argv[2]);
-    int dev_count = argc - 3;
+    const char *dest_ip = argv[argi];
+    int dest_port = atoi(argv[argi + 1]);
+    char **dev_paths = argv + argi + 2;
+    int dev_count = argc - argi - 2;
     if (dev_count > MAX_INPUT_DEVS) {
         fprintf(stderr, "Too many input devices (max %d)\n", MAX_INPUT_DEVS);
         return 1;
@@ -43,12 +389,15 @@ int main(int argc, char **argv) {
 
     int fds[MAX_INPUT_DEVS];
     for (int i = 0; i < dev_count; i++) {
-        const char *devpath = argv[i + 3];
+        const char *devpath = dev_paths[i];
         fds[i] = open(devpath, O_RDONLY | O_NONBLOCK);
         if (fds[i] < 0) {
             perror(devpath);
             return 1;
         }
+        // Event timestamps on the same clock as the send timestamp
+        int clk = CLOCK_MONOTONIC;
+        if (ioctl(fds[i], EVIOCSCLOCKID, &clk) < 0) perror("EVIOCSCLOCKID");
         printf("Opened: %s (fd=%d)\n", devpath, fds[i]);
     }
 
@@ -66,85 +415,66 @@ int main(int argc, char **argv) {
         return 1;
     }
 
-    printf("Sending to %s:%d\n", dest_ip, dest_port);
+    printf("Sending to %s:%d (%s protocol)\n", dest_ip, dest_port, text_mode ? "text" : "binary");
     fflush(stdout);
 
-    struct input_event ev;
-    char packet[MAX_PACKET_LEN];
-    int packet_len = 0, batch_events = 0, total_packets_sent = 0;
+    static batch out;
+    batch_init(&out, sock, &addr, text_mode, hdr_flags, redundancy, loss_pct, &fc);
 
-    struct timespec last_send;
-    clock_gettime(CLOCK_MONOTONIC, &last_send);
+    key_state held = {0};
 
-    while (1) {
-        fd_set readfds;
-        FD_ZERO(&readfds);
-        int max_fd = -1;
-        for (int i = 0; i < dev_count; i++) {
-            FD_SET(fds[i], &readfds);
-            if (fds[i] > max_fd) max_fd = fds[i];
-        }
+    capture cap;
+    if (capture_open(&cap, fds, dev_count) < 0) {
+        perror("epoll");
+        return 1;
+    }
+
+    struct sigaction sa = {0};
+    sa.sa_handler = on_signal;   // no SA_RESTART: interrupts epoll_wait
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
 
-        struct timeval timeout = {0, 2000};
-        int ret = select(max_fd + 1, &readfds, NULL, NULL, &timeout);
-        if (ret < 0) {
-            perror("select");
+    struct timespec now;
+    while (!stop_requested) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        capture_arm(&cap, next_deadline(&out, &held, &now));
+
+        struct epoll_event ready[MAX_INPUT_DEVS + 1];
+        int n = epoll_wait(cap.epfd, ready, MAX_INPUT_DEVS + 1, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
             break;
         }
+        cap.wakeups++;
 
-        for (int i = 0; i < dev_count; i++) {
-            if (FD_ISSET(fds[i], &readfds)) {
-                while (1) {
-                    ssize_t r = read(fds[i], &ev, sizeof(ev));
-                    if (r == sizeof(ev)) {
-                        char entry[64];
-                        int n = 0;
-
-                        if (ev.type == EV_REL || ev.code == 272 || ev.code == 273 || ev.code == 274) {
-                            n = snprintf(entry, sizeof(entry), "M,%d,%d;", ev.code, ev.value);
-                        } else if (ev.type == EV_KEY && ev.value < 2) {
-                            n = snprintf(entry, sizeof(entry), "K,%d,%d;", ev.code, ev.value);
-                        } else continue;
-
-                        if (packet_len + n < MAX_PACKET_LEN) {
-                            memcpy(packet + packet_len, entry, n);
-                            packet_len += n;
-                            batch_events++;
-                        }
-
-                        if (batch_events >= MAX_EVENTS_PER_BATCH) {
-                            sendto(sock, packet, packet_len, 0,
-                                   (struct sockaddr*)&addr, sizeof(addr));
-                            packet_len = 0;
-                            batch_events = 0;
-                            clock_gettime(CLOCK_MONOTONIC, &last_send);
-                            total_packets_sent++;
-                        }
-                    } else if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-                        break;
-                    } else {
-                        perror("read");
-                        goto cleanup;
-                    }
-                }
+        for (int i = 0; i < n; i++) {
+            uint32_t tag = ready[i].data.u32;
+            if (tag == CAPTURE_TIMER_TAG) {
+                uint64_t expirations;
+                if (read(cap.timer_fd, &expirations, sizeof(expirations)) > 0) cap.armed_us = 0;
+            } else if (capture_drain(&cap, fds[tag], &out, &held) < 0) {
+                perror(dev_paths[tag]);
+                goto cleanup;
             }
         }
 
-        struct timespec now;
         clock_gettime(CLOCK_MONOTONIC, &now);
-        long elapsed_us = diff_us_since(&now, &last_send);
-        if (packet_len > 0 && elapsed_us >= BATCH_SEND_TIMEOUT_US) {
-            sendto(sock, packet, packet_len, 0, (struct sockaddr*)&addr, sizeof(addr));
-            packet_len = 0;
-            batch_events = 0;
-            clock_gettime(CLOCK_MONOTONIC, &last_send);
-            total_packets_sent++;
+        if (!text_mode && snapshot_due(&held, &now)) {
+            send_snapshot(&out, &held, &now);
+        } else if (flush_due(&out.flush, timespec_us(&now))) {
+            batch_send(&out);
         }
     }
 
 cleanup:
-    printf("\nTotal packets sent: %d\n", total_packets_sent);
+    printf("\nTotal packets sent: %d\n", out.packets_sent);
+    printf("Wakeups: %lu, reads: %lu, events: %lu (%.1f events/read)\n", cap.wakeups, cap.reads,
+           cap.events, cap.reads ? (double)cap.events / (double)cap.reads : 0.0);
+    if (loss_pct > 0) printf("Dropped by loss injection: %d\n", out.packets_dropped);
     for (int i = 0; i < dev_count; i++) close(fds[i]);
+    close(cap.timer_fd);
+    close(cap.epfd);
     close(sock);
     return 0;
 }
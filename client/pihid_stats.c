@@ -0,0 +1,163 @@
+// Polls the stats channel (HS_PORT) of a pihidfi receiver and prints its
+// counters and per-stage latency.
+//
+// Usage: pihid_stats [-i SEC] [-n COUNT] [-r] PICO_IP
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include "hid_stats.h"
+
+// Build: gcc -O2 -I../common pihid_stats.c ../common/hid_stats.c -o pihid_stats
+
+#define REPLY_TIMEOUT_MS 1000
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-i SEC] [-n COUNT] [-r] PICO_IP\n", prog);
+    fprintf(stderr, "  -i SEC    poll every SEC seconds (default 1)\n");
+    fprintf(stderr, "  -n COUNT  stop after COUNT replies (default: run until interrupted)\n");
+    fprintf(stderr, "  -r        clear the latency histograms after every reply\n");
+}
+
+// Counters are cumulative; rates come from the previous reply
+static uint32_t prev[HS_CTR_COUNT];
+static bool have_prev;
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool is_gauge(uint8_t id) {
+    return id == HS_CTR_QUEUE_DEPTH || id == HS_CTR_QUEUE_HIGH ||
+           id == HS_CTR_SESSIONS || id == HS_CTR_RSSI ||
+           id == HS_CTR_EVENT_DEPTH || id == HS_CTR_EVENT_HIGH ||
+           id == HS_CTR_QUEUE_BYTES || id == HS_CTR_QUEUE_BYTES_HIGH;
+}
+
+static void print_counters(hs_reader *sec, double elapsed_s) {
+    uint8_t id;
+    uint32_t v;
+    int rc;
+    while ((rc = hs_next_counter(sec, &id, &v)) == 1) {
+        if (id >= HS_CTR_COUNT) continue;   // newer firmware
+        if (id == HS_CTR_RSSI) {
+            if ((int32_t)v != 0) printf("  %-16s %10ld\n", hs_counter_names[id], (long)(int32_t)v);
+            else printf("  %-16s %10s\n", hs_counter_names[id], "n/a");
+        } else if (is_gauge(id) || !have_prev) {
+            printf("  %-16s %10lu\n", hs_counter_names[id], (unsigned long)v);
+        } else {
+            printf("  %-16s %10lu  %+9.1f/s\n", hs_counter_names[id], (unsigned long)v,
+                   (double)(uint32_t)(v - prev[id]) / elapsed_s);
+        }
+        prev[id] = v;
+    }
+    if (rc < 0) printf("  (truncated counters section)\n");
+    have_prev = true;
+}
+
+static void print_latency(hs_reader *sec) {
+    hs_latency l;
+    int rc;
+    printf("  %-8s %9s %8s %8s %8s %8s %8s\n", "stage", "n", "min", "avg", "p50<=", "p99<=", "max");
+    while ((rc = hs_next_latency(sec, &l)) == 1) {
+        const char *name = l.stage < HS_STAGE_COUNT ? hs_stage_names[l.stage] : "?";
+        if (l.count == 0) {
+            printf("  %-8s %9s\n", name, "-");
+            continue;
+        }
+        printf("  %-8s %9lu %8lu %8lu %8lu %8lu %8lu\n", name, (unsigned long)l.count,
+               (unsigned long)l.min_us, (unsigned long)(l.sum_us / l.count),
+               (unsigned long)hs_latency_percentile(&l, 50),
+               (unsigned long)hs_latency_percentile(&l, 99), (unsigned long)l.max_us);
+    }
+    if (rc < 0) printf("  (truncated latency section)\n");
+}
+
+static int print_reply(const uint8_t *buf, size_t len, double elapsed_s) {
+    hs_reader r, sec;
+    uint8_t id;
+    if (hs_reader_init(&r, buf, len) < 0) {
+        fprintf(stderr, "bad reply (%zu bytes)\n", len);
+        return -1;
+    }
+    int rc;
+    while ((rc = hs_next_section(&r, &id, &sec)) == 1) {
+        if (id == HS_SEC_COUNTERS) {
+            printf("counters:\n");
+            print_counters(&sec, elapsed_s);
+        } else if (id == HS_SEC_LATENCY) {
+            printf("latency (us):\n");
+            print_latency(&sec);
+        }
+    }
+    if (rc < 0) fprintf(stderr, "truncated reply\n");
+    return rc;
+}
+
+int main(int argc, char **argv) {
+    double interval_s = 1.0;
+    long count = 0;
+    bool reset = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:n:r")) != -1) {
+        switch (opt) {
+            case 'i': interval_s = atof(optarg); break;
+            case 'n': count = atol(optarg); break;
+            case 'r': reset = true; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (argc - optind != 1 || interval_s <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    struct sockaddr_in dest = {0};
+    dest.sin_family = AF_INET;
+    dest.sin_port = htons(HS_PORT);
+    if (inet_pton(AF_INET, argv[optind], &dest.sin_addr) != 1) {
+        fprintf(stderr, "bad address: %s\n", argv[optind]);
+        return 1;
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return 1;
+    }
+    struct timeval tv = {REPLY_TIMEOUT_MS / 1000, (REPLY_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    double last_reply = 0;
+    for (long n = 0; count == 0 || n < count;) {
+        uint8_t req = reset ? HS_REQ_RESET : HS_REQ_SNAPSHOT;
+        if (sendto(fd, &req, 1, 0, (struct sockaddr *)&dest, sizeof(dest)) < 0) {
+            perror("sendto");
+            return 1;
+        }
+        uint8_t buf[HS_MAX_REPLY];
+        ssize_t len = recv(fd, buf, sizeof(buf), 0);
+        if (len < 0) {
+            fprintf(stderr, "no reply from %s\n", argv[optind]);
+        } else {
+            double t = now_s();
+            printf("── %s ──\n", argv[optind]);
+            print_reply(buf, (size_t)len, t - last_reply);
+            last_reply = t;
+            fflush(stdout);
+            n++;
+        }
+        if (count == 0 || n < count) usleep((useconds_t)(interval_s * 1e6));
+    }
+
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,433 @@
+#include "hid_proto.h"
+#include <string.h>
+
+// ───────────────────────────────
+// Byte cursor (walks segment chains when present)
+// ───────────────────────────────
+static bool refill(hp_reader *r) {
+    const uint8_t *data;
+    size_t len;
+    while (r->next_seg && r->next_seg(&r->seg, &data, &len)) {
+        if (len == 0) continue;
+        r->p = data;
+        r->end = data + len;
+        return true;
+    }
+    return false;
+}
+
+static inline bool read_byte(hp_reader *r, uint8_t *b) {
+    if (r->p >= r->end && !refill(r)) return false;
+    *b = *r->p++;
+    return true;
+}
+
+// ───────────────────────────────
+// Varint helpers (LEB128, zigzag for signed values)
+// ───────────────────────────────
+static inline size_t put_varint(uint8_t *out, uint32_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+static inline bool get_varint(hp_reader *r, uint32_t *v) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        uint8_t b;
+        if (!read_byte(r, &b)) return false;
+        result |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *v = result;
+            return true;
+        }
+    }
+    return false; // more than 5 bytes
+}
+
+static inline uint32_t zigzag_encode(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t zigzag_decode(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// ───────────────────────────────
+// Encoder
+// ───────────────────────────────
+static size_t ext_len(uint8_t flags) {
+    return ((flags & HP_FLAG_SEQ) ? 4 : 0) + ((flags & HP_FLAG_TIME) ? 6 : 0) +
+           ((flags & HP_FLAG_EPOCH) ? 2 : 0);
+}
+
+static inline void put_u32le(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+void hp_writer_init(hp_writer *w, uint8_t *buf, size_t cap) {
+    hp_writer_init_flags(w, buf, cap, 0);
+}
+
+void hp_writer_init_flags(hp_writer *w, uint8_t *buf, size_t cap, uint8_t flags) {
+    flags &= HP_FLAGS_KNOWN;
+    size_t hdr = HP_HEADER_LEN + ext_len(flags);
+    w->buf = buf;
+    w->cap = cap;
+    w->len = 0;
+    w->hdr_len = 0;
+    if (cap < hdr) return;
+    buf[0] = HP_MAGIC;
+    buf[1] = HP_VERSION;
+    buf[2] = flags;
+    memset(buf + HP_HEADER_LEN, 0, hdr - HP_HEADER_LEN);
+    w->hdr_len = (uint8_t)hdr;
+    w->len = hdr;
+}
+
+void hp_writer_reset(hp_writer *w) {
+    w->len = w->hdr_len;
+}
+
+void hp_writer_stamp(hp_writer *w, uint32_t seq, uint32_t send_us, uint32_t age_us) {
+    if (w->hdr_len < HP_HEADER_LEN) return;
+    uint8_t flags = w->buf[2];
+    uint8_t *p = w->buf + HP_HEADER_LEN;
+    if (flags & HP_FLAG_SEQ) {
+        put_u32le(p, seq);
+        p += 4;
+    }
+    if (flags & HP_FLAG_TIME) {
+        if (age_us > 0xFFFF) age_us = 0xFFFF;
+        put_u32le(p, send_us);
+        p[4] = (uint8_t)age_us;
+        p[5] = (uint8_t)(age_us >> 8);
+    }
+}
+
+void hp_writer_set_epoch(hp_writer *w, uint16_t epoch) {
+    if (w->hdr_len < HP_HEADER_LEN) return;
+    uint8_t flags = w->buf[2];
+    if (!(flags & HP_FLAG_EPOCH)) return;
+    // Last field of the extension
+    uint8_t *p = w->buf + HP_HEADER_LEN + ext_len(flags & (HP_FLAG_SEQ | HP_FLAG_TIME));
+    p[0] = (uint8_t)epoch;
+    p[1] = (uint8_t)(epoch >> 8);
+}
+
+bool hp_put_event(hp_writer *w, uint8_t type, uint16_t code, int32_t value) {
+    uint8_t rec[HP_MAX_RECORD_LEN];
+    size_t n;
+
+    if (type == HP_EV_KEY) {
+        if (value != 0 && value != 1) return false; // no autorepeat on the wire
+        rec[0] = HP_REC_KEY | (uint8_t)value;
+        n = 1 + put_varint(rec + 1, code);
+    } else if (type == HP_EV_REL) {
+        if (code > 0x0F) return false;
+        rec[0] = HP_REC_REL | (uint8_t)code;
+        n = 1 + put_varint(rec + 1, zigzag_encode(value));
+    } else {
+        return false;
+    }
+
+    if (w->len + n > w->cap) return false;
+    memcpy(w->buf + w->len, rec, n);
+    w->len += n;
+    return true;
+}
+
+static bool put_state(hp_writer *w, const uint16_t *codes, size_t n, uint8_t flags) {
+    uint8_t rec[1 + 1 + HP_MAX_STATE_CODES * 3];
+    if (n > HP_MAX_STATE_CODES) return false;
+
+    size_t len = 0;
+    rec[len++] = HP_REC_STATE | flags;
+    len += put_varint(rec + len, (uint32_t)n);
+    for (size_t i = 0; i < n; i++) len += put_varint(rec + len, codes[i]);
+
+    if (w->len + len > w->cap) return false;
+    memcpy(w->buf + w->len, rec, len);
+    w->len += len;
+    return true;
+}
+
+bool hp_put_state(hp_writer *w, const uint16_t *codes, size_t n) {
+    return put_state(w, codes, n, 0);
+}
+
+bool hp_put_partial_state(hp_writer *w, const uint16_t *codes, size_t n) {
+    return put_state(w, codes, n, HP_STATE_PARTIAL);
+}
+
+bool hp_put_redundant(hp_writer *w, uint32_t back, uint16_t code, bool pressed) {
+    uint8_t rec[1 + 5 + 3];
+    if (back == 0) return false;
+
+    size_t n = 0;
+    rec[n++] = HP_REC_REDUNDANT | (pressed ? 1 : 0);
+    n += put_varint(rec + n, back);
+    n += put_varint(rec + n, code);
+
+    if (w->len + n > w->cap) return false;
+    memcpy(w->buf + w->len, rec, n);
+    w->len += n;
+    return true;
+}
+
+// ───────────────────────────────
+// Transition history
+// ───────────────────────────────
+void hp_history_add(hp_history *h, uint32_t seq, uint16_t code, bool pressed) {
+    h->t[h->head].seq = seq;
+    h->t[h->head].code = code;
+    h->t[h->head].pressed = pressed;
+    h->head = (uint8_t)((h->head + 1) % HP_MAX_REDUNDANT);
+    if (h->count < HP_MAX_REDUNDANT) h->count++;
+}
+
+size_t hp_put_history(hp_writer *w, const hp_history *h, uint32_t seq, size_t n) {
+    if (n > h->count) n = h->count;
+    size_t written = 0;
+    for (size_t i = n; i > 0; i--) {
+        size_t idx = (h->head + HP_MAX_REDUNDANT - i) % HP_MAX_REDUNDANT;
+        uint32_t back = seq - h->t[idx].seq;
+        if (back == 0) continue;   // same datagram, not sent yet
+        if (!hp_put_redundant(w, back, h->t[idx].code, h->t[idx].pressed)) break;
+        written++;
+    }
+    return written;
+}
+
+// ───────────────────────────────
+// Decoder
+// ───────────────────────────────
+static bool read_u32le(hp_reader *r, uint32_t *v) {
+    uint32_t result = 0;
+    for (int i = 0; i < 4; i++) {
+        uint8_t b;
+        if (!read_byte(r, &b)) return false;
+        result |= (uint32_t)b << (8 * i);
+    }
+    *v = result;
+    return true;
+}
+
+// Reads [magic][version][flags] and the extension from the cursor
+static int read_header(hp_reader *r) {
+    uint8_t hdr[HP_HEADER_LEN];
+    for (int i = 0; i < HP_HEADER_LEN; i++) {
+        if (!read_byte(r, &hdr[i])) return -1;
+    }
+    if (hdr[0] != HP_MAGIC || hdr[1] != HP_VERSION) return -1;
+    if (hdr[2] & ~HP_FLAGS_KNOWN) return -1;
+    r->flags = hdr[2];
+    r->seq = 0;
+    r->send_us = 0;
+    r->age_us = 0;
+    r->epoch = 0;
+    r->state_left = 0;
+    r->state_open = false;
+    r->state_partial = false;
+
+    if ((r->flags & HP_FLAG_SEQ) && !read_u32le(r, &r->seq)) return -1;
+    if (r->flags & HP_FLAG_TIME) {
+        uint8_t lo, hi;
+        if (!read_u32le(r, &r->send_us)) return -1;
+        if (!read_byte(r, &lo) || !read_byte(r, &hi)) return -1;
+        r->age_us = (uint16_t)(lo | (hi << 8));
+    }
+    if (r->flags & HP_FLAG_EPOCH) {
+        uint8_t lo, hi;
+        if (!read_byte(r, &lo) || !read_byte(r, &hi)) return -1;
+        r->epoch = (uint16_t)(lo | (hi << 8));
+    }
+    return 0;
+}
+
+int hp_reader_init(hp_reader *r, const void *data, size_t len) {
+    const uint8_t *b = (const uint8_t *)data;
+    r->p = b;
+    r->end = b + len;
+    r->seg = NULL;
+    r->next_seg = NULL;
+    return read_header(r);
+}
+
+int hp_reader_init_chain(hp_reader *r, const void *chain, hp_seg_fn next_seg) {
+    r->p = r->end = NULL;
+    r->seg = chain;
+    r->next_seg = next_seg;
+    return read_header(r);
+}
+
+// Emits the remaining events of an open snapshot record
+static int next_state(hp_reader *r, hp_event *ev) {
+    ev->type = HP_EV_STATE;
+    ev->back = 0;
+    if (r->state_left > 0) {
+        uint32_t v;
+        if (!get_varint(r, &v) || v > 0xFFFF) return -1;
+        r->state_left--;
+        ev->code = (uint16_t)v;
+        ev->value = HP_STATE_HELD;
+        return 1;
+    }
+    r->state_open = false;
+    ev->code = r->state_partial ? HP_STATE_PARTIAL : 0;
+    ev->value = HP_STATE_END;
+    return 1;
+}
+
+int hp_next(hp_reader *r, hp_event *ev) {
+    if (r->state_open) return next_state(r, ev);
+
+    uint8_t tag;
+    if (!read_byte(r, &tag)) return 0;
+
+    uint32_t v;
+    switch (tag & 0xF0) {
+        case HP_REC_KEY:
+            if ((tag & 0x0F) > 1 || !get_varint(r, &v) || v > 0xFFFF) return -1;
+            ev->type = HP_EV_KEY;
+            ev->code = (uint16_t)v;
+            ev->value = tag & 0x01;
+            ev->back = 0;
+            return 1;
+        case HP_REC_REDUNDANT: {
+            uint32_t back;
+            if ((tag & 0x0F) > 1 || !get_varint(r, &back) || back == 0) return -1;
+            if (!get_varint(r, &v) || v > 0xFFFF) return -1;
+            ev->type = HP_EV_REDUNDANT;
+            ev->code = (uint16_t)v;
+            ev->value = tag & 0x01;
+            ev->back = back;
+            return 1;
+        }
+        case HP_REC_REL:
+            if (!get_varint(r, &v)) return -1;
+            ev->type = HP_EV_REL;
+            ev->code = tag & 0x0F;
+            ev->value = zigzag_decode(v);
+            ev->back = 0;
+            return 1;
+        case HP_REC_STATE:
+            if ((tag & 0x0F) > HP_STATE_PARTIAL || !get_varint(r, &v) || v > HP_MAX_STATE_CODES)
+                return -1;
+            r->state_left = (uint8_t)v;
+            r->state_open = true;
+            r->state_partial = tag & HP_STATE_PARTIAL;
+            return next_state(r, ev);
+        default:
+            return -1;
+    }
+}
+
+// ───────────────────────────────
+// Legacy text decoder
+// ───────────────────────────────
+void hp_text_init(hp_text_reader *r, const void *data, size_t len) {
+    r->p = (const uint8_t *)data;
+    r->end = r->p + len;
+    r->seg = NULL;
+    r->next_seg = NULL;
+    r->done = false;
+    r->errors = 0;
+    r->ignored = 0;
+}
+
+void hp_text_init_chain(hp_text_reader *r, const void *chain, hp_seg_fn next_seg) {
+    hp_text_init(r, NULL, 0);
+    r->seg = chain;
+    r->next_seg = next_seg;
+}
+
+// Next byte, or false (and 0) at the end of the text
+static inline bool text_byte(hp_text_reader *r, uint8_t *c) {
+    while (r->done || r->p >= r->end) {
+        const uint8_t *data;
+        size_t len;
+        if (r->done || !r->next_seg || !r->next_seg(&r->seg, &data, &len)) {
+            r->done = true;
+            *c = 0;
+            return false;
+        }
+        r->p = data;
+        r->end = data + len;
+    }
+    *c = *r->p++;
+    if (*c == 0) r->done = true;
+    return *c != 0;
+}
+
+static inline bool is_blank(uint8_t c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Decimal field: blanks, optional sign, digits. *c is left on the byte that
+// ended it (0 at the end of the text).
+static bool text_number(hp_text_reader *r, uint8_t *c, int32_t *out) {
+    bool more;
+    while ((more = text_byte(r, c)) && is_blank(*c)) {}
+    bool neg = false;
+    if (more && (*c == '-' || *c == '+')) {
+        neg = *c == '-';
+        more = text_byte(r, c);
+    }
+
+    uint32_t v = 0;
+    bool digits = false, overflow = false;
+    while (more && *c >= '0' && *c <= '9') {
+        uint32_t d = (uint32_t)(*c - '0');
+        if (v > (UINT32_C(0x80000000) - d) / 10) overflow = true;
+        else v = v * 10 + d;
+        digits = true;
+        more = text_byte(r, c);
+    }
+    if (!digits || overflow || v > (neg ? UINT32_C(0x80000000) : UINT32_C(0x7FFFFFFF))) return false;
+    *out = (int32_t)(neg ? -(int64_t)v : (int64_t)v);
+    return true;
+}
+
+static void text_skip_token(hp_text_reader *r, uint8_t c) {
+    while (c != ';' && text_byte(r, &c)) {}
+}
+
+int hp_text_next(hp_text_reader *r, hp_event *ev) {
+    uint8_t c;
+    while (text_byte(r, &c)) {
+        if (c == ';' || is_blank(c)) continue;
+        uint8_t kind = c;
+        if (kind != 'K' && kind != 'M') {
+            r->ignored++;
+            text_skip_token(r, c);
+            continue;
+        }
+
+        int32_t code, value;
+        bool ok = text_byte(r, &c) && c == ',' && text_number(r, &c, &code) &&
+                  c == ',' && text_number(r, &c, &value);
+        while (ok && is_blank(c) && text_byte(r, &c)) {}
+        if (!ok || (c != ';' && c != 0) || code < 0 || code > 0xFFFF) {
+            r->errors++;
+            text_skip_token(r, c);
+            continue;
+        }
+
+        // Mouse buttons travel as 'M' in the text format
+        bool button = code >= 272 && code <= 274;
+        ev->type = kind == 'K' || button ? HP_EV_KEY : HP_EV_REL;
+        ev->code = (uint16_t)code;
+        ev->value = value;
+        ev->back = 0;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,216 @@
+#ifndef HID_PROTO_H
+#define HID_PROTO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ───────────────────────────────
+// Binary wire protocol
+// ───────────────────────────────
+//
+// Datagram layout:
+//   [magic][version][flags] [extension] record record ...
+//
+// Optional header extension, in this order, selected by flags:
+//   HP_FLAG_SEQ    u32 LE datagram sequence number
+//   HP_FLAG_TIME   u32 LE sender clock (µs) at send time,
+//                  u16 LE age of the oldest event in the datagram (µs)
+//   HP_FLAG_EPOCH  u16 LE sender epoch, drawn when the sender starts; a
+//                  new epoch tells receivers the sequence started over
+//
+// Each record starts with a tag byte. The high nibble is the record kind,
+// the low nibble carries a small inline argument:
+//   0x10 | pressed      key/button transition, followed by code (varint)
+//   0x20 | REL_* axis   relative motion, followed by value (zigzag varint)
+//   0x30 | partial      key-state snapshot: count (varint), then the code
+//                       (varint) of every key and button currently held
+//   0x40 | pressed      repeated key/button transition from an earlier
+//                       datagram: distance back in sequence numbers
+//                       (varint, >= 1), then code (varint)
+//
+// A snapshot is the sender's complete key/button state after the records
+// before it; receivers reconcile against it to recover from lost releases.
+// A partial snapshot (more held than HP_MAX_STATE_CODES) lists only some of
+// them; receivers add what it lists and release nothing.
+// Repeated transitions come first in a datagram, oldest first; receivers
+// apply them only when the datagram they were first sent in was lost.
+//
+// Datagrams that do not start with HP_MAGIC are the legacy text format
+// ("K,code,value;M,code,value;...") and are still accepted by receivers.
+
+#define HP_MAGIC          0xA5
+#define HP_VERSION        1
+#define HP_HEADER_LEN     3
+#define HP_MAX_RECORD_LEN 6   // tag + 5-byte varint
+
+#define HP_FLAG_SEQ       0x01
+#define HP_FLAG_TIME      0x02
+#define HP_FLAG_EPOCH     0x04
+#define HP_FLAGS_KNOWN    (HP_FLAG_SEQ | HP_FLAG_TIME | HP_FLAG_EPOCH)
+#define HP_MAX_EXT_LEN    12
+#define HP_MAX_STATE_CODES 32
+
+// Event types, same values as linux/input-event-codes.h
+#define HP_EV_KEY 0x01
+#define HP_EV_REL 0x02
+
+// Decoded from snapshot records: one HP_STATE_HELD event per held code,
+// then a single HP_STATE_END event closing the snapshot (code 0, or
+// HP_STATE_PARTIAL for a partial snapshot)
+#define HP_EV_STATE    0xF0
+#define HP_STATE_HELD  1
+#define HP_STATE_END   2
+#define HP_STATE_PARTIAL 0x01
+
+// Decoded from repeated-transition records; hp_event.back tells how many
+// sequence numbers earlier the transition was first sent
+#define HP_EV_REDUNDANT 0xF1
+
+// Record kinds (high nibble of the tag byte)
+#define HP_REC_KEY 0x10
+#define HP_REC_REL 0x20
+#define HP_REC_STATE 0x30
+#define HP_REC_REDUNDANT 0x40
+
+typedef struct {
+    uint8_t  type;    // HP_EV_KEY or HP_EV_REL
+    uint16_t code;    // Linux KEY_* / BTN_* / REL_* code
+    int32_t  value;   // 0/1 for keys, delta for relative axes
+    uint32_t back;    // HP_EV_REDUNDANT only
+} hp_event;
+
+// Encoder writing records into a caller-owned buffer
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;
+    uint8_t hdr_len;   // header plus extension
+} hp_writer;
+
+// Starts a new datagram (writes the header)
+void hp_writer_init(hp_writer *w, uint8_t *buf, size_t cap);
+
+// Same, reserving room for the header extension selected by flags
+void hp_writer_init_flags(hp_writer *w, uint8_t *buf, size_t cap, uint8_t flags);
+
+// Fills the header extension just before sending. Fields not selected at
+// init are ignored; age_us saturates at 65535.
+void hp_writer_stamp(hp_writer *w, uint32_t seq, uint32_t send_us, uint32_t age_us);
+
+// Fills the HP_FLAG_EPOCH field (ignored if not selected at init). It stays
+// in place across hp_writer_reset() and hp_writer_stamp().
+void hp_writer_set_epoch(hp_writer *w, uint16_t epoch);
+
+// Drops all records but keeps the header
+void hp_writer_reset(hp_writer *w);
+
+// Appends one event. Returns false if it does not fit or cannot be encoded
+// (e.g. key autorepeat values).
+bool hp_put_event(hp_writer *w, uint8_t type, uint16_t code, int32_t value);
+
+// Appends a key-state snapshot of n held codes (n <= HP_MAX_STATE_CODES).
+// Returns false if it does not fit.
+bool hp_put_state(hp_writer *w, const uint16_t *codes, size_t n);
+
+// Same, for a sender holding more codes than the n it lists
+bool hp_put_partial_state(hp_writer *w, const uint16_t *codes, size_t n);
+
+// Appends a repeated transition first sent `back` datagrams earlier
+bool hp_put_redundant(hp_writer *w, uint32_t back, uint16_t code, bool pressed);
+
+// Recent key/button transitions kept by a sender for repetition
+#define HP_MAX_REDUNDANT 16
+
+typedef struct {
+    struct {
+        uint32_t seq;      // datagram the transition was first sent in
+        uint16_t code;
+        uint8_t pressed;
+    } t[HP_MAX_REDUNDANT];
+    uint8_t head;          // next slot to overwrite
+    uint8_t count;
+} hp_history;
+
+void hp_history_add(hp_history *h, uint32_t seq, uint16_t code, bool pressed);
+
+// Appends up to n of the most recent transitions sent before seq, oldest
+// first, as repeated-transition records of datagram seq. Returns the
+// number written (stops early when the buffer is full).
+size_t hp_put_history(hp_writer *w, const hp_history *h, uint32_t seq, size_t n);
+
+// True when no records have been written since init/reset
+static inline bool hp_writer_empty(const hp_writer *w) {
+    return w->len <= w->hdr_len;
+}
+
+// Segment walker for datagrams split across several buffers (lwIP pbuf
+// chains on the Pico). Returns the payload of *seg, advances *seg to the
+// following segment, and returns false once the chain is exhausted.
+typedef bool (*hp_seg_fn)(const void **seg, const uint8_t **data, size_t *len);
+
+// Decoder over one datagram
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    const void *seg;      // next segment, chained datagrams only
+    hp_seg_fn next_seg;   // NULL for contiguous datagrams
+    uint8_t flags;
+    uint32_t seq;         // valid if flags & HP_FLAG_SEQ
+    uint32_t send_us;     // valid if flags & HP_FLAG_TIME
+    uint16_t age_us;      // valid if flags & HP_FLAG_TIME
+    uint16_t epoch;       // valid if flags & HP_FLAG_EPOCH
+    uint8_t state_left;   // snapshot codes still to decode
+    bool state_open;      // snapshot END event still to emit
+    bool state_partial;   // the open snapshot is partial
+} hp_reader;
+
+// True if the datagram uses the binary framing
+static inline bool hp_is_binary(const void *data, size_t len) {
+    return len >= HP_HEADER_LEN && ((const uint8_t *)data)[0] == HP_MAGIC;
+}
+
+// Returns 0 on success, -1 for a bad header, unsupported version or flags
+int hp_reader_init(hp_reader *r, const void *data, size_t len);
+
+// Same as hp_reader_init, but reads straight out of a segment chain
+int hp_reader_init_chain(hp_reader *r, const void *chain, hp_seg_fn next_seg);
+
+// Returns 1 when an event was decoded, 0 at end of datagram, -1 if malformed
+int hp_next(hp_reader *r, hp_event *ev);
+
+// ───────────────────────────────
+// Legacy text format
+// ───────────────────────────────
+//
+// "K,code,value;M,code,value;..." with decimal fields, decoded in place in
+// one pass into the same events binary records give: K tokens and M tokens
+// for BTN_LEFT..BTN_MIDDLE are HP_EV_KEY, other M tokens HP_EV_REL.
+// A NUL byte ends the text.
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    const void *seg;      // next segment, chained datagrams only
+    hp_seg_fn next_seg;   // NULL for contiguous datagrams
+    bool done;
+    uint32_t errors;      // malformed K/M tokens skipped
+    uint32_t ignored;     // tokens of other kinds skipped
+} hp_text_reader;
+
+void hp_text_init(hp_text_reader *r, const void *data, size_t len);
+void hp_text_init_chain(hp_text_reader *r, const void *chain, hp_seg_fn next_seg);
+
+// Returns 1 when an event was decoded, 0 at the end of the text.
+// Malformed tokens are skipped and counted, decoding goes on after them.
+int hp_text_next(hp_text_reader *r, hp_event *ev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HID_PROTO_H
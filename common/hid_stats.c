@@ -0,0 +1,164 @@
+#include "hid_stats.h"
+#include <string.h>
+
+const char *const hs_stage_names[HS_STAGE_COUNT] = {
+    "client", "network", "queue", "parse", "usb", "total", "apply",
+};
+
+const char *const hs_counter_names[HS_CTR_COUNT] = {
+    "udp_rx", "packets", "queue_depth", "queue_high", "queue_dropped", "queue_truncated",
+    "parse_errors", "seq_lost", "seq_stale", "resyncs", "recovered",
+    "reports_sent", "ready_stalls", "kbd_overwritten", "sessions", "rssi_dbm",
+    "event_depth", "event_high", "event_waits", "queue_bytes", "queue_bytes_high",
+    "seq_restarts",
+};
+
+// ───────────────────────────────
+// Encoder
+// ───────────────────────────────
+static void put_bytes(hs_writer *w, const uint8_t *b, size_t n) {
+    if (w->overflow || w->len + n > w->cap) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, b, n);
+    w->len += n;
+}
+
+void hs_put_u8(hs_writer *w, uint8_t v) {
+    put_bytes(w, &v, 1);
+}
+
+void hs_put_u16(hs_writer *w, uint16_t v) {
+    uint8_t b[2] = {(uint8_t)v, (uint8_t)(v >> 8)};
+    put_bytes(w, b, 2);
+}
+
+void hs_put_u32(hs_writer *w, uint32_t v) {
+    uint8_t b[4] = {(uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24)};
+    put_bytes(w, b, 4);
+}
+
+void hs_put_u64(hs_writer *w, uint64_t v) {
+    hs_put_u32(w, (uint32_t)v);
+    hs_put_u32(w, (uint32_t)(v >> 32));
+}
+
+void hs_writer_init(hs_writer *w, uint8_t *buf, size_t cap) {
+    w->buf = buf;
+    w->cap = cap;
+    w->len = 0;
+    w->section_start = 0;
+    w->overflow = false;
+    const uint8_t hdr[HS_HEADER_LEN] = {'P', 'S', HS_VERSION, 0};
+    put_bytes(w, hdr, sizeof(hdr));
+}
+
+void hs_begin_section(hs_writer *w, uint8_t id) {
+    hs_put_u8(w, id);
+    w->section_start = w->len;
+    hs_put_u16(w, 0); // patched in hs_end_section
+}
+
+void hs_end_section(hs_writer *w) {
+    if (w->overflow) return;
+    size_t payload = w->len - w->section_start - 2;
+    w->buf[w->section_start] = (uint8_t)payload;
+    w->buf[w->section_start + 1] = (uint8_t)(payload >> 8);
+    w->buf[3]++;
+}
+
+size_t hs_writer_finish(hs_writer *w) {
+    return w->overflow ? 0 : w->len;
+}
+
+// ───────────────────────────────
+// Decoder
+// ───────────────────────────────
+static bool get_bytes(hs_reader *r, uint8_t *b, size_t n) {
+    if ((size_t)(r->end - r->p) < n) return false;
+    memcpy(b, r->p, n);
+    r->p += n;
+    return true;
+}
+
+bool hs_get_u8(hs_reader *r, uint8_t *v) {
+    return get_bytes(r, v, 1);
+}
+
+bool hs_get_u16(hs_reader *r, uint16_t *v) {
+    uint8_t b[2];
+    if (!get_bytes(r, b, 2)) return false;
+    *v = (uint16_t)(b[0] | (b[1] << 8));
+    return true;
+}
+
+bool hs_get_u32(hs_reader *r, uint32_t *v) {
+    uint8_t b[4];
+    if (!get_bytes(r, b, 4)) return false;
+    *v = (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+    return true;
+}
+
+bool hs_get_u64(hs_reader *r, uint64_t *v) {
+    uint32_t lo, hi;
+    if (!hs_get_u32(r, &lo) || !hs_get_u32(r, &hi)) return false;
+    *v = ((uint64_t)hi << 32) | lo;
+    return true;
+}
+
+int hs_reader_init(hs_reader *r, const void *data, size_t len) {
+    const uint8_t *b = (const uint8_t *)data;
+    if (len < HS_HEADER_LEN || b[0] != 'P' || b[1] != 'S' || b[2] != HS_VERSION) return -1;
+    r->p = b + HS_HEADER_LEN;
+    r->end = b + len;
+    return 0;
+}
+
+int hs_next_section(hs_reader *r, uint8_t *id, hs_reader *payload) {
+    if (r->p >= r->end) return 0;
+    uint16_t len;
+    if (!hs_get_u8(r, id) || !hs_get_u16(r, &len)) return -1;
+    if ((size_t)(r->end - r->p) < len) return -1;
+    payload->p = r->p;
+    payload->end = r->p + len;
+    r->p += len;
+    return 1;
+}
+
+int hs_next_latency(hs_reader *section, hs_latency *out) {
+    if (section->p >= section->end) return 0;
+    if (!hs_get_u8(section, &out->stage) ||
+        !hs_get_u32(section, &out->count) ||
+        !hs_get_u32(section, &out->min_us) ||
+        !hs_get_u32(section, &out->max_us) ||
+        !hs_get_u64(section, &out->sum_us) ||
+        !hs_get_u8(section, &out->nbuckets)) return -1;
+    if (out->nbuckets > HS_MAX_BUCKETS) return -1;
+    for (uint8_t i = 0; i < out->nbuckets; i++) {
+        if (!hs_get_u32(section, &out->buckets[i])) return -1;
+    }
+    return 1;
+}
+
+int hs_next_counter(hs_reader *section, uint8_t *id, uint32_t *value) {
+    if (section->p >= section->end) return 0;
+    if (!hs_get_u8(section, id) || !hs_get_u32(section, value)) return -1;
+    return 1;
+}
+
+uint32_t hs_latency_percentile(const hs_latency *l, unsigned pct) {
+    if (l->count == 0) return 0;
+    uint64_t rank = ((uint64_t)l->count * pct + 99) / 100;
+    if (rank == 0) rank = 1;
+
+    uint64_t seen = 0;
+    for (uint8_t b = 0; b < l->nbuckets; b++) {
+        seen += l->buckets[b];
+        if (seen >= rank) {
+            uint32_t upper = b == 0 ? 0 : (uint32_t)((1ull << b) - 1);
+            return upper < l->max_us ? upper : l->max_us;
+        }
+    }
+    return l->max_us;
+}
@@ -0,0 +1,149 @@
+#ifndef HID_STATS_H
+#define HID_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ───────────────────────────────
+// Stats channel
+// ───────────────────────────────
+//
+// Any datagram sent to HS_PORT is answered with one stats reply. If the
+// first request byte is HS_REQ_RESET the latency histograms are cleared
+// afterwards; counters run from boot, pollers take differences.
+//
+// Reply layout (all integers little-endian):
+//   ['P']['S'][version][section count] section section ...
+//   section: [id u8][payload length u16][payload]
+// Readers skip sections they do not know.
+//
+// HS_SEC_LATENCY payload, repeated per stage:
+//   [stage u8][count u32][min u32][max u32][sum u64][nbuckets u8][bucket u32 × n]
+//   Bucket 0 holds 0 µs, bucket i holds [2^(i-1), 2^i) µs.
+//
+// HS_SEC_COUNTERS payload, repeated per counter:
+//   [counter u8][value u32]
+//   Readers skip counter ids they do not know. HS_CTR_RSSI is signed (dBm).
+
+#define HS_PORT          50038
+#define HS_VERSION       1
+#define HS_HEADER_LEN    4
+#define HS_MAX_REPLY     1400
+#define HS_MAX_BUCKETS   32
+
+#define HS_REQ_SNAPSHOT  0x00
+#define HS_REQ_RESET     0x01
+
+#define HS_SEC_LATENCY   0x01
+#define HS_SEC_COUNTERS  0x02
+
+// Pipeline stages with a latency histogram
+enum {
+    HS_STAGE_CLIENT,    // oldest event capture → datagram send (sender clock)
+    HS_STAGE_NETWORK,   // one-way delay above the lowest delay seen
+    HS_STAGE_QUEUE,     // UDP receive → dequeue by the parser
+    HS_STAGE_PARSE,     // dequeue → datagram parsed and dispatched
+    HS_STAGE_USB,       // report queued → report complete (host read the endpoint)
+    HS_STAGE_TOTAL,     // UDP receive → report complete
+    HS_STAGE_APPLY,     // parser picks the datagram up → core0 applies its events
+    HS_STAGE_COUNT
+};
+
+extern const char *const hs_stage_names[HS_STAGE_COUNT];
+
+// Counters in an HS_SEC_COUNTERS section
+enum {
+    HS_CTR_UDP_RX,          // datagrams seen by the UDP callback
+    HS_CTR_PACKETS,         // datagrams parsed
+    HS_CTR_QUEUE_DEPTH,     // packets waiting right now
+    HS_CTR_QUEUE_HIGH,      // most packets queued at once since boot
+    HS_CTR_QUEUE_DROPPED,   // datagrams dropped, queue full
+    HS_CTR_QUEUE_TRUNCATED, // datagrams longer than PACKET_MAX_LEN
+    HS_CTR_PARSE_ERRORS,
+    HS_CTR_SEQ_LOST,
+    HS_CTR_SEQ_STALE,
+    HS_CTR_RESYNCS,
+    HS_CTR_RECOVERED,
+    HS_CTR_REPORTS_SENT,    // HID reports accepted by an endpoint
+    HS_CTR_READY_STALLS,    // reports that found their endpoint busy
+    HS_CTR_KBD_OVERWRITTEN, // keyboard states lost to a full report queue
+    HS_CTR_SESSIONS,        // senders with an open session
+    HS_CTR_RSSI,            // Wi-Fi signal, dBm (signed)
+    HS_CTR_EVENT_DEPTH,     // decoded events waiting for core0 right now
+    HS_CTR_EVENT_HIGH,      // deepest event ring occupancy since boot
+    HS_CTR_EVENT_WAITS,     // times the parser found the event ring full
+    HS_CTR_QUEUE_BYTES,     // packet ring bytes in use right now
+    HS_CTR_QUEUE_BYTES_HIGH,// most packet ring bytes in use since boot
+    HS_CTR_SEQ_RESTARTS,    // senders that restarted their sequence (new epoch)
+    HS_CTR_COUNT
+};
+
+extern const char *const hs_counter_names[HS_CTR_COUNT];
+
+// Encoder
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;
+    size_t section_start;
+    bool overflow;
+} hs_writer;
+
+void hs_writer_init(hs_writer *w, uint8_t *buf, size_t cap);
+void hs_begin_section(hs_writer *w, uint8_t id);
+void hs_end_section(hs_writer *w);
+void hs_put_u8(hs_writer *w, uint8_t v);
+void hs_put_u16(hs_writer *w, uint16_t v);
+void hs_put_u32(hs_writer *w, uint32_t v);
+void hs_put_u64(hs_writer *w, uint64_t v);
+
+// Returns the reply length, or 0 if it did not fit
+size_t hs_writer_finish(hs_writer *w);
+
+// Decoder
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} hs_reader;
+
+// Returns 0 on success, -1 for a bad header or version
+int hs_reader_init(hs_reader *r, const void *data, size_t len);
+
+// Returns 1 and a reader over the payload, 0 at the end, -1 if truncated
+int hs_next_section(hs_reader *r, uint8_t *id, hs_reader *payload);
+
+bool hs_get_u8(hs_reader *r, uint8_t *v);
+bool hs_get_u16(hs_reader *r, uint16_t *v);
+bool hs_get_u32(hs_reader *r, uint32_t *v);
+bool hs_get_u64(hs_reader *r, uint64_t *v);
+
+// One decoded HS_SEC_LATENCY entry
+typedef struct {
+    uint8_t stage;
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint8_t nbuckets;
+    uint32_t buckets[HS_MAX_BUCKETS];
+} hs_latency;
+
+// Returns 1 when an entry was decoded, 0 at the end of the section, -1 if malformed
+int hs_next_latency(hs_reader *section, hs_latency *out);
+
+// Upper bound (µs) of the bucket holding the pct-th percentile, capped at max
+uint32_t hs_latency_percentile(const hs_latency *l, unsigned pct);
+
+// One HS_SEC_COUNTERS entry; same return values as hs_next_latency
+int hs_next_counter(hs_reader *section, uint8_t *id, uint32_t *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HID_STATS_H
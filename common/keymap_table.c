@@ -0,0 +1,290 @@
+#include "keymap_table.h"
+
+// ───────────────────────────────
+// Translation table
+// ───────────────────────────────
+// Keyboard page usages follow the HID Usage Tables; keys that Linux reports
+// from the Consumer page (hid-input.c) go there too, so volume and media keys
+// work on hosts that ignore the keyboard-page volume usages. Windows codes
+// are the numeric VK_* values (windows.h is not available here).
+
+#define KB(usage, vk) { KEYMAP_PAGE_KEYBOARD, (vk), (usage) }
+#define CC(usage, vk) { KEYMAP_PAGE_CONSUMER, (vk), (usage) }
+
+const keymap_entry keymap_table[KEYMAP_SIZE] = {
+    [1]   = KB(0x29, 0x1B),   // KEY_ESC
+    [2]   = KB(0x1E, '1'),    // KEY_1
+    [3]   = KB(0x1F, '2'),    // KEY_2
+    [4]   = KB(0x20, '3'),    // KEY_3
+    [5]   = KB(0x21, '4'),    // KEY_4
+    [6]   = KB(0x22, '5'),    // KEY_5
+    [7]   = KB(0x23, '6'),    // KEY_6
+    [8]   = KB(0x24, '7'),    // KEY_7
+    [9]   = KB(0x25, '8'),    // KEY_8
+    [10]  = KB(0x26, '9'),    // KEY_9
+    [11]  = KB(0x27, '0'),    // KEY_0
+    [12]  = KB(0x2D, 0xBD),   // KEY_MINUS
+    [13]  = KB(0x2E, 0xBB),   // KEY_EQUAL
+    [14]  = KB(0x2A, 0x08),   // KEY_BACKSPACE
+    [15]  = KB(0x2B, 0x09),   // KEY_TAB
+    [16]  = KB(0x14, 'Q'),    // KEY_Q
+    [17]  = KB(0x1A, 'W'),    // KEY_W
+    [18]  = KB(0x08, 'E'),    // KEY_E
+    [19]  = KB(0x15, 'R'),    // KEY_R
+    [20]  = KB(0x17, 'T'),    // KEY_T
+    [21]  = KB(0x1C, 'Y'),    // KEY_Y
+    [22]  = KB(0x18, 'U'),    // KEY_U
+    [23]  = KB(0x0C, 'I'),    // KEY_I
+    [24]  = KB(0x12, 'O'),    // KEY_O
+    [25]  = KB(0x13, 'P'),    // KEY_P
+    [26]  = KB(0x2F, 0xDB),   // KEY_LEFTBRACE
+    [27]  = KB(0x30, 0xDD),   // KEY_RIGHTBRACE
+    [28]  = KB(0x28, 0x0D),   // KEY_ENTER
+    [29]  = KB(0xE0, 0xA2),   // KEY_LEFTCTRL
+    [30]  = KB(0x04, 'A'),    // KEY_A
+    [31]  = KB(0x16, 'S'),    // KEY_S
+    [32]  = KB(0x07, 'D'),    // KEY_D
+    [33]  = KB(0x09, 'F'),    // KEY_F
+    [34]  = KB(0x0A, 'G'),    // KEY_G
+    [35]  = KB(0x0B, 'H'),    // KEY_H
+    [36]  = KB(0x0D, 'J'),    // KEY_J
+    [37]  = KB(0x0E, 'K'),    // KEY_K
+    [38]  = KB(0x0F, 'L'),    // KEY_L
+    [39]  = KB(0x33, 0xBA),   // KEY_SEMICOLON
+    [40]  = KB(0x34, 0xDE),   // KEY_APOSTROPHE
+    [41]  = KB(0x35, 0xC0),   // KEY_GRAVE
+    [42]  = KB(0xE1, 0xA0),   // KEY_LEFTSHIFT
+    [43]  = KB(0x31, 0xDC),   // KEY_BACKSLASH
+    [44]  = KB(0x1D, 'Z'),    // KEY_Z
+    [45]  = KB(0x1B, 'X'),    // KEY_X
+    [46]  = KB(0x06, 'C'),    // KEY_C
+    [47]  = KB(0x19, 'V'),    // KEY_V
+    [48]  = KB(0x05, 'B'),    // KEY_B
+    [49]  = KB(0x11, 'N'),    // KEY_N
+    [50]  = KB(0x10, 'M'),    // KEY_M
+    [51]  = KB(0x36, 0xBC),   // KEY_COMMA
+    [52]  = KB(0x37, 0xBE),   // KEY_DOT
+    [53]  = KB(0x38, 0xBF),   // KEY_SLASH
+    [54]  = KB(0xE5, 0xA1),   // KEY_RIGHTSHIFT
+    [55]  = KB(0x55, 0x6A),   // KEY_KPASTERISK
+    [56]  = KB(0xE2, 0xA4),   // KEY_LEFTALT
+    [57]  = KB(0x2C, 0x20),   // KEY_SPACE
+    [58]  = KB(0x39, 0x14),   // KEY_CAPSLOCK
+    [59]  = KB(0x3A, 0x70),   // KEY_F1
+    [60]  = KB(0x3B, 0x71),   // KEY_F2
+    [61]  = KB(0x3C, 0x72),   // KEY_F3
+    [62]  = KB(0x3D, 0x73),   // KEY_F4
+    [63]  = KB(0x3E, 0x74),   // KEY_F5
+    [64]  = KB(0x3F, 0x75),   // KEY_F6
+    [65]  = KB(0x40, 0x76),   // KEY_F7
+    [66]  = KB(0x41, 0x77),   // KEY_F8
+    [67]  = KB(0x42, 0x78),   // KEY_F9
+    [68]  = KB(0x43, 0x79),   // KEY_F10
+    [69]  = KB(0x53, 0x90),   // KEY_NUMLOCK
+    [70]  = KB(0x47, 0x91),   // KEY_SCROLLLOCK
+    [71]  = KB(0x5F, 0x67),   // KEY_KP7
+    [72]  = KB(0x60, 0x68),   // KEY_KP8
+    [73]  = KB(0x61, 0x69),   // KEY_KP9
+    [74]  = KB(0x56, 0x6D),   // KEY_KPMINUS
+    [75]  = KB(0x5C, 0x64),   // KEY_KP4
+    [76]  = KB(0x5D, 0x65),   // KEY_KP5
+    [77]  = KB(0x5E, 0x66),   // KEY_KP6
+    [78]  = KB(0x57, 0x6B),   // KEY_KPPLUS
+    [79]  = KB(0x59, 0x61),   // KEY_KP1
+    [80]  = KB(0x5A, 0x62),   // KEY_KP2
+    [81]  = KB(0x5B, 0x63),   // KEY_KP3
+    [82]  = KB(0x62, 0x60),   // KEY_KP0
+    [83]  = KB(0x63, 0x6E),   // KEY_KPDOT
+    [85]  = KB(0x94, 0x00),   // KEY_ZENKAKUHANKAKU
+    [86]  = KB(0x64, 0xE2),   // KEY_102ND
+    [87]  = KB(0x44, 0x7A),   // KEY_F11
+    [88]  = KB(0x45, 0x7B),   // KEY_F12
+    [89]  = KB(0x87, 0xC1),   // KEY_RO
+    [90]  = KB(0x92, 0x00),   // KEY_KATAKANA
+    [91]  = KB(0x93, 0x00),   // KEY_HIRAGANA
+    [92]  = KB(0x8A, 0x1C),   // KEY_HENKAN
+    [93]  = KB(0x88, 0x00),   // KEY_KATAKANAHIRAGANA
+    [94]  = KB(0x8B, 0x1D),   // KEY_MUHENKAN
+    [95]  = KB(0x8C, 0x00),   // KEY_KPJPCOMMA
+    [96]  = KB(0x58, 0x0D),   // KEY_KPENTER
+    [97]  = KB(0xE4, 0xA3),   // KEY_RIGHTCTRL
+    [98]  = KB(0x54, 0x6F),   // KEY_KPSLASH
+    [99]  = KB(0x46, 0x2C),   // KEY_SYSRQ
+    [100] = KB(0xE6, 0xA5),   // KEY_RIGHTALT
+    [102] = KB(0x4A, 0x24),   // KEY_HOME
+    [103] = KB(0x52, 0x26),   // KEY_UP
+    [104] = KB(0x4B, 0x21),   // KEY_PAGEUP
+    [105] = KB(0x50, 0x25),   // KEY_LEFT
+    [106] = KB(0x4F, 0x27),   // KEY_RIGHT
+    [107] = KB(0x4D, 0x23),   // KEY_END
+    [108] = KB(0x51, 0x28),   // KEY_DOWN
+    [109] = KB(0x4E, 0x22),   // KEY_PAGEDOWN
+    [110] = KB(0x49, 0x2D),   // KEY_INSERT
+    [111] = KB(0x4C, 0x2E),   // KEY_DELETE
+    [113] = CC(0xE2, 0xAD),   // KEY_MUTE
+    [114] = CC(0xEA, 0xAE),   // KEY_VOLUMEDOWN
+    [115] = CC(0xE9, 0xAF),   // KEY_VOLUMEUP
+    [116] = KB(0x66, 0x00),   // KEY_POWER
+    [117] = KB(0x67, 0x00),   // KEY_KPEQUAL
+    [118] = KB(0xD7, 0x00),   // KEY_KPPLUSMINUS
+    [119] = KB(0x48, 0x13),   // KEY_PAUSE
+    [120] = CC(0x29F, 0x00),  // KEY_SCALE
+    [121] = KB(0x85, 0x6C),   // KEY_KPCOMMA
+    [122] = KB(0x90, 0x15),   // KEY_HANGEUL
+    [123] = KB(0x91, 0x19),   // KEY_HANJA
+    [124] = KB(0x89, 0x00),   // KEY_YEN
+    [125] = KB(0xE3, 0x5B),   // KEY_LEFTMETA
+    [126] = KB(0xE7, 0x5C),   // KEY_RIGHTMETA
+    [127] = KB(0x65, 0x5D),   // KEY_COMPOSE
+    [128] = KB(0x78, 0x00),   // KEY_STOP
+    [129] = KB(0x79, 0x00),   // KEY_AGAIN
+    [130] = KB(0x76, 0x00),   // KEY_PROPS
+    [131] = KB(0x7A, 0x00),   // KEY_UNDO
+    [132] = KB(0x77, 0x00),   // KEY_FRONT
+    [133] = KB(0x7C, 0x00),   // KEY_COPY
+    [134] = KB(0x74, 0x00),   // KEY_OPEN
+    [135] = KB(0x7D, 0x00),   // KEY_PASTE
+    [136] = KB(0x7E, 0x00),   // KEY_FIND
+    [137] = KB(0x7B, 0x00),   // KEY_CUT
+    [138] = KB(0x75, 0x2F),   // KEY_HELP
+    [139] = CC(0x40, 0x00),   // KEY_MENU
+    [140] = CC(0x192, 0xB7),  // KEY_CALC
+    [142] = CC(0x32, 0x5F),   // KEY_SLEEP
+    [144] = CC(0x194, 0xB6),  // KEY_FILE
+    [150] = CC(0x196, 0x00),  // KEY_WWW
+    [152] = CC(0x19E, 0x00),  // KEY_COFFEE
+    [155] = CC(0x18A, 0xB4),  // KEY_MAIL
+    [156] = CC(0x22A, 0xAB),  // KEY_BOOKMARKS
+    [158] = CC(0x224, 0xA6),  // KEY_BACK
+    [159] = CC(0x225, 0xA7),  // KEY_FORWARD
+    [160] = CC(0xB8, 0x00),   // KEY_CLOSECD
+    [161] = CC(0xB8, 0x00),   // KEY_EJECTCD
+    [163] = CC(0xB5, 0xB0),   // KEY_NEXTSONG
+    [164] = CC(0xCD, 0xB3),   // KEY_PLAYPAUSE
+    [165] = CC(0xB6, 0xB1),   // KEY_PREVIOUSSONG
+    [166] = CC(0xB7, 0xB2),   // KEY_STOPCD
+    [167] = CC(0xB2, 0x00),   // KEY_RECORD
+    [168] = CC(0xB4, 0x00),   // KEY_REWIND
+    [169] = CC(0x8C, 0x00),   // KEY_PHONE
+    [171] = CC(0x183, 0xB5),  // KEY_CONFIG
+    [172] = CC(0x223, 0xAC),  // KEY_HOMEPAGE
+    [173] = CC(0x227, 0xA8),  // KEY_REFRESH
+    [174] = CC(0x94, 0x00),   // KEY_EXIT
+    [176] = CC(0x23D, 0x00),  // KEY_EDIT
+    [177] = CC(0x233, 0x00),  // KEY_SCROLLUP
+    [178] = CC(0x234, 0x00),  // KEY_SCROLLDOWN
+    [179] = KB(0xB6, 0x00),   // KEY_KPLEFTPAREN
+    [180] = KB(0xB7, 0x00),   // KEY_KPRIGHTPAREN
+    [181] = CC(0x201, 0x00),  // KEY_NEW
+    [182] = CC(0x279, 0x00),  // KEY_REDO
+    [183] = KB(0x68, 0x7C),   // KEY_F13
+    [184] = KB(0x69, 0x7D),   // KEY_F14
+    [185] = KB(0x6A, 0x7E),   // KEY_F15
+    [186] = KB(0x6B, 0x7F),   // KEY_F16
+    [187] = KB(0x6C, 0x80),   // KEY_F17
+    [188] = KB(0x6D, 0x81),   // KEY_F18
+    [189] = KB(0x6E, 0x82),   // KEY_F19
+    [190] = KB(0x6F, 0x83),   // KEY_F20
+    [191] = KB(0x70, 0x84),   // KEY_F21
+    [192] = KB(0x71, 0x85),   // KEY_F22
+    [193] = KB(0x72, 0x86),   // KEY_F23
+    [194] = KB(0x73, 0x87),   // KEY_F24
+    [200] = CC(0xB0, 0x00),   // KEY_PLAYCD
+    [201] = CC(0xB1, 0x00),   // KEY_PAUSECD
+    [206] = CC(0x203, 0x00),  // KEY_CLOSE
+    [207] = CC(0xB0, 0xFA),   // KEY_PLAY
+    [208] = CC(0xB3, 0x00),   // KEY_FASTFORWARD
+    [209] = CC(0xE5, 0x00),   // KEY_BASSBOOST
+    [210] = CC(0x208, 0x2A),  // KEY_PRINT
+    [212] = CC(0x65, 0x00),   // KEY_CAMERA
+    [216] = CC(0x199, 0x00),  // KEY_CHAT
+    [217] = CC(0x221, 0xAA),  // KEY_SEARCH
+    [219] = CC(0x191, 0x00),  // KEY_FINANCE
+    [223] = CC(0x25F, 0x00),  // KEY_CANCEL
+    [224] = CC(0x70, 0x00),   // KEY_BRIGHTNESSDOWN
+    [225] = CC(0x6F, 0x00),   // KEY_BRIGHTNESSUP
+    [226] = CC(0x193, 0xB5),  // KEY_MEDIA
+    [228] = CC(0x7C, 0x00),   // KEY_KBDILLUMTOGGLE
+    [229] = CC(0x7A, 0x00),   // KEY_KBDILLUMDOWN
+    [230] = CC(0x79, 0x00),   // KEY_KBDILLUMUP
+    [231] = CC(0x28C, 0x00),  // KEY_SEND
+    [232] = CC(0x289, 0x00),  // KEY_REPLY
+    [233] = CC(0x28B, 0x00),  // KEY_FORWARDMAIL
+    [234] = CC(0x207, 0x00),  // KEY_SAVE
+    [235] = CC(0x1A7, 0x00),  // KEY_DOCUMENTS
+    [241] = CC(0x82, 0x00),   // KEY_VIDEO_NEXT
+    [244] = CC(0x75, 0x00),   // KEY_BRIGHTNESS_AUTO
+    [353] = CC(0x41, 0x29),   // KEY_SELECT
+    [354] = CC(0x222, 0x00),  // KEY_GOTO
+    [358] = CC(0x60, 0x00),   // KEY_INFO
+    [362] = CC(0x8D, 0x00),   // KEY_PROGRAM
+    [366] = CC(0x9A, 0x00),   // KEY_PVR
+    [370] = CC(0x61, 0x00),   // KEY_SUBTITLE
+    [372] = CC(0x232, 0x00),  // KEY_FULL_SCREEN
+    [374] = CC(0x1AE, 0x00),  // KEY_KEYBOARD
+    [375] = CC(0x6D, 0x00),   // KEY_ASPECT_RATIO
+    [376] = CC(0x88, 0x00),   // KEY_PC
+    [377] = CC(0x89, 0x00),   // KEY_TV
+    [378] = CC(0x97, 0x00),   // KEY_TV2
+    [379] = CC(0x63, 0x00),   // KEY_VCR
+    [380] = CC(0xA0, 0x00),   // KEY_VCR2
+    [381] = CC(0x98, 0x00),   // KEY_SAT
+    [383] = CC(0x91, 0x00),   // KEY_CD
+    [384] = CC(0x96, 0x00),   // KEY_TAPE
+    [386] = CC(0x93, 0x00),   // KEY_TUNER
+    [387] = CC(0x193, 0x00),  // KEY_PLAYER
+    [389] = CC(0x8B, 0x00),   // KEY_DVD
+    [392] = CC(0x1B7, 0x00),  // KEY_AUDIO
+    [393] = CC(0x1B8, 0x00),  // KEY_VIDEO
+    [396] = CC(0x90, 0x00),   // KEY_MEMO
+    [397] = CC(0x18E, 0x00),  // KEY_CALENDAR
+    [398] = CC(0x69, 0x00),   // KEY_RED
+    [399] = CC(0x6A, 0x00),   // KEY_GREEN
+    [400] = CC(0x6C, 0x00),   // KEY_YELLOW
+    [401] = CC(0x6B, 0x00),   // KEY_BLUE
+    [402] = CC(0x9C, 0x00),   // KEY_CHANNELUP
+    [403] = CC(0x9D, 0x00),   // KEY_CHANNELDOWN
+    [405] = CC(0x83, 0x00),   // KEY_LAST
+    [407] = CC(0x1A3, 0x00),  // KEY_NEXT
+    [408] = CC(0x31, 0x00),   // KEY_RESTART
+    [409] = CC(0xF5, 0x00),   // KEY_SLOW
+    [410] = CC(0xB9, 0x00),   // KEY_SHUFFLE
+    [412] = CC(0x1A4, 0x00),  // KEY_PREVIOUS
+    [416] = CC(0x8E, 0x00),   // KEY_VIDEOPHONE
+    [417] = CC(0x8F, 0x00),   // KEY_GAMES
+    [418] = CC(0x22D, 0x00),  // KEY_ZOOMIN
+    [419] = CC(0x22E, 0x00),  // KEY_ZOOMOUT
+    [420] = CC(0x22F, 0x00),  // KEY_ZOOMRESET
+    [421] = CC(0x184, 0x00),  // KEY_WORDPROCESSOR
+    [422] = CC(0x185, 0x00),  // KEY_EDITOR
+    [423] = CC(0x186, 0x00),  // KEY_SPREADSHEET
+    [424] = CC(0x187, 0x00),  // KEY_GRAPHICSEDITOR
+    [425] = CC(0x188, 0x00),  // KEY_PRESENTATION
+    [426] = CC(0x189, 0x00),  // KEY_DATABASE
+    [427] = CC(0x18B, 0x00),  // KEY_NEWS
+    [428] = CC(0x18C, 0x00),  // KEY_VOICEMAIL
+    [429] = CC(0x18D, 0x00),  // KEY_ADDRESSBOOK
+    [430] = CC(0x1BC, 0x00),  // KEY_MESSENGER
+    [431] = CC(0x72, 0x00),   // KEY_BRIGHTNESS_TOGGLE
+    [432] = CC(0x1AB, 0x00),  // KEY_SPELLCHECK
+    [433] = CC(0x19C, 0x00),  // KEY_LOGOFF
+    [439] = CC(0xBC, 0x00),   // KEY_MEDIA_REPEAT
+    [442] = CC(0x1B6, 0x00),  // KEY_IMAGES
+    [576] = CC(0x181, 0x00),  // KEY_BUTTONCONFIG
+    [577] = CC(0x18F, 0x00),  // KEY_TASKMANAGER
+    [578] = CC(0x190, 0x00),  // KEY_JOURNAL
+    [579] = CC(0x19F, 0x00),  // KEY_CONTROLPANEL
+    [580] = CC(0x1A2, 0x00),  // KEY_APPSELECT
+    [581] = CC(0x1B1, 0x00),  // KEY_SCREENSAVER
+    [582] = CC(0xCF, 0x00),   // KEY_VOICECOMMAND
+    [583] = CC(0x1CB, 0x00),  // KEY_ASSISTANT
+    [584] = CC(0x29D, 0x00),  // KEY_KBD_LAYOUT_NEXT
+    [592] = CC(0x73, 0x00),   // KEY_BRIGHTNESS_MIN
+    [593] = CC(0x74, 0x00),   // KEY_BRIGHTNESS_MAX
+    [608] = CC(0x2C7, 0x00),  // KEY_KBDINPUTASSIST_PREV
+    [609] = CC(0x2C8, 0x00),  // KEY_KBDINPUTASSIST_NEXT
+    [610] = CC(0x2C9, 0x00),  // KEY_KBDINPUTASSIST_PREVGROUP
+    [611] = CC(0x2CA, 0x00),  // KEY_KBDINPUTASSIST_NEXTGROUP
+    [612] = CC(0x2CB, 0x00),  // KEY_KBDINPUTASSIST_ACCEPT
+    [613] = CC(0x2CC, 0x00),  // KEY_KBDINPUTASSIST_CANCEL
+};
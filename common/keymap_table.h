@@ -0,0 +1,53 @@
+#ifndef KEYMAP_TABLE_H
+#define KEYMAP_TABLE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ───────────────────────────────
+// Linux key code → HID usage / Windows virtual key
+// ───────────────────────────────
+// One read-only table shared by the firmware, the Windows server and the
+// tests. It is a const initializer, so it lives in flash and needs no
+// runtime setup. Indexed by the codes of linux/input-event-codes.h
+// (KEY_* and BTN_*, up to KEY_MAX).
+
+#define KEYMAP_SIZE 0x300            // KEY_MAX + 1
+
+#define KEYMAP_PAGE_NONE     0x00    // unmapped
+#define KEYMAP_PAGE_KEYBOARD 0x07    // Keyboard/Keypad page
+#define KEYMAP_PAGE_CONSUMER 0x0C    // Consumer page (media, volume, AL/AC keys)
+
+typedef struct {
+    uint8_t  page;    // KEYMAP_PAGE_*
+    uint8_t  vk;      // Windows virtual-key code, 0 if none
+    uint16_t usage;   // usage ID within page
+} keymap_entry;
+
+extern const keymap_entry keymap_table[KEYMAP_SIZE];
+
+// Entry for a Linux key code; page is KEYMAP_PAGE_NONE if unmapped
+static inline keymap_entry keymap_lookup(uint16_t linux_code) {
+    if (linux_code >= KEYMAP_SIZE) return (keymap_entry){0};
+    return keymap_table[linux_code];
+}
+
+// Keyboard page usage for a Linux key code, 0 if it is not a keyboard key
+static inline uint8_t keymap_linux_to_hid(uint16_t linux_code) {
+    keymap_entry e = keymap_lookup(linux_code);
+    return e.page == KEYMAP_PAGE_KEYBOARD ? (uint8_t)e.usage : 0;
+}
+
+// Windows virtual-key code for a Linux key code, 0 if unmapped
+static inline uint8_t keymap_linux_to_vk(uint16_t linux_code) {
+    return keymap_lookup(linux_code).vk;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // KEYMAP_TABLE_H
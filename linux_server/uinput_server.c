@@ -0,0 +1,198 @@
+// Linux receiver: the windows_server receive engine with a uinput sink.
+//
+// Creates one virtual keyboard + mouse and injects each datagram with a
+// single write(): a SYN_REPORT after every action keeps button/motion order.
+// With -n nothing is injected (no /dev/uinput needed), which measures the
+// engine alone; loadgen reads its counters from the stats port either way.
+// SIGINT/SIGTERM stop the engine (rx_engine_stop); every key and button
+// still held is then released before the device is destroyed.
+//
+// Usage: uinput_server [-v] [-n] [-p PORT] [-s STATS_PORT]
+
+#include "hid_stats.h"
+#include "keymap_table.h"
+#include "receive_engine.h"
+#include <fcntl.h>
+#include <linux/uinput.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+// Motion writes up to six events plus SYN_REPORT, a key one plus SYN_REPORT
+#define MAX_EVENTS (RX_MAX_ACTIONS * 7)
+
+typedef struct {
+    int fd;
+    int32_t wheel_rest, hwheel_rest;   // hi-res units short of a detent
+    uint8_t held[KEYMAP_SIZE / 8];     // keys and buttons injected as down
+    struct input_event ev[MAX_EVENTS];
+} uinput_sink;
+
+// ───────────────────────────────
+// Device setup
+// ───────────────────────────────
+static int uinput_open(void) {
+    int fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+    if (fd < 0) {
+        perror("/dev/uinput");
+        return -1;
+    }
+
+    static const uint16_t rels[] = {REL_X, REL_Y, REL_HWHEEL, REL_WHEEL,
+                                    REL_WHEEL_HI_RES, REL_HWHEEL_HI_RES};
+    bool ok = ioctl(fd, UI_SET_EVBIT, EV_KEY) == 0 && ioctl(fd, UI_SET_EVBIT, EV_REL) == 0;
+    for (uint16_t code = 1; ok && code < KEYMAP_SIZE; code++) {
+        if (keymap_lookup(code).page != KEYMAP_PAGE_NONE) ok = ioctl(fd, UI_SET_KEYBIT, code) == 0;
+    }
+    for (uint16_t code = BTN_LEFT; ok && code <= BTN_MIDDLE; code++) ok = ioctl(fd, UI_SET_KEYBIT, code) == 0;
+    for (size_t i = 0; ok && i < sizeof(rels) / sizeof(rels[0]); i++) ok = ioctl(fd, UI_SET_RELBIT, rels[i]) == 0;
+
+    struct uinput_setup setup;
+    memset(&setup, 0, sizeof(setup));
+    setup.id.bustype = BUS_VIRTUAL;
+    setup.id.vendor = 0x1209;    // pid.codes test VID
+    setup.id.product = 0x0001;
+    snprintf(setup.name, UINPUT_MAX_NAME_SIZE, "PiHID over Wi-Fi");
+    ok = ok && ioctl(fd, UI_DEV_SETUP, &setup) == 0 && ioctl(fd, UI_DEV_CREATE) == 0;
+    if (!ok) {
+        perror("uinput setup");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// ───────────────────────────────
+// Sink
+// ───────────────────────────────
+static void put(uinput_sink *s, size_t *n, uint16_t type, uint16_t code, int32_t value) {
+    s->ev[*n] = (struct input_event){.type = type, .code = code, .value = value};
+    (*n)++;
+}
+
+// Detents for the hi-res steps so far; clients without hi-res scrolling
+// still see one REL_WHEEL per RX_WHEEL_UNIT
+static int32_t detents(int32_t *rest, int32_t units) {
+    *rest += units;
+    int32_t d = *rest / RX_WHEEL_UNIT;
+    *rest -= d * RX_WHEEL_UNIT;
+    return d;
+}
+
+static void put_motion(uinput_sink *s, size_t *n, const rx_action *a) {
+    if (a->dx) put(s, n, EV_REL, REL_X, a->dx);
+    if (a->dy) put(s, n, EV_REL, REL_Y, a->dy);
+    if (a->wheel) {
+        int32_t d = detents(&s->wheel_rest, a->wheel);
+        if (d) put(s, n, EV_REL, REL_WHEEL, d);
+        put(s, n, EV_REL, REL_WHEEL_HI_RES, a->wheel);
+    }
+    if (a->hwheel) {
+        int32_t d = detents(&s->hwheel_rest, a->hwheel);
+        if (d) put(s, n, EV_REL, REL_HWHEEL, d);
+        put(s, n, EV_REL, REL_HWHEEL_HI_RES, a->hwheel);
+    }
+}
+
+static size_t uinput_inject(void *ctx, const rx_action *actions, size_t count) {
+    uinput_sink *s = (uinput_sink *)ctx;
+    size_t n = 0, mapped = 0;
+    for (size_t i = 0; i < count; i++) {
+        const rx_action *a = &actions[i];
+        size_t start = n;
+        if (a->type == RX_ACT_MOTION) {
+            put_motion(s, &n, a);
+        } else if (a->code < KEYMAP_SIZE &&
+                   (keymap_lookup(a->code).page != KEYMAP_PAGE_NONE ||
+                    (a->code >= BTN_LEFT && a->code <= BTN_MIDDLE))) {
+            put(s, &n, EV_KEY, a->code, a->value);
+            if (a->value) s->held[a->code >> 3] |= (uint8_t)(1u << (a->code & 7));
+            else s->held[a->code >> 3] &= (uint8_t)~(1u << (a->code & 7));
+        }
+        if (n == start) continue;
+        put(s, &n, EV_SYN, SYN_REPORT, 0);
+        mapped++;
+    }
+    if (n == 0) return 0;
+    ssize_t bytes = write(s->fd, s->ev, n * sizeof(s->ev[0]));
+    return bytes == (ssize_t)(n * sizeof(s->ev[0])) ? mapped : 0;
+}
+
+// Key-up for everything still held, so nothing sticks when the device goes
+static void uinput_release_all(uinput_sink *s) {
+    size_t n = 0;
+    for (uint16_t code = 0; code < KEYMAP_SIZE; code++) {
+        if (!(s->held[code >> 3] & (1u << (code & 7)))) continue;
+        put(s, &n, EV_KEY, code, 0);
+        if (n == MAX_EVENTS - 1) {
+            if (write(s->fd, s->ev, n * sizeof(s->ev[0])) < 0) perror("uinput release");
+            n = 0;
+        }
+    }
+    memset(s->held, 0, sizeof(s->held));
+    put(s, &n, EV_SYN, SYN_REPORT, 0);
+    if (write(s->fd, s->ev, n * sizeof(s->ev[0])) < 0) perror("uinput release");
+}
+
+static size_t null_inject(void *ctx, const rx_action *actions, size_t count) {
+    (void)ctx;
+    (void)actions;
+    return count;
+}
+
+// ───────────────────────────────
+// Shutdown
+// ───────────────────────────────
+static rx_engine *running;
+
+static void on_signal(int sig) {
+    (void)sig;
+    rx_engine_stop(running);
+}
+
+int main(int argc, char **argv) {
+    bool verbose = false, dry_run = false;
+    int port = RX_DEFAULT_PORT, stats_port = HS_PORT;
+    int opt;
+    while ((opt = getopt(argc, argv, "vnp:s:")) != -1) {
+        switch (opt) {
+            case 'v': verbose = true; break;
+            case 'n': dry_run = true; break;
+            case 'p': port = atoi(optarg); break;
+            case 's': stats_port = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-v] [-n] [-p PORT] [-s STATS_PORT]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    static uinput_sink us;
+    rx_sink sink = {null_inject, NULL};
+    if (!dry_run) {
+        if ((us.fd = uinput_open()) < 0) return 1;
+        sink = (rx_sink){uinput_inject, &us};
+    }
+    rx_engine engine;
+    rx_engine_init(&engine, &sink);
+    engine.verbose = verbose;
+
+    running = &engine;
+    struct sigaction sa = {0};
+    sa.sa_handler = on_signal;   // no SA_RESTART: interrupts select
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    printf("uinput_server on UDP %d, stats on %d%s\n", port, stats_port, dry_run ? " (dry run)" : "");
+    fflush(stdout);
+    int rc = rx_engine_serve(&engine, (uint16_t)port, (uint16_t)stats_port);
+
+    if (!dry_run) {
+        uinput_release_all(&us);
+        ioctl(us.fd, UI_DEV_DESTROY);
+        close(us.fd);
+    }
+    return rc == 0 ? 0 : 1;
+}
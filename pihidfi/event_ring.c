@@ -0,0 +1,86 @@
+#include "event_ring.h"
+#include "hid_port.h"
+#include <stdalign.h>
+#include <stdatomic.h>
+
+#define EVENT_RING_MASK (EVENT_RING_SIZE - 1)
+#define CACHE_LINE_SIZE 64
+
+_Static_assert((EVENT_RING_SIZE & EVENT_RING_MASK) == 0,
+               "EVENT_RING_SIZE must be a power of two");
+
+// Same layout rules as packet_queue: free-running counters, one writer per
+// cache line
+static struct {
+    alignas(CACHE_LINE_SIZE) _Atomic uint32_t head;   // written by producer
+    _Atomic uint32_t pushed;
+    _Atomic uint32_t high_watermark;
+    _Atomic uint32_t full_waits;
+    _Atomic bool waiting;                             // producer blocked on a full ring
+
+    alignas(CACHE_LINE_SIZE) _Atomic uint32_t tail;   // written by consumer
+
+    alignas(CACHE_LINE_SIZE) hid_event slots[EVENT_RING_SIZE];
+} ring;
+
+// ───────────────────────────────
+// Producer (core1)
+// ───────────────────────────────
+void event_ring_push(const hid_event *ev) {
+    uint32_t head = atomic_load_explicit(&ring.head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring.tail, memory_order_acquire);
+    if (head - tail >= EVENT_RING_SIZE) {
+        atomic_fetch_add_explicit(&ring.full_waits, 1, memory_order_relaxed);
+        atomic_store_explicit(&ring.waiting, true, memory_order_seq_cst);
+        while (head - (tail = atomic_load_explicit(&ring.tail, memory_order_acquire)) >= EVENT_RING_SIZE)
+            hid_port_wait_event(EVENT_RING_WAIT_US);
+        atomic_store_explicit(&ring.waiting, false, memory_order_relaxed);
+    }
+
+    ring.slots[head & EVENT_RING_MASK] = *ev;
+    head++;
+    uint32_t depth = head - tail;
+    if (depth > atomic_load_explicit(&ring.high_watermark, memory_order_relaxed))
+        atomic_store_explicit(&ring.high_watermark, depth, memory_order_relaxed);
+    atomic_fetch_add_explicit(&ring.pushed, 1, memory_order_relaxed);
+
+    // Release: the slot contents are visible before the new head
+    atomic_store_explicit(&ring.head, head, memory_order_release);
+}
+
+// ───────────────────────────────
+// Consumer (core0)
+// ───────────────────────────────
+bool event_ring_pop(hid_event *out) {
+    uint32_t tail = atomic_load_explicit(&ring.tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring.head, memory_order_acquire);
+    if (tail == head) return false;
+    *out = ring.slots[tail & EVENT_RING_MASK];
+    atomic_store_explicit(&ring.tail, tail + 1, memory_order_seq_cst);
+    if (atomic_load_explicit(&ring.waiting, memory_order_seq_cst)) hid_port_doorbell_ring();
+    return true;
+}
+
+// ───────────────────────────────
+// Metrics
+// ───────────────────────────────
+uint32_t event_ring_depth(void) {
+    uint32_t head = atomic_load_explicit(&ring.head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&ring.tail, memory_order_acquire);
+    return head - tail;
+}
+
+void event_ring_get_stats(event_ring_stats *out) {
+    out->pushed = atomic_load_explicit(&ring.pushed, memory_order_relaxed);
+    out->high_watermark = atomic_load_explicit(&ring.high_watermark, memory_order_relaxed);
+    out->full_waits = atomic_load_explicit(&ring.full_waits, memory_order_relaxed);
+}
+
+void event_ring_reset(void) {
+    atomic_store(&ring.head, 0);
+    atomic_store(&ring.tail, 0);
+    atomic_store(&ring.pushed, 0);
+    atomic_store(&ring.high_watermark, 0);
+    atomic_store(&ring.full_waits, 0);
+    atomic_store(&ring.waiting, false);
+}
@@ -0,0 +1,68 @@
+#ifndef EVENT_RING_H
+#define EVENT_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EVENT_RING_SIZE 256   // must be a power of two
+
+// How long the producer sleeps per try while the ring is full
+#define EVENT_RING_WAIT_US 100
+
+// Decoded input as the parser hands it to the HID core: keymap lookups,
+// sequence checks and session matching are already done
+enum {
+    HEV_PACKET,          // datagram from session: v[0] receive µs, v[1] parse start µs
+    HEV_KEY,             // code: keyboard usage, v[0]: pressed
+    HEV_CONSUMER,        // code: consumer usage, v[0]: pressed
+    HEV_BUTTON,          // code: button mask, v[0]: pressed
+    HEV_MOTION,          // v[0..3]: dx, dy, wheel, pan (wheel/pan in HID_WHEEL_UNIT)
+    HEV_STATE_KEY,       // snapshot entries: code is a keyboard usage ...
+    HEV_STATE_CONSUMER,  // ... or a consumer usage
+    HEV_STATE_END,       // end of snapshot, code: held buttons, v[0]: partial
+    HEV_FLUSH,           // end of datagram
+    HEV_RELEASE,         // session closed: release all it holds
+};
+
+typedef struct {
+    uint8_t type;        // HEV_*
+    uint8_t session;     // HEV_PACKET, HEV_RELEASE
+    uint16_t code;
+    int32_t v[4];
+} hid_event;
+
+typedef struct {
+    uint32_t pushed;          // events handed over
+    uint32_t high_watermark;  // deepest occupancy seen since reset
+    uint32_t full_waits;      // times the producer found the ring full
+} event_ring_stats;
+
+// ───────────────────────────────
+// Single-producer / single-consumer ring
+// ───────────────────────────────
+// Producer: the parser on core1. Consumer: the HID core on core0.
+// Events are never dropped (a lost release would leave a key stuck): a
+// full ring makes the producer wait, and the consumer rings the doorbell
+// when it frees a slot the producer is waiting for.
+
+// Producer side; must not run on the consumer's core
+void event_ring_push(const hid_event *ev);
+
+// Consumer side: copies out the oldest event, false if empty
+bool event_ring_pop(hid_event *out);
+
+uint32_t event_ring_depth(void);
+void event_ring_get_stats(event_ring_stats *out);
+
+// Empties the ring and clears the counters. Not safe while either side runs.
+void event_ring_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EVENT_RING_H
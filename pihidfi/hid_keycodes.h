@@ -0,0 +1,62 @@
+#ifndef HID_KEYCODES_H
+#define HID_KEYCODES_H
+
+// HID keyboard page usages used by the portable core.
+// Values match TinyUSB's class/hid/hid.h; this header exists so the core
+// does not need tusb.h and can be built on the host. Do not include it in
+// the same translation unit as tusb.h.
+
+#define HID_KEY_NONE            0x00
+#define HID_KEY_ERROR_ROLLOVER  0x01    // boot report: too many keys held
+#define HID_KEY_A               0x04
+#define HID_KEY_B               0x05
+#define HID_KEY_C               0x06
+#define HID_KEY_D               0x07
+#define HID_KEY_E               0x08
+#define HID_KEY_F               0x09
+#define HID_KEY_G               0x0A
+#define HID_KEY_H               0x0B
+#define HID_KEY_I               0x0C
+#define HID_KEY_J               0x0D
+#define HID_KEY_K               0x0E
+#define HID_KEY_L               0x0F
+#define HID_KEY_M               0x10
+#define HID_KEY_N               0x11
+#define HID_KEY_O               0x12
+#define HID_KEY_P               0x13
+#define HID_KEY_Q               0x14
+#define HID_KEY_R               0x15
+#define HID_KEY_S               0x16
+#define HID_KEY_T               0x17
+#define HID_KEY_U               0x18
+#define HID_KEY_V               0x19
+#define HID_KEY_W               0x1A
+#define HID_KEY_X               0x1B
+#define HID_KEY_Y               0x1C
+#define HID_KEY_Z               0x1D
+#define HID_KEY_1               0x1E
+#define HID_KEY_2               0x1F
+#define HID_KEY_3               0x20
+#define HID_KEY_4               0x21
+#define HID_KEY_5               0x22
+#define HID_KEY_6               0x23
+#define HID_KEY_7               0x24
+#define HID_KEY_8               0x25
+#define HID_KEY_9               0x26
+#define HID_KEY_0               0x27
+#define HID_KEY_ENTER           0x28
+#define HID_KEY_ESCAPE          0x29
+#define HID_KEY_BACKSPACE       0x2A
+#define HID_KEY_TAB             0x2B
+#define HID_KEY_SPACE           0x2C
+
+#define HID_KEY_CONTROL_LEFT    0xE0
+#define HID_KEY_SHIFT_LEFT      0xE1
+#define HID_KEY_ALT_LEFT        0xE2
+#define HID_KEY_GUI_LEFT        0xE3
+#define HID_KEY_CONTROL_RIGHT   0xE4
+#define HID_KEY_SHIFT_RIGHT     0xE5
+#define HID_KEY_ALT_RIGHT       0xE6
+#define HID_KEY_GUI_RIGHT       0xE7
+
+#endif // HID_KEYCODES_H
@@ -0,0 +1,53 @@
+#ifndef HID_PORT_H
+#define HID_PORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ───────────────────────────────
+// Platform shim for the portable HID core
+// ───────────────────────────────
+// hid_port_pico.c maps these onto TinyUSB and the pico timer;
+// host/hid_port_host.c records them so the core can run on Linux.
+
+// Microsecond monotonic clock (time_us_64 on the Pico)
+uint64_t hid_port_time_us(void);
+
+// Wakes a core blocked in hid_port_wait_event() (SEV on the Pico).
+// Events are latched: a ring before the wait makes the wait return at once.
+void hid_port_doorbell_ring(void);
+
+// Sleeps until a doorbell, an interrupt or timeout_us elapses (WFE on the Pico)
+void hid_port_wait_event(uint32_t timeout_us);
+
+// True when the interface can accept another report (tud_hid_n_ready)
+bool hid_port_ready(uint8_t itf);
+
+// Boot keyboard report (tud_hid_n_keyboard_report)
+bool hid_port_keyboard_report(uint8_t itf, uint8_t report_id,
+                              uint8_t modifier, const uint8_t keycode[6]);
+
+// NKRO keyboard report: a bitmap of held HID usages (tud_hid_n_report)
+bool hid_port_keyboard_bitmap(uint8_t itf, const uint8_t *bits, uint8_t len);
+
+// Consumer Control report: n 16-bit usages, 0 for empty slots (tud_hid_n_report)
+bool hid_port_consumer_report(uint8_t itf, const uint16_t *usages, uint8_t n);
+
+// Boot mouse report (tud_hid_n_mouse_report)
+bool hid_port_mouse_report(uint8_t itf, uint8_t report_id, uint8_t buttons,
+                           int8_t x, int8_t y, int8_t vertical, int8_t horizontal);
+
+// High-resolution mouse report (PIHIDFI_HIRES_MOUSE descriptor):
+// buttons, then 16-bit X, Y, wheel and AC Pan
+bool hid_port_mouse_report16(uint8_t itf, uint8_t buttons,
+                             int16_t x, int16_t y, int16_t vertical, int16_t horizontal);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HID_PORT_H
@@ -0,0 +1,125 @@
+#include "hid_port.h"
+#include "hid_server.h"
+#include "pico/time.h"
+#include "hardware/sync.h"
+#include "tusb.h"
+
+// ───────────────────────────────
+// HID core shim → TinyUSB / pico timer
+// ───────────────────────────────
+uint64_t hid_port_time_us(void) {
+    return time_us_64();
+}
+
+void hid_port_doorbell_ring(void) {
+    __sev(); // wakes WFE on both cores
+}
+
+void hid_port_wait_event(uint32_t timeout_us) {
+    // Returns on SEV from the other core, any interrupt (USB, timers) or timeout
+    best_effort_wfe_or_timeout(make_timeout_time_us(timeout_us));
+}
+
+bool hid_port_ready(uint8_t itf) {
+    return tud_hid_n_ready(itf);
+}
+
+bool hid_port_keyboard_report(uint8_t itf, uint8_t report_id,
+                              uint8_t modifier, const uint8_t keycode[6]) {
+    return tud_hid_n_keyboard_report(itf, report_id, modifier, keycode);
+}
+
+bool hid_port_keyboard_bitmap(uint8_t itf, const uint8_t *bits, uint8_t len) {
+    return tud_hid_n_report(itf, 0, bits, len);
+}
+
+bool hid_port_consumer_report(uint8_t itf, const uint16_t *usages, uint8_t n) {
+    uint8_t report[2 * CONSUMER_SLOTS];
+    if (n > CONSUMER_SLOTS) n = CONSUMER_SLOTS;
+    for (uint8_t i = 0; i < n; i++) {
+        report[2 * i] = (uint8_t)usages[i];
+        report[2 * i + 1] = (uint8_t)(usages[i] >> 8);
+    }
+    return tud_hid_n_report(itf, 0, report, (uint16_t)(2 * n));
+}
+
+bool hid_port_mouse_report(uint8_t itf, uint8_t report_id, uint8_t buttons,
+                           int8_t x, int8_t y, int8_t vertical, int8_t horizontal) {
+    return tud_hid_n_mouse_report(itf, report_id, buttons, x, y, vertical, horizontal);
+}
+
+// Input report of the PIHIDFI_HIRES_MOUSE descriptor
+typedef struct TU_ATTR_PACKED {
+    uint8_t buttons;
+    int16_t x;
+    int16_t y;
+    int16_t wheel;
+    int16_t pan;
+} hid_mouse16_report_t;
+
+bool hid_port_mouse_report16(uint8_t itf, uint8_t buttons,
+                             int16_t x, int16_t y, int16_t vertical, int16_t horizontal) {
+    hid_mouse16_report_t report = {buttons, x, y, vertical, horizontal};
+    return tud_hid_n_report(itf, 0, &report, sizeof(report));
+}
+
+// ───────────────────────────────
+// TinyUSB periodic poll
+// ───────────────────────────────
+void hid_task(void) {
+    tud_task(); // handle USB events
+}
+
+// ───────────────────────────────
+// TinyUSB HID Callbacks (required)
+// ───────────────────────────────
+// Resolution Multiplier feature byte of the mouse (bits 0-1 wheel, 2-3 pan)
+static uint8_t mouse_multiplier = 0;
+
+uint16_t tud_hid_get_report_cb(uint8_t itf, uint8_t report_id,
+                               hid_report_type_t report_type,
+                               uint8_t *buffer, uint16_t reqlen) {
+    if (PIHIDFI_HIRES_MOUSE && itf == ITF_MOUSE &&
+        report_type == HID_REPORT_TYPE_FEATURE && reqlen >= 1) {
+        buffer[0] = mouse_multiplier;
+        return 1;
+    }
+    return 0;
+}
+
+void tud_hid_set_report_cb(uint8_t itf, uint8_t report_id,
+                           hid_report_type_t report_type,
+                           const uint8_t *buffer, uint16_t bufsize) {
+    if (PIHIDFI_HIRES_MOUSE && itf == ITF_MOUSE &&
+        report_type == HID_REPORT_TYPE_FEATURE && bufsize >= 1) {
+        mouse_multiplier = buffer[0] & 0x0F;
+        hid_server_set_wheel_resolution(mouse_multiplier & 0x03, mouse_multiplier & 0x0C);
+    }
+}
+
+// BIOSes switch the boot keyboard to boot protocol; keys then bypass NKRO.
+// The mouse drops back to the 8-bit boot report the same way.
+void tud_hid_set_protocol_cb(uint8_t instance, uint8_t protocol) {
+    if (instance == ITF_KEYBOARD) hid_server_set_boot_protocol(protocol == HID_PROTOCOL_BOOT);
+    else if (instance == ITF_MOUSE) hid_server_set_mouse_boot_protocol(protocol == HID_PROTOCOL_BOOT);
+}
+
+// The host renegotiates multiplier and protocol after every enumeration
+void tud_mount_cb(void) {
+    mouse_multiplier = 0;
+    hid_server_set_wheel_resolution(false, false);
+    hid_server_set_boot_protocol(false);
+    hid_server_set_mouse_boot_protocol(false);
+}
+
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report, uint16_t len) {
+    (void)report;
+    (void)len;
+    hid_server_report_complete(instance);
+}
+
+// Start of frame, enabled by main while reports are pending; runs from
+// tud_task like the callbacks above
+void tud_sof_cb(uint32_t frame_count) {
+    hid_server_frame(frame_count);
+}
@@ -1,209 +1,588 @@
 #include "hid_server.h"
-#include "tusb.h"
+#include "hid_port.h"
+#include "hid_keycodes.h"
+#include "keymap_table.h"
+#include "pipeline_stats.h"
 #include <stdio.h>
 #include <string.h>
 
+#define BOOT_KEYS 6
+
+// Held keys as a bitmap of HID usages 0x00-0xE7 (the NKRO report). The
+// modifiers E0-E7 are the last byte, which doubles as the boot modifier byte.
+// This and mouse_buttons/consumer_held are the union of all sessions.
+static uint8_t key_bits[NKRO_REPORT_LEN];
+static uint8_t mouse_buttons = 0;
+
+// What each input session holds; one sender's release never cancels a key
+// another sender is holding
+typedef struct {
+    uint8_t key_bits[NKRO_REPORT_LEN];
+    uint8_t buttons;
+    uint16_t consumer[CONSUMER_SLOTS];
+} session_input;
+
+static session_input sessions[HID_SESSIONS];
+static session_input *cur = &sessions[0];
+
+#define MODIFIER_BYTE (HID_KEY_CONTROL_LEFT / 8)
+
+// Mouse reports waiting for the endpoint, oldest first. A segment is a button
+// state plus the motion that followed it; the last one stays open and collects
+// new motion. A button change starts a new segment only where merging would
+// move motion across the edge or hide a click shorter than the poll interval.
+// Wheel and pan are carried in 1/HID_WHEEL_UNIT detents.
+#define MOUSE_REPORT_MAX   127
+#define MOUSE_REPORT16_MAX 32767
+#define MOUSE_CARRY_MAX    (1 << 20)
+#define MOUSE_QUEUE_LEN    16
+
+typedef struct {
+    uint8_t buttons;
+    uint8_t changed;       // buttons flipped from the previous segment, not reported yet
+    int32_t dx;
+    int32_t dy;
+    int32_t wheel;
+    int32_t pan;
+} mouse_segment;
+
+static mouse_segment mouse_q[MOUSE_QUEUE_LEN];
+static uint8_t mouse_head = 0;
+static uint8_t mouse_count = 1;
+static uint32_t mouse_merged = 0;
+
+// Report layout, boot protocol on the mouse (BIOS) and the host's
+// Resolution Multiplier choice
+static bool mouse_hires = false;
+static bool mouse_boot = false;
+static bool wheel_hires = false;
+static bool pan_hires = false;
+static uint8_t sent_buttons = 0;
+
+static void mouse_buttons_changed(void);
+
+// Report states waiting for an endpoint, oldest first. Every distinct state
+// is queued, so a tap shorter than the poll interval still reaches the host;
+// only when a queue is full is its newest entry overwritten.
+typedef struct {
+    uint8_t *slots;        // cap entries of size bytes
+    uint8_t *last;         // newest state queued or sent
+    uint8_t size;
+    uint8_t cap;
+    uint8_t head;
+    uint8_t count;
+    uint32_t overwritten;
+} state_queue;
+
+#define KBD_QUEUE_LEN      32
+#define CONSUMER_QUEUE_LEN 8
+
+static uint8_t kbd_slots[KBD_QUEUE_LEN][NKRO_REPORT_LEN];
+static uint8_t kbd_last[NKRO_REPORT_LEN];
+static state_queue kbd_queue = {kbd_slots[0], kbd_last, NKRO_REPORT_LEN, KBD_QUEUE_LEN, 0, 0, 0};
+
+// Held consumer usages in press order (the Consumer Control array report)
+static uint16_t consumer_held[CONSUMER_SLOTS];
+static uint8_t consumer_slots[CONSUMER_QUEUE_LEN][sizeof(consumer_held)];
+static uint8_t consumer_last[sizeof(consumer_held)];
+static state_queue consumer_queue = {consumer_slots[0], consumer_last, sizeof(consumer_held),
+                                     CONSUMER_QUEUE_LEN, 0, 0, 0};
+
+static void sq_reset(state_queue *q) {
+    q->head = q->count = 0;
+    q->overwritten = 0;
+    memset(q->last, 0, q->size);
+}
+
+// Queues state if it differs from the newest queued one
+static void sq_push(state_queue *q, const void *state) {
+    if (memcmp(q->last, state, q->size) == 0) return; // nothing changed
+
+    memcpy(q->last, state, q->size);
+    if (q->count == q->cap) {
+        memcpy(q->slots + (size_t)((q->head + q->count - 1) % q->cap) * q->size, state, q->size);
+        q->overwritten++;
+        return;
+    }
+    memcpy(q->slots + (size_t)((q->head + q->count) % q->cap) * q->size, state, q->size);
+    q->count++;
+}
+
+static bool sq_changed(const state_queue *q, const void *state) {
+    return q->count > 0 || memcmp(q->last, state, q->size) != 0;
+}
+
+static const uint8_t *sq_front(const state_queue *q) {
+    return q->slots + (size_t)q->head * q->size;
+}
+
+static void sq_pop(state_queue *q) {
+    q->head = (uint8_t)((q->head + 1) % q->cap);
+    q->count--;
+}
+
+// Telemetry: reports accepted by an endpoint, and reports that found their
+// endpoint busy (counted once per wait, not per retry)
+#define STALL_ITFS (ITF_NKRO + 1)
+static uint32_t reports_sent;
+static uint32_t ready_stalls;
+static bool stalled[STALL_ITFS];
+
+static bool endpoint_ready(uint8_t itf) {
+    if (hid_port_ready(itf)) return true;
+    if (itf < STALL_ITFS && !stalled[itf]) {
+        stalled[itf] = true;
+        ready_stalls++;
+    }
+    return false;
+}
+
+static void report_sent(uint8_t itf) {
+    pipeline_report_sent(itf);
+    reports_sent++;
+    if (itf < STALL_ITFS) stalled[itf] = false;
+}
+
+// NKRO interface present, and whether the host switched the boot keyboard
+// to boot protocol (BIOS); only one interface reports at a time
+static bool nkro_enabled = false;
+static bool boot_protocol = false;
+
+void hid_server_reset(void) {
+    memset(sessions, 0, sizeof(sessions));
+    cur = &sessions[0];
+    memset(key_bits, 0, sizeof(key_bits));
+    mouse_buttons = 0;
+    memset(mouse_q, 0, sizeof(mouse_q));
+    mouse_head = 0;
+    mouse_count = 1;
+    mouse_merged = 0;
+    mouse_hires = mouse_boot = wheel_hires = pan_hires = false;
+    sent_buttons = 0;
+    sq_reset(&kbd_queue);
+    memset(consumer_held, 0, sizeof(consumer_held));
+    sq_reset(&consumer_queue);
+    nkro_enabled = boot_protocol = false;
+    reports_sent = ready_stalls = 0;
+    memset(stalled, 0, sizeof(stalled));
+}
+
+void hid_server_set_nkro(bool enable) {
+    nkro_enabled = enable;
+}
+
+void hid_server_set_boot_protocol(bool boot) {
+    boot_protocol = boot;
+}
+
+static inline void hid_add_key(uint8_t keycode) {
+    if (keycode < NKRO_USAGE_COUNT) cur->key_bits[keycode >> 3] |= (uint8_t)(1u << (keycode & 7));
+}
+
+static inline void hid_remove_key(uint8_t keycode) {
+    if (keycode < NKRO_USAGE_COUNT) cur->key_bits[keycode >> 3] &= (uint8_t)~(1u << (keycode & 7));
+}
+
 // ───────────────────────────────
-// Keycode translation
+// Input sessions
 // ───────────────────────────────
-#define MAX_KEYMAP 128
-static uint8_t linux_to_hid[MAX_KEYMAP];
-
-
-#define MAX_KEYS 6
-
-static uint8_t key_state[MAX_KEYS] = {0};
-static uint8_t current_modifiers = 0;
-
-void init_key_table(void) {
-    memset(linux_to_hid, 0, sizeof(linux_to_hid));
-
-    // letters (example subset — add others as needed)
-    linux_to_hid[30] = HID_KEY_A;
-    linux_to_hid[48] = HID_KEY_B;
-    linux_to_hid[46] = HID_KEY_C;
-    linux_to_hid[32] = HID_KEY_D;
-    linux_to_hid[18] = HID_KEY_E;
-    linux_to_hid[33] = HID_KEY_F;
-    linux_to_hid[34] = HID_KEY_G;
-    linux_to_hid[35] = HID_KEY_H;
-    linux_to_hid[23] = HID_KEY_I;
-    linux_to_hid[36] = HID_KEY_J;
-    linux_to_hid[37] = HID_KEY_K;
-    linux_to_hid[38] = HID_KEY_L;
-    linux_to_hid[50] = HID_KEY_M;
-    linux_to_hid[49] = HID_KEY_N;
-    linux_to_hid[24] = HID_KEY_O;
-    linux_to_hid[25] = HID_KEY_P;
-    linux_to_hid[16] = HID_KEY_Q;
-    linux_to_hid[19] = HID_KEY_R;
-    linux_to_hid[31] = HID_KEY_S;
-    linux_to_hid[20] = HID_KEY_T;
-    linux_to_hid[22] = HID_KEY_U;
-    linux_to_hid[47] = HID_KEY_V;
-    linux_to_hid[17] = HID_KEY_W;
-    linux_to_hid[45] = HID_KEY_X;
-    linux_to_hid[21] = HID_KEY_Y;
-    linux_to_hid[44] = HID_KEY_Z;
-
-    // digits
-    linux_to_hid[2] = HID_KEY_1;
-    linux_to_hid[3] = HID_KEY_2;
-    linux_to_hid[4] = HID_KEY_3;
-    linux_to_hid[5] = HID_KEY_4;
-    linux_to_hid[6] = HID_KEY_5;
-    linux_to_hid[7] = HID_KEY_6;
-    linux_to_hid[8] = HID_KEY_7;
-    linux_to_hid[9] = HID_KEY_8;
-    linux_to_hid[10] = HID_KEY_9;
-    linux_to_hid[11] = HID_KEY_0;
-
-    // common control keys
-    linux_to_hid[28] = HID_KEY_ENTER;
-    linux_to_hid[1]  = HID_KEY_ESCAPE;
-    linux_to_hid[14] = HID_KEY_BACKSPACE;
-    linux_to_hid[15] = HID_KEY_TAB;
-    linux_to_hid[57] = HID_KEY_SPACE;
-
-    // shift/control/alt
-    linux_to_hid[42] = HID_KEY_SHIFT_LEFT;
-    linux_to_hid[54] = HID_KEY_SHIFT_RIGHT;
-    linux_to_hid[29] = HID_KEY_CONTROL_LEFT;
-    linux_to_hid[97] = HID_KEY_CONTROL_RIGHT;
-    linux_to_hid[56] = HID_KEY_ALT_LEFT;
-    linux_to_hid[100]= HID_KEY_ALT_RIGHT;
-}
-
-void hid_add_key(uint8_t keycode) {
-    // Avoid duplicates
-    for (int i = 0; i < MAX_KEYS; i++) {
-        if (key_state[i] == keycode) return;
-    }
-
-    // Find empty slot
-    for (int i = 0; i < MAX_KEYS; i++) {
-        if (key_state[i] == 0) {
-            key_state[i] = keycode;
-            break;
+static void merge_keys(void) {
+    memset(key_bits, 0, sizeof(key_bits));
+    for (int s = 0; s < HID_SESSIONS; s++) {
+        for (int i = 0; i < NKRO_REPORT_LEN; i++) key_bits[i] |= sessions[s].key_bits[i];
+    }
+}
+
+static void merge_buttons(void) {
+    mouse_buttons = 0;
+    for (int s = 0; s < HID_SESSIONS; s++) mouse_buttons |= sessions[s].buttons;
+    mouse_buttons_changed();
+}
+
+// Union of held usages, earlier sessions first, while slots last
+static void merge_consumer(void) {
+    int n = 0;
+    memset(consumer_held, 0, sizeof(consumer_held));
+    for (int s = 0; s < HID_SESSIONS; s++) {
+        for (int i = 0; i < CONSUMER_SLOTS && sessions[s].consumer[i]; i++) {
+            uint16_t u = sessions[s].consumer[i];
+            bool dup = false;
+            for (int j = 0; j < n; j++) dup |= consumer_held[j] == u;
+            if (!dup && n < CONSUMER_SLOTS) consumer_held[n++] = u;
         }
     }
 }
 
-void hid_remove_key(uint8_t keycode) {
-    for (int i = 0; i < MAX_KEYS; i++) {
-        if (key_state[i] == keycode) {
-            key_state[i] = 0;
-            break;
+void hid_server_select_session(uint8_t session) {
+    if (session < HID_SESSIONS) cur = &sessions[session];
+}
+
+void hid_server_release_session(uint8_t session) {
+    if (session >= HID_SESSIONS) return;
+    memset(&sessions[session], 0, sizeof(sessions[session]));
+    merge_keys();
+    merge_buttons();
+    merge_consumer();
+    hid_send_report();
+    hid_send_consumer();
+    hid_mouse_flush();
+}
+
+static bool keyboard_changed(void) {
+    return sq_changed(&kbd_queue, key_bits);
+}
+
+// 6KRO boot report from the bitmap: lowest usages first, ErrorRollOver in
+// every slot when more than six non-modifier keys are held
+static bool send_boot_report(const uint8_t *bits) {
+    uint8_t keys[BOOT_KEYS] = {0};
+    int n = 0;
+    for (int byte = 0; byte < MODIFIER_BYTE; byte++) {
+        uint8_t b = bits[byte];
+        while (b) {
+            int bit = __builtin_ctz(b);
+            b &= (uint8_t)(b - 1);
+            if (n == BOOT_KEYS) {
+                memset(keys, HID_KEY_ERROR_ROLLOVER, sizeof(keys));
+                goto send;
+            }
+            keys[n++] = (uint8_t)(byte * 8 + bit);
         }
     }
+send:
+    return hid_port_keyboard_report(ITF_KEYBOARD, 0, bits[MODIFIER_BYTE], keys);
+}
+
+void hid_send_report(void) {
+    sq_push(&kbd_queue, key_bits);
+    if (kbd_queue.count == 0) return;            // nothing changed
+
+    uint8_t itf = nkro_enabled && !boot_protocol ? ITF_NKRO : ITF_KEYBOARD;
+    if (!endpoint_ready(itf)) return;            // sent on report-complete
 
-    // Compact array
-    uint8_t compacted[MAX_KEYS] = {0};
-    int idx = 0;
-    for (int i = 0; i < MAX_KEYS; i++) {
-        if (key_state[i] != 0 && idx < MAX_KEYS) {
-            compacted[idx++] = key_state[i];
+    const uint8_t *bits = sq_front(&kbd_queue);
+    bool ok = itf == ITF_NKRO ? hid_port_keyboard_bitmap(ITF_NKRO, bits, NKRO_REPORT_LEN)
+                              : send_boot_report(bits);
+    if (!ok) return;
+    report_sent(itf);
+    sq_pop(&kbd_queue);
+}
+
+uint32_t hid_server_keyboard_overwritten(void) {
+    return kbd_queue.overwritten;
+}
+
+void hid_server_get_stats(hid_server_stats *out) {
+    out->reports_sent = reports_sent;
+    out->ready_stalls = ready_stalls;
+    out->keyboard_overwritten = kbd_queue.overwritten;
+    out->mouse_merged = mouse_merged;
+}
+
+// ───────────────────────────────
+// Consumer control (media keys)
+// ───────────────────────────────
+// Returns true if the usage was not held yet and found a slot
+static bool consumer_add(uint16_t usage) {
+    for (int i = 0; i < CONSUMER_SLOTS; i++) {
+        if (cur->consumer[i] == usage) return false;
+    }
+    for (int i = 0; i < CONSUMER_SLOTS; i++) {
+        if (cur->consumer[i] == 0) {
+            cur->consumer[i] = usage;
+            return true;
         }
     }
-    memcpy(key_state, compacted, MAX_KEYS);
+    return false;
 }
 
+static void consumer_remove(uint16_t usage) {
+    int n = 0;
+    for (int i = 0; i < CONSUMER_SLOTS; i++) {
+        if (cur->consumer[i] != usage) cur->consumer[n++] = cur->consumer[i];
+    }
+    while (n < CONSUMER_SLOTS) cur->consumer[n++] = 0;
+}
 
-void hid_set_modifier(uint8_t modifier, bool pressed) {
-    if (pressed)
-        current_modifiers |= modifier;
-    else
-        current_modifiers &= ~modifier;
+void hid_send_consumer(void) {
+    sq_push(&consumer_queue, consumer_held);
+    if (consumer_queue.count == 0) return;       // nothing changed
+    if (!endpoint_ready(ITF_CONSUMER)) return;   // sent on report-complete
+
+    uint16_t usages[CONSUMER_SLOTS];
+    memcpy(usages, sq_front(&consumer_queue), sizeof(usages));
+    if (!hid_port_consumer_report(ITF_CONSUMER, usages, CONSUMER_SLOTS)) return;
+    report_sent(ITF_CONSUMER);
+    sq_pop(&consumer_queue);
 }
 
-#define HID_UPDATE_INTERVAL_US 1000  // 1 ms
-static uint64_t last_hid_send = 0;
-static uint8_t prev_modifiers = 0;
-static uint8_t prev_keys[MAX_KEYS] = {0};
+bool hid_server_sync_consumer(const uint16_t *usages, size_t n) {
+    uint16_t held[CONSUMER_SLOTS] = {0};
+    for (size_t i = 0; i < n && i < CONSUMER_SLOTS; i++) held[i] = usages[i];
 
-void hid_send_report(void) {
-    if (!tud_hid_ready()) return;
+    // Same set in a different order is not a change
+    bool changed = false;
+    for (int i = 0; i < CONSUMER_SLOTS; i++) {
+        bool found = false;
+        for (int j = 0; j < CONSUMER_SLOTS; j++) found |= cur->consumer[j] == held[i];
+        changed |= !found;
+        found = false;
+        for (int j = 0; j < CONSUMER_SLOTS; j++) found |= held[j] == cur->consumer[i];
+        changed |= !found;
+    }
+    if (!changed) return false;
+    memcpy(cur->consumer, held, sizeof(held));
+    merge_consumer();
+    hid_send_consumer();
+    return true;
+}
 
-    uint64_t now = time_us_64();
-    if (now - last_hid_send < HID_UPDATE_INTERVAL_US) return;
-    last_hid_send = now;
-    
-    if (memcmp(prev_keys, key_state, MAX_KEYS) == 0 &&
-        prev_modifiers == current_modifiers) {
-        return; // nothing changed
+bool hid_server_sync_state(const uint8_t *keys, size_t nkeys, uint8_t buttons) {
+    uint8_t bits[NKRO_REPORT_LEN] = {0};
+    for (size_t i = 0; i < nkeys; i++) {
+        if (keys[i] < NKRO_USAGE_COUNT) bits[keys[i] >> 3] |= (uint8_t)(1u << (keys[i] & 7));
     }
 
-    tud_hid_keyboard_report(1, current_modifiers, key_state);
+    bool changed = memcmp(bits, cur->key_bits, NKRO_REPORT_LEN) != 0;
+    if (changed) {
+        memcpy(cur->key_bits, bits, NKRO_REPORT_LEN);
+        merge_keys();
+        hid_send_report();
+    }
 
-    prev_modifiers = current_modifiers;
-    memcpy(prev_keys, key_state, MAX_KEYS);
+    if (buttons != cur->buttons) {
+        cur->buttons = buttons;
+        merge_buttons();
+        hid_mouse_flush();
+        changed = true;
+    }
+    return changed;
 }
 
-void handle_key_event(uint8_t linux_keycode, bool pressed) {
-    if (!key_table_initialized) return;
-    uint8_t hid_keycode = linux_to_hid[linux_keycode];
-    if (hid_keycode == 0) return; // Unknown key
+bool hid_server_add_state(const uint8_t *keys, size_t nkeys, const uint16_t *usages,
+                          size_t nusages, uint8_t buttons) {
+    bool keys_added = false, consumer_added = false;
+    for (size_t i = 0; i < nkeys; i++) {
+        uint8_t k = keys[i];
+        if (k >= NKRO_USAGE_COUNT || (cur->key_bits[k >> 3] & (1u << (k & 7)))) continue;
+        hid_add_key(k);
+        keys_added = true;
+    }
+    if (keys_added) {
+        merge_keys();
+        hid_send_report();
+    }
+    for (size_t i = 0; i < nusages; i++) consumer_added |= consumer_add(usages[i]);
+    if (consumer_added) {
+        merge_consumer();
+        hid_send_consumer();
+    }
 
-    if (hid_keycode >= HID_KEY_CONTROL_LEFT && hid_keycode <= HID_KEY_GUI_RIGHT) {
-        // Modifier key
-        hid_set_modifier(1 << (hid_keycode - HID_KEY_CONTROL_LEFT), pressed);
+    bool buttons_added = (buttons & ~cur->buttons) != 0;
+    if (buttons_added) {
+        cur->buttons |= buttons;
+        merge_buttons();
+        hid_mouse_flush();
     }
-    
+    return keys_added || consumer_added || buttons_added;
+}
+
+void hid_server_key(uint8_t usage, bool pressed) {
+    // Modifiers are bits E0-E7 of the same bitmap
     if (pressed) {
-        hid_add_key(hid_keycode);
+        hid_add_key(usage);
     } else {
-        hid_remove_key(hid_keycode);
+        hid_remove_key(usage);
     }
+    merge_keys();
     hid_send_report();
 }
 
+void hid_server_consumer_key(uint16_t usage, bool pressed) {
+    if (pressed) {
+        consumer_add(usage);
+    } else {
+        consumer_remove(usage);
+    }
+    merge_consumer();
+    hid_send_consumer();
+}
+
+void handle_key_event(uint16_t linux_keycode, bool pressed) {
+    keymap_entry e = keymap_lookup(linux_keycode);
+    if (e.page == KEYMAP_PAGE_CONSUMER) hid_server_consumer_key(e.usage, pressed);
+    else if (e.page == KEYMAP_PAGE_KEYBOARD) hid_server_key((uint8_t)e.usage, pressed);
+    // Unknown key: ignored
+}
+
 // ───────────────────────────────
 // Mouse handling
 // ───────────────────────────────
-static uint8_t mouse_buttons = 0;
+void hid_server_set_mouse_hires(bool enable) {
+    mouse_hires = enable;
+}
 
-void hid_send_mouse_button(uint8_t button_mask, bool pressed) {
+void hid_server_set_mouse_boot_protocol(bool boot) {
+    mouse_boot = boot;
+}
+
+void hid_server_set_wheel_resolution(bool wheel, bool pan) {
+    wheel_hires = wheel;
+    pan_hires = pan;
+}
+
+// 16-bit reports only while the host runs the report protocol; a boot host
+// parses the first bytes as the 8-bit boot layout
+static bool mouse_report16(void) {
+    return mouse_hires && !mouse_boot;
+}
+
+static int32_t clamp32(int32_t v, int32_t limit) {
+    return v > limit ? limit : (v < -limit ? -limit : v);
+}
+
+// Report value for carried wheel/pan units: raw units once the host enabled
+// the multiplier, whole detents otherwise (the remainder stays carried)
+static int32_t wheel_step(int32_t carry, bool hires, int32_t limit) {
+    return clamp32(hires ? carry : carry / HID_WHEEL_UNIT, limit);
+}
+
+static int32_t carry_add(int32_t carry, int32_t v) {
+    return clamp32(carry + clamp32(v, MOUSE_CARRY_MAX), MOUSE_CARRY_MAX);
+}
+
+static mouse_segment *mouse_front(void) {
+    return &mouse_q[mouse_head];
+}
+
+static mouse_segment *mouse_open(void) {
+    return &mouse_q[(mouse_head + mouse_count - 1) % MOUSE_QUEUE_LEN];
+}
+
+// Motion worth a report (a sub-detent wheel remainder is not)
+static bool segment_moves(const mouse_segment *s) {
+    return s->dx || s->dy || wheel_step(s->wheel, mouse_report16() && wheel_hires, 1) ||
+           wheel_step(s->pan, mouse_report16() && pan_hires, 1);
+}
+
+// Applies the merged mouse_buttons to the open segment
+static void mouse_buttons_changed(void) {
+    mouse_segment *s = mouse_open();
+    uint8_t flipped = s->buttons ^ mouse_buttons;
+    if (!flipped) return;
+
+    // Motion queued so far happened with the old buttons, and a button that
+    // flips back before its report went out would never reach the host
+    if (segment_moves(s) || (s->changed & flipped)) {
+        if (mouse_count < MOUSE_QUEUE_LEN) {
+            mouse_count++;
+            s = mouse_open();
+            memset(s, 0, sizeof(*s));
+        } else {
+            mouse_merged++;
+        }
+    }
+    s->changed |= flipped;
+    s->buttons = mouse_buttons;
+}
+
+// One report in the configured layout; values must already fit it
+static bool mouse_report(uint8_t buttons, int32_t dx, int32_t dy, int32_t wheel, int32_t pan) {
+    bool ok = mouse_report16()
+        ? hid_port_mouse_report16(ITF_MOUSE, buttons, (int16_t)dx, (int16_t)dy,
+                                  (int16_t)wheel, (int16_t)pan)
+        : hid_port_mouse_report(ITF_MOUSE, 0, buttons, (int8_t)dx, (int8_t)dy,
+                                (int8_t)wheel, (int8_t)pan);
+    if (ok) {
+        report_sent(ITF_MOUSE);
+        sent_buttons = buttons;
+    }
+    return ok;
+}
+
+void hid_queue_mouse_button(uint8_t button_mask, bool pressed) {
     if (pressed) {
-        mouse_buttons |= button_mask;  // Set the button bit
+        cur->buttons |= button_mask;  // Set the button bit
     } else {
-        mouse_buttons &= ~button_mask; // Clear the button bit
+        cur->buttons &= ~button_mask; // Clear the button bit
+    }
+    merge_buttons();
+}
+
+void hid_send_mouse_button(uint8_t button_mask, bool pressed) {
+    hid_queue_mouse_button(button_mask, pressed);
+    hid_mouse_flush();
+}
+
+static bool mouse_sendable(void) {
+    const mouse_segment *s = mouse_front();
+    return mouse_count > 1 || s->changed || segment_moves(s);
+}
+
+void hid_mouse_flush(void) {
+    bool report16 = mouse_report16();
+    int32_t limit = report16 ? MOUSE_REPORT16_MAX : MOUSE_REPORT_MAX;
+    bool hires_wheel = report16 && wheel_hires;
+    bool hires_pan = report16 && pan_hires;
+
+    while (true) {
+        mouse_segment *s = mouse_front();
+        bool done = !s->changed && !segment_moves(s);
+        if (done && mouse_count > 1) {
+            // Fully reported; a sub-detent wheel remainder moves on
+            mouse_segment *next = &mouse_q[(mouse_head + 1) % MOUSE_QUEUE_LEN];
+            next->wheel = carry_add(next->wheel, s->wheel);
+            next->pan = carry_add(next->pan, s->pan);
+            mouse_head = (uint8_t)((mouse_head + 1) % MOUSE_QUEUE_LEN);
+            mouse_count--;
+            continue;
+        }
+        if (done || !endpoint_ready(ITF_MOUSE)) return;
+
+        int32_t dx = clamp32(s->dx, limit);
+        int32_t dy = clamp32(s->dy, limit);
+        int32_t wheel = wheel_step(s->wheel, hires_wheel, limit);
+        int32_t pan = wheel_step(s->pan, hires_pan, limit);
+        if (!mouse_report(s->buttons, dx, dy, wheel, pan)) return;
+        s->changed = 0;
+        s->dx -= dx;
+        s->dy -= dy;
+        s->wheel -= hires_wheel ? wheel : wheel * HID_WHEEL_UNIT;
+        s->pan -= hires_pan ? pan : pan * HID_WHEEL_UNIT;
     }
-    
-    // Send mouse report with current button state and no movement
-    tud_hid_n_mouse_report(1, 0, mouse_buttons, 0, 0, 0, 0);
 }
 
-void hid_send_mouse_move(int8_t dx, int8_t dy, int8_t wheel) {
-    // Use standard TinyUSB mouse report for interface 1  
-    // Include current button state so drag operations work
-    tud_hid_n_mouse_report(1, 0, mouse_buttons, dx, dy, wheel, 0);
+void hid_queue_mouse_move(int32_t dx, int32_t dy, int32_t wheel, int32_t pan) {
+    mouse_segment *s = mouse_open();
+    s->dx = carry_add(s->dx, dx);
+    s->dy = carry_add(s->dy, dy);
+    s->wheel = carry_add(s->wheel, wheel);
+    s->pan = carry_add(s->pan, pan);
 }
 
-// New function to send mouse report with explicit button state
-void hid_send_mouse_report(uint8_t buttons, int8_t dx, int8_t dy, int8_t wheel) {
-    mouse_buttons = buttons;  // Update internal state
-    tud_hid_n_mouse_report(1, 0, buttons, dx, dy, wheel, 0);
+void hid_send_mouse_move(int32_t dx, int32_t dy, int32_t wheel, int32_t pan) {
+    hid_queue_mouse_move(dx, dy, wheel, pan);
+    hid_mouse_flush();
 }
 
-// ───────────────────────────────
-// TinyUSB periodic poll
-// ───────────────────────────────
-void hid_task(void) {
-    tud_task(); // handle USB events
+bool hid_server_pending(void) {
+    return keyboard_changed() || sq_changed(&consumer_queue, consumer_held) || mouse_sendable();
 }
 
-// ───────────────────────────────
-// TinyUSB HID Callbacks (required)
-// ───────────────────────────────
-uint16_t tud_hid_get_report_cb(uint8_t itf, uint8_t report_id,
-                               hid_report_type_t report_type,
-                               uint8_t *buffer, uint16_t reqlen) {
-    // Not used
-    return 0;
+void hid_server_service(void) {
+    hid_send_report();
+    hid_send_consumer();
+    hid_mouse_flush();
+}
+
+void hid_server_frame(uint32_t frame) {
+    (void)frame;
+    hid_server_service();
 }
 
-void tud_hid_set_report_cb(uint8_t itf, uint8_t report_id,
-                           hid_report_type_t report_type,
-                           const uint8_t *buffer, uint16_t bufsize) {
-    // Not used
+void hid_server_report_complete(uint8_t itf) {
+    pipeline_report_complete(itf);
+    if (itf == ITF_KEYBOARD || itf == ITF_NKRO) hid_send_report();
+    else if (itf == ITF_CONSUMER) hid_send_consumer();
+    else if (itf == ITF_MOUSE) hid_mouse_flush();
 }
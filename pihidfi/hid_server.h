@@ -3,28 +3,144 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-// Initialize key translation table (Linux → HID)
-void init_key_table(void);
+// HID interface numbers (see usb_descriptors.c)
+#define ITF_KEYBOARD 0
+#define ITF_MOUSE    1
+#define ITF_CONSUMER 2
+#define ITF_NKRO     3
+
+// Consumer Control report: up to this many 16-bit usages held at once
+#define CONSUMER_SLOTS 4
+
+// Input sessions (one per network sender); reports carry the union of the
+// keys and buttons they hold and the sum of their motion
+#define HID_SESSIONS 4
+
+// NKRO report: one bit per HID usage 0x00-0xE7, modifiers in the last byte
+#define NKRO_USAGE_COUNT 0xE8
+#define NKRO_REPORT_LEN  (NKRO_USAGE_COUNT / 8)
+
+// Clear all key, modifier and button state
+void hid_server_reset(void);
 
 // Handle keyboard events coming from UDP
-//   linux_keycode: key code (from Linux input.h style numbers)
+//   linux_keycode: key code (from Linux input.h style numbers); media keys
+//   go to the consumer interface, everything else to the keyboard
 //   pressed: true if key pressed, false if released
-void handle_key_event(uint8_t linux_keycode, bool pressed);
+void handle_key_event(uint16_t linux_keycode, bool pressed);
+
+// Same with the key table lookup already done: a keyboard usage (0x00-0xE7,
+// modifiers included) or a Consumer page usage
+void hid_server_key(uint8_t usage, bool pressed);
+void hid_server_consumer_key(uint16_t usage, bool pressed);
+
+// Queue the keyboard report if keys or modifiers changed and send the oldest
+// queued one if the endpoint is free. Reports queued while the previous one
+// waits for the host go out in order on report-complete.
+void hid_send_report(void);
+
+// Reports keys on the NKRO bitmap interface instead of the 6KRO boot
+// keyboard (default off after hid_server_reset)
+void hid_server_set_nkro(bool enable);
+
+// Protocol the host selected on the boot keyboard (SET_PROTOCOL). BIOSes
+// pick boot protocol; keys then go to the boot keyboard even with NKRO on.
+void hid_server_set_boot_protocol(bool boot);
+
+// Keyboard states overwritten because the report queue was full
+uint32_t hid_server_keyboard_overwritten(void);
+
+typedef struct {
+    uint32_t reports_sent;          // accepted by an endpoint
+    uint32_t ready_stalls;          // reports that had to wait for the endpoint
+    uint32_t keyboard_overwritten;
+    uint32_t mouse_merged;          // button changes folded into a full mouse queue
+} hid_server_stats;
+
+void hid_server_get_stats(hid_server_stats *out);
+
+// Session whose keys and buttons the following events and snapshots change
+// (session 0 after reset)
+void hid_server_select_session(uint8_t session);
+
+// Releases everything a session holds (sender gone or its slot reused)
+void hid_server_release_session(uint8_t session);
+
+// Queue the Consumer Control report if media keys changed; queued and sent
+// like keyboard reports (Linux consumer-page keys arrive via handle_key_event)
+void hid_send_consumer(void);
 
-// Send mouse movement or wheel scroll
-// dx: delta X, dy: delta Y, wheel: scroll wheel movement
-void hid_send_mouse_move(int8_t dx, int8_t dy, int8_t wheel);
+// Reconciles held consumer usages with a sender snapshot.
+// Returns true if anything had to be corrected.
+bool hid_server_sync_consumer(const uint16_t *usages, size_t n);
+
+// Wheel and pan deltas are in 1/HID_WHEEL_UNIT detents (REL_WHEEL_HI_RES units)
+#define HID_WHEEL_UNIT 120
+
+// Selects the 16-bit report layout of the PIHIDFI_HIRES_MOUSE descriptor
+// instead of the 8-bit boot layout (default after hid_server_reset)
+void hid_server_set_mouse_hires(bool enable);
+
+// Protocol the host selected on the mouse (SET_PROTOCOL). Under boot
+// protocol reports fall back to the 8-bit boot layout even with hi-res on.
+void hid_server_set_mouse_boot_protocol(bool boot);
+
+// Resolution Multiplier feature as set by the host: when enabled, wheel/pan
+// are reported in HID_WHEEL_UNIT steps, otherwise in whole detents
+void hid_server_set_wheel_resolution(bool wheel, bool pan);
+
+// Send mouse movement, wheel scroll and horizontal pan
+// dx: delta X, dy: delta Y, wheel/pan: scroll in HID_WHEEL_UNIT steps
+// Deltas beyond the report range are split over several reports;
+// what the endpoint cannot take yet is carried to the next poll.
+void hid_send_mouse_move(int32_t dx, int32_t dy, int32_t wheel, int32_t pan);
+
+// Mouse report builder: queue motion and button changes in the order they
+// happened, then send with hid_mouse_flush (the parser does this once per
+// packet). Motion after a button change rides in that change's report; a new
+// report starts only where motion precedes a change or a button flips back.
+void hid_queue_mouse_move(int32_t dx, int32_t dy, int32_t wheel, int32_t pan);
+void hid_queue_mouse_button(uint8_t button_mask, bool pressed);
+
+// Sends queued mouse reports while the endpoint accepts them; the rest go
+// out on report-complete
+void hid_mouse_flush(void);
+
+// True while key, button or motion changes are waiting for an endpoint
+bool hid_server_pending(void);
+
+// Sends pending changes to the endpoints that are free (main loop)
+void hid_server_service(void);
+
+// Start of a USB frame (TinyUSB SOF); catches up on anything pending
+void hid_server_frame(uint32_t frame);
 
 // Send mouse button press/release
 // button_mask: 1=left, 2=right, 4=middle
 // pressed: true=press, false=release
 void hid_send_mouse_button(uint8_t button_mask, bool pressed);
 
+// Reconciles key, modifier and button state with a sender snapshot
+//   keys: HID usage codes of every held key (modifiers included)
+//   buttons: held mouse buttons, same mask as hid_send_mouse_button
+// Returns true if anything had to be corrected.
+bool hid_server_sync_state(const uint8_t *keys, size_t nkeys, uint8_t buttons);
+
+// Partial snapshot (the sender holds more than it could list): presses
+// the listed keys, consumer usages and buttons that are missing and
+// releases nothing. Returns true if anything was added.
+bool hid_server_add_state(const uint8_t *keys, size_t nkeys, const uint16_t *usages,
+                          size_t nusages, uint8_t buttons);
+
+// Called from the USB stack once the host has read a report on itf
+void hid_server_report_complete(uint8_t itf);
+
 // Called each main loop iteration to run TinyUSB tasks
 void hid_task(void);
 
@@ -0,0 +1,208 @@
+#include "hid_port.h"
+#include "hid_port_host.h"
+#include "hid_server.h"
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#define HOST_MAX_ITF 8
+
+static host_report report_log[HOST_REPORT_LOG_SIZE];
+static size_t report_count = 0;
+static uint64_t fake_now_us = 0;
+static bool real_clock = false;
+static bool itf_busy[HOST_MAX_ITF];
+
+// USB frame clock: with a poll interval set, a report keeps its endpoint
+// busy until the simulated host reads it at a frame boundary
+static uint32_t poll_frames = 0;
+static uint32_t frame_number = 0;
+static long in_flight[HOST_MAX_ITF];   // log index, -1 if none
+
+// Doorbell: a latched flag like the ARM event register
+static pthread_mutex_t doorbell_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t doorbell_cond = PTHREAD_COND_INITIALIZER;
+static bool doorbell_pending = false;
+
+// ───────────────────────────────
+// Test / benchmark controls
+// ───────────────────────────────
+void hid_port_host_reset(void) {
+    report_count = 0;
+    fake_now_us = 0;
+    memset(itf_busy, 0, sizeof(itf_busy));
+    poll_frames = 0;
+    frame_number = 0;
+    for (int i = 0; i < HOST_MAX_ITF; i++) in_flight[i] = -1;
+}
+
+void hid_port_host_set_time(uint64_t us) {
+    fake_now_us = us;
+}
+
+void hid_port_host_advance(uint64_t us) {
+    fake_now_us += us;
+}
+
+void hid_port_host_use_real_clock(bool enable) {
+    real_clock = enable;
+}
+
+void hid_port_host_set_ready(uint8_t itf, bool ready) {
+    if (itf < HOST_MAX_ITF) itf_busy[itf] = !ready;
+}
+
+size_t hid_port_host_report_count(void) {
+    return report_count;
+}
+
+const host_report *hid_port_host_report(size_t index) {
+    return index < report_count ? &report_log[index] : NULL;
+}
+
+// Keeps the most recent reports when the log overflows, so long benchmark
+// runs do not need to reset it.
+static host_report *next_slot(uint8_t itf) {
+    if (report_count == HOST_REPORT_LOG_SIZE) report_count = 0;
+    host_report *r = &report_log[report_count];
+    r->delivered_us = 0;
+    if (poll_frames) {
+        itf_busy[itf] = true;
+        in_flight[itf] = (long)report_count;
+    }
+    report_count++;
+    return r;
+}
+
+void hid_port_host_usb_poll(uint32_t interval_frames) {
+    poll_frames = interval_frames;
+}
+
+void hid_port_host_frame(void) {
+    fake_now_us = (fake_now_us / HOST_FRAME_US + 1) * HOST_FRAME_US;
+    frame_number++;
+
+    // SOF first, then the host's IN tokens for this frame
+    hid_server_frame(frame_number);
+    if (!poll_frames || frame_number % poll_frames) return;
+    for (uint8_t itf = 0; itf < HOST_MAX_ITF; itf++) {
+        if (in_flight[itf] < 0) continue;
+        report_log[in_flight[itf]].delivered_us = hid_port_time_us();
+        in_flight[itf] = -1;
+        itf_busy[itf] = false;
+        hid_server_report_complete(itf);
+    }
+}
+
+// ───────────────────────────────
+// hid_port.h
+// ───────────────────────────────
+uint64_t hid_port_time_us(void) {
+    if (!real_clock) return fake_now_us;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+void hid_port_doorbell_ring(void) {
+    pthread_mutex_lock(&doorbell_lock);
+    doorbell_pending = true;
+    pthread_cond_signal(&doorbell_cond);
+    pthread_mutex_unlock(&doorbell_lock);
+}
+
+void hid_port_wait_event(uint32_t timeout_us) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_us / 1000000u;
+    deadline.tv_nsec += (long)(timeout_us % 1000000u) * 1000;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&doorbell_lock);
+    while (!doorbell_pending) {
+        if (pthread_cond_timedwait(&doorbell_cond, &doorbell_lock, &deadline) != 0) break;
+    }
+    doorbell_pending = false;
+    pthread_mutex_unlock(&doorbell_lock);
+}
+
+bool hid_port_ready(uint8_t itf) {
+    return itf < HOST_MAX_ITF && !itf_busy[itf];
+}
+
+bool hid_port_keyboard_report(uint8_t itf, uint8_t report_id,
+                              uint8_t modifier, const uint8_t keycode[6]) {
+    if (!hid_port_ready(itf)) return false;
+    host_report *r = next_slot(itf);
+    r->kind = HOST_REPORT_KEYBOARD;
+    r->itf = itf;
+    r->report_id = report_id;
+    r->time_us = hid_port_time_us();
+    r->kbd.modifier = modifier;
+    if (keycode) memcpy(r->kbd.keycode, keycode, 6);
+    else memset(r->kbd.keycode, 0, 6);
+    return true;
+}
+
+bool hid_port_keyboard_bitmap(uint8_t itf, const uint8_t *bits, uint8_t len) {
+    if (!hid_port_ready(itf)) return false;
+    host_report *r = next_slot(itf);
+    r->kind = HOST_REPORT_NKRO;
+    r->itf = itf;
+    r->report_id = 0;
+    r->time_us = hid_port_time_us();
+    if (len > sizeof(r->nkro.bits)) len = sizeof(r->nkro.bits);
+    memset(r->nkro.bits, 0, sizeof(r->nkro.bits));
+    memcpy(r->nkro.bits, bits, len);
+    return true;
+}
+
+bool hid_port_consumer_report(uint8_t itf, const uint16_t *usages, uint8_t n) {
+    if (!hid_port_ready(itf)) return false;
+    host_report *r = next_slot(itf);
+    r->kind = HOST_REPORT_CONSUMER;
+    r->itf = itf;
+    r->report_id = 0;
+    r->time_us = hid_port_time_us();
+    if (n > 4) n = 4;
+    memset(r->consumer.usages, 0, sizeof(r->consumer.usages));
+    memcpy(r->consumer.usages, usages, n * sizeof(uint16_t));
+    return true;
+}
+
+bool hid_port_mouse_report(uint8_t itf, uint8_t report_id, uint8_t buttons,
+                           int8_t x, int8_t y, int8_t vertical, int8_t horizontal) {
+    if (!hid_port_ready(itf)) return false;
+    host_report *r = next_slot(itf);
+    r->kind = HOST_REPORT_MOUSE;
+    r->itf = itf;
+    r->report_id = report_id;
+    r->time_us = hid_port_time_us();
+    r->mouse.buttons = buttons;
+    r->mouse.x = x;
+    r->mouse.y = y;
+    r->mouse.vertical = vertical;
+    r->mouse.horizontal = horizontal;
+    r->mouse.hires = false;
+    return true;
+}
+
+bool hid_port_mouse_report16(uint8_t itf, uint8_t buttons,
+                             int16_t x, int16_t y, int16_t vertical, int16_t horizontal) {
+    if (!hid_port_ready(itf)) return false;
+    host_report *r = next_slot(itf);
+    r->kind = HOST_REPORT_MOUSE;
+    r->itf = itf;
+    r->report_id = 0;
+    r->time_us = hid_port_time_us();
+    r->mouse.buttons = buttons;
+    r->mouse.x = x;
+    r->mouse.y = y;
+    r->mouse.vertical = vertical;
+    r->mouse.horizontal = horizontal;
+    r->mouse.hires = true;
+    return true;
+}
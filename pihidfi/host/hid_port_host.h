@@ -0,0 +1,80 @@
+#ifndef HID_PORT_HOST_H
+#define HID_PORT_HOST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ───────────────────────────────
+// Host implementation of hid_port.h
+// ───────────────────────────────
+// Reports are recorded in a fixed-size log instead of going to USB, and
+// time comes from a manual clock unless hid_port_host_use_real_clock()
+// is enabled (benchmarks).
+
+#define HOST_REPORT_LOG_SIZE 4096
+#define HOST_FRAME_US        1000   // full-speed USB frame
+
+typedef enum {
+    HOST_REPORT_KEYBOARD,
+    HOST_REPORT_MOUSE,
+    HOST_REPORT_NKRO,
+    HOST_REPORT_CONSUMER,
+} host_report_kind;
+
+typedef struct {
+    host_report_kind kind;
+    uint8_t itf;
+    uint8_t report_id;
+    uint64_t time_us;
+    uint64_t delivered_us;   // read by the simulated host, 0 if not (yet)
+    union {
+        struct {
+            uint8_t modifier;
+            uint8_t keycode[6];
+        } kbd;
+        struct {
+            uint8_t buttons;
+            int16_t x, y, vertical, horizontal;
+            bool hires;    // sent with hid_port_mouse_report16
+        } mouse;
+        struct {
+            uint8_t bits[32];
+        } nkro;
+        struct {
+            uint16_t usages[4];
+        } consumer;
+    };
+} host_report;
+
+// Clears the log, resets the clock to 0 and marks every interface ready
+void hid_port_host_reset(void);
+
+void hid_port_host_set_time(uint64_t us);
+void hid_port_host_advance(uint64_t us);
+void hid_port_host_use_real_clock(bool enable);
+
+// Simulates a busy endpoint (tud_hid_n_ready() == false)
+void hid_port_host_set_ready(uint8_t itf, bool ready);
+
+// USB frame clock simulation. With interval_frames > 0 (bInterval), every
+// report makes its endpoint busy until the host polls it; 0 turns it off.
+void hid_port_host_usb_poll(uint32_t interval_frames);
+
+// Advances the clock to the next frame boundary, signals SOF to the HID
+// core, then delivers the in-flight reports due this frame (which calls
+// hid_server_report_complete for their interfaces)
+void hid_port_host_frame(void);
+
+size_t hid_port_host_report_count(void);
+const host_report *hid_port_host_report(size_t index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HID_PORT_HOST_H
@@ -0,0 +1,59 @@
+#include "latency_hist.h"
+#include <stdio.h>
+#include <string.h>
+
+static inline unsigned bucket_of(uint32_t us) {
+    if (us == 0) return 0;
+    unsigned b = 32u - (unsigned)__builtin_clz(us);
+    return b < LATENCY_HIST_BUCKETS ? b : LATENCY_HIST_BUCKETS - 1;
+}
+
+static inline uint32_t bucket_upper(unsigned b) {
+    return b == 0 ? 0 : (uint32_t)((1ull << b) - 1);
+}
+
+void latency_hist_reset(latency_hist *h) {
+    memset(h, 0, sizeof(*h));
+    h->min_us = UINT32_MAX;
+}
+
+void latency_hist_record(latency_hist *h, uint32_t us) {
+    h->buckets[bucket_of(us)]++;
+    h->count++;
+    h->sum_us += us;
+    if (us < h->min_us) h->min_us = us;
+    if (us > h->max_us) h->max_us = us;
+}
+
+uint32_t latency_hist_percentile(const latency_hist *h, unsigned pct) {
+    if (h->count == 0) return 0;
+    uint64_t rank = ((uint64_t)h->count * pct + 99) / 100;
+    if (rank == 0) rank = 1;
+
+    uint64_t seen = 0;
+    for (unsigned b = 0; b < LATENCY_HIST_BUCKETS; b++) {
+        seen += h->buckets[b];
+        if (seen >= rank) {
+            uint32_t upper = bucket_upper(b);
+            return upper < h->max_us ? upper : h->max_us;
+        }
+    }
+    return h->max_us;
+}
+
+void latency_hist_print(const latency_hist *h, const char *name) {
+    if (h->count == 0) {
+        printf("%s: no samples\n", name);
+        return;
+    }
+    printf("%s: n=%lu min=%lu avg=%lu p50<=%lu p99<=%lu max=%lu us\n", name,
+           (unsigned long)h->count, (unsigned long)h->min_us,
+           (unsigned long)(h->sum_us / h->count),
+           (unsigned long)latency_hist_percentile(h, 50),
+           (unsigned long)latency_hist_percentile(h, 99),
+           (unsigned long)h->max_us);
+    for (unsigned b = 0; b < LATENCY_HIST_BUCKETS; b++) {
+        if (!h->buckets[b]) continue;
+        printf("  <=%7lu us: %lu\n", (unsigned long)bucket_upper(b), (unsigned long)h->buckets[b]);
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Log2 latency histogram in microseconds.
+// Bucket 0 holds 0 µs, bucket i (i >= 1) holds [2^(i-1), 2^i) µs; the last
+// bucket also collects everything above its range.
+#define LATENCY_HIST_BUCKETS 24
+
+typedef struct {
+    uint32_t buckets[LATENCY_HIST_BUCKETS];
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+} latency_hist;
+
+void latency_hist_reset(latency_hist *h);
+void latency_hist_record(latency_hist *h, uint32_t us);
+
+// Upper bound (µs) of the bucket containing the pct-th percentile, capped at max
+uint32_t latency_hist_percentile(const latency_hist *h, unsigned pct);
+
+// One summary line plus the non-empty buckets, via printf
+void latency_hist_print(const latency_hist *h, const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LATENCY_HIST_H
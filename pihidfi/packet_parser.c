@@ -0,0 +1,459 @@
+#include "packet_parser.h"
+#include "event_ring.h"
+#include "hid_server.h"
+#include "hid_port.h"
+#include "keymap_table.h"
+#include "hid_proto.h"
+#include "pipeline_stats.h"
+#include <stdbool.h>
+#include <string.h>
+
+// Sequence numbers further back than this are taken as a sender restart
+#define SEQ_RESTART_WINDOW 1024
+
+static parser_stats stats;
+
+// Decoded events go to the HID core at once, or through the event ring
+static bool split = false;
+
+// One session per sender, each with its own sequence tracking; the slot
+// index is also the sender's hid_server session
+typedef struct {
+    bool used;
+    packet_sender from;
+    uint64_t last_us;      // last datagram, for expiry
+    bool have_seq;
+    uint32_t last_seq;
+    bool have_epoch;
+    uint16_t epoch;        // HP_FLAG_EPOCH of the sender's current run
+    bool have_prev_epoch;
+    uint16_t prev_epoch;   // the run it replaced; late datagrams are stale
+    bool resyncs;          // numbers its datagrams or sends snapshots
+    uint8_t held[KEYMAP_SIZE / 8];   // Linux key/button codes held
+} session;
+
+static session sessions[HID_SESSIONS];
+static session *cur;
+
+// Key-state snapshot being decoded (HID codes)
+static struct {
+    uint8_t keys[HP_MAX_STATE_CODES];
+    uint8_t nkeys;
+    uint16_t consumer[CONSUMER_SLOTS];
+    uint8_t nconsumer;
+    uint8_t buttons;
+} snapshot;
+
+// ───────────────────────────────
+// HID side: applies decoded events (core0)
+// ───────────────────────────────
+// Snapshot being reassembled from HEV_STATE_* events
+static struct {
+    uint8_t keys[HP_MAX_STATE_CODES];
+    uint8_t nkeys;
+    uint16_t consumer[CONSUMER_SLOTS];
+    uint8_t nconsumer;
+} applied;
+
+static void apply_event(const hid_event *ev) {
+    switch (ev->type) {
+        case HEV_PACKET:
+            hid_server_select_session(ev->session);
+            pipeline_packet_applied((uint32_t)ev->v[0], (uint32_t)ev->v[1]);
+            break;
+        case HEV_KEY: hid_server_key((uint8_t)ev->code, ev->v[0]); break;
+        case HEV_CONSUMER: hid_server_consumer_key(ev->code, ev->v[0]); break;
+        case HEV_BUTTON: hid_queue_mouse_button((uint8_t)ev->code, ev->v[0]); break;
+        case HEV_MOTION: hid_queue_mouse_move(ev->v[0], ev->v[1], ev->v[2], ev->v[3]); break;
+        case HEV_STATE_KEY:
+            if (applied.nkeys < HP_MAX_STATE_CODES) applied.keys[applied.nkeys++] = (uint8_t)ev->code;
+            break;
+        case HEV_STATE_CONSUMER:
+            if (applied.nconsumer < CONSUMER_SLOTS) applied.consumer[applied.nconsumer++] = ev->code;
+            break;
+        case HEV_STATE_END: {
+            // A partial snapshot only adds: what it leaves out may be held
+            bool changed;
+            if (ev->v[0]) {
+                changed = hid_server_add_state(applied.keys, applied.nkeys, applied.consumer,
+                                               applied.nconsumer, (uint8_t)ev->code);
+            } else {
+                changed = hid_server_sync_state(applied.keys, applied.nkeys, (uint8_t)ev->code);
+                changed |= hid_server_sync_consumer(applied.consumer, applied.nconsumer);
+            }
+            if (changed) stats.resyncs++;
+            applied.nkeys = 0;
+            applied.nconsumer = 0;
+            break;
+        }
+        case HEV_FLUSH: hid_mouse_flush(); break;
+        case HEV_RELEASE: hid_server_release_session(ev->session); break;
+    }
+}
+
+uint32_t packet_parser_apply_events(void) {
+    hid_event ev;
+    uint32_t n = 0;
+    while (event_ring_pop(&ev)) {
+        apply_event(&ev);
+        n++;
+    }
+    return n;
+}
+
+// ───────────────────────────────
+// Parser side: decodes datagrams into events
+// ───────────────────────────────
+static void put_event(const hid_event *ev) {
+    if (split) event_ring_push(ev);
+    else apply_event(ev);
+}
+
+static void emit(uint8_t type, uint16_t code, int32_t v0) {
+    hid_event ev = {type, (uint8_t)(cur - sessions), code, {v0, 0, 0, 0}};
+    put_event(&ev);
+}
+
+// Mouse motion since the last button change in the packet, handed to the
+// report builder before the next change and at the end of the packet.
+// Wheel axes keep detents and hi-res units apart: kernels report both for
+// the same movement, so a packet with hi-res values ignores the detents.
+typedef struct {
+    int32_t dx;
+    int32_t dy;
+    int32_t scroll;      // REL_WHEEL detents
+    int32_t pan;         // REL_HWHEEL detents
+    int32_t scroll_hr;   // REL_WHEEL_HI_RES
+    int32_t pan_hr;      // REL_HWHEEL_HI_RES
+    bool has_scroll_hr;
+    bool has_pan_hr;
+} motion_accum;
+
+static inline int32_t sat_add(int32_t a, int32_t b) {
+    int64_t v = (int64_t)a + b;
+    return v > INT32_MAX ? INT32_MAX : (v < INT32_MIN ? INT32_MIN : (int32_t)v);
+}
+
+static int32_t detents_to_units(int32_t v) {
+    const int32_t max = INT32_MAX / HID_WHEEL_UNIT;
+    return (v > max ? max : (v < -max ? -max : v)) * HID_WHEEL_UNIT;
+}
+
+static void queue_motion(motion_accum *m) {
+    int32_t wheel = m->has_scroll_hr ? m->scroll_hr : detents_to_units(m->scroll);
+    int32_t pan = m->has_pan_hr ? m->pan_hr : detents_to_units(m->pan);
+    if (m->dx || m->dy || wheel || pan) {
+        hid_event ev = {HEV_MOTION, (uint8_t)(cur - sessions), 0, {m->dx, m->dy, wheel, pan}};
+        put_event(&ev);
+    }
+    memset(m, 0, sizeof(*m));
+}
+
+// Motion before a button change must reach the host before it
+static void mouse_button(motion_accum *m, uint8_t mask, bool pressed) {
+    queue_motion(m);
+    emit(HEV_BUTTON, mask, pressed);
+}
+
+// What the sender holds, as far as its transitions tell; autorepeat (2)
+// changes nothing
+static void track_held(uint16_t code, int32_t value) {
+    if (code >= KEYMAP_SIZE) return;
+    uint8_t bit = (uint8_t)(1u << (code & 7));
+    if (value == 1) cur->held[code >> 3] |= bit;
+    else if (value == 0) cur->held[code >> 3] &= (uint8_t)~bit;
+}
+
+static bool holds_anything(const session *s) {
+    for (size_t i = 0; i < sizeof(s->held); i++) {
+        if (s->held[i]) return true;
+    }
+    return false;
+}
+
+static void dispatch_event(uint8_t type, uint16_t code, int32_t value, motion_accum *m) {
+    stats.events++;
+    if (type == HP_EV_REL) {
+        switch (code) {
+            case 0: m->dx = sat_add(m->dx, value); break;          // REL_X
+            case 1: m->dy = sat_add(m->dy, value); break;          // REL_Y
+            case 6: m->pan = sat_add(m->pan, value); break;        // REL_HWHEEL
+            case 8: m->scroll = sat_add(m->scroll, value); break;  // REL_WHEEL
+            case 11:                                               // REL_WHEEL_HI_RES
+                m->scroll_hr = sat_add(m->scroll_hr, value);
+                m->has_scroll_hr = true;
+                break;
+            case 12:                                               // REL_HWHEEL_HI_RES
+                m->pan_hr = sat_add(m->pan_hr, value);
+                m->has_pan_hr = true;
+                break;
+        }
+    } else if (type == HP_EV_KEY) {
+        track_held(code, value);
+        switch (code) {
+            case 272: mouse_button(m, 1, value == 1); break; // BTN_LEFT
+            case 273: mouse_button(m, 2, value == 1); break; // BTN_RIGHT
+            case 274: mouse_button(m, 4, value == 1); break; // BTN_MIDDLE
+            default: {
+                keymap_entry e = keymap_lookup(code);
+                if (e.page == KEYMAP_PAGE_CONSUMER) emit(HEV_CONSUMER, e.usage, value == 1);
+                else if (e.page == KEYMAP_PAGE_KEYBOARD) emit(HEV_KEY, e.usage, value == 1);
+                break;                                             // unknown keys are dropped
+            }
+        }
+    }
+}
+
+// Legacy "K,code,value;M,code,value;" datagrams, decoded in place
+static void process_text_packet(hp_text_reader *r, motion_accum *m) {
+    hp_event ev;
+    while (hp_text_next(r, &ev) > 0) dispatch_event(ev.type, ev.code, ev.value, m);
+    stats.parse_errors += r->errors;
+}
+
+// A sender that starts over with a new epoch counts from scratch; what its
+// previous run held is released, its first snapshot restores the rest.
+// Returns false for a datagram of the previous run arriving late.
+static bool check_epoch(const hp_reader *r) {
+    if (!(r->flags & HP_FLAG_EPOCH)) return true;
+    if (cur->have_epoch && r->epoch == cur->epoch) return true;
+    if (cur->have_prev_epoch && r->epoch == cur->prev_epoch) {
+        stats.seq_stale++;
+        return false;
+    }
+    if (cur->have_seq) {
+        hid_event ev = {HEV_RELEASE, (uint8_t)(cur - sessions), 0, {0, 0, 0, 0}};
+        put_event(&ev);
+        cur->have_seq = false;
+        memset(cur->held, 0, sizeof(cur->held));
+        stats.seq_restarts++;
+    }
+    cur->have_prev_epoch = cur->have_epoch;
+    cur->prev_epoch = cur->epoch;
+    cur->have_epoch = true;
+    cur->epoch = r->epoch;
+    return true;
+}
+
+// Returns the number of datagrams lost just before seq, or -1 for datagrams
+// at or behind the last accepted sequence number
+static int32_t accept_seq(uint32_t seq) {
+    int32_t lost = 0;
+    if (cur->have_seq) {
+        int32_t delta = (int32_t)(seq - cur->last_seq);
+        if (delta <= 0 && delta > -SEQ_RESTART_WINDOW) {
+            stats.seq_stale++;
+            return -1;
+        }
+        if (delta > 1 && delta <= SEQ_RESTART_WINDOW) lost = delta - 1;
+        stats.seq_lost += (uint32_t)lost;
+    }
+    cur->have_seq = true;
+    cur->last_seq = seq;
+    return lost;
+}
+
+// ───────────────────────────────
+// Sessions
+// ───────────────────────────────
+static void close_session(session *s) {
+    hid_event ev = {HEV_RELEASE, (uint8_t)(s - sessions), 0, {0, 0, 0, 0}};
+    put_event(&ev);
+    s->used = false;
+}
+
+static bool same_sender(const packet_sender *a, const packet_sender *b) {
+    return a->addr == b->addr && a->port == b->port;
+}
+
+// Finds or opens the sender's session and makes it current. A new sender
+// takes a free slot, or the least recently heard one when all are in use.
+static void select_session(const packet_sender *from, uint64_t now) {
+    session *s = NULL;
+    for (int i = 0; i < HID_SESSIONS && !s; i++) {
+        if (sessions[i].used && same_sender(&sessions[i].from, from)) s = &sessions[i];
+    }
+    if (!s) {
+        s = &sessions[0];
+        for (int i = 1; i < HID_SESSIONS; i++) {
+            session *c = &sessions[i];
+            if (s->used && (!c->used || c->last_us < s->last_us)) s = c;
+        }
+        if (s->used) {
+            close_session(s);
+            stats.sessions_evicted++;
+        }
+        memset(s, 0, sizeof(*s));
+        s->used = true;
+        s->from = *from;
+        stats.sessions_opened++;
+    }
+    s->last_us = now;
+    cur = s;
+    hid_event ev = {HEV_PACKET, (uint8_t)(s - sessions), 0,
+                    {(int32_t)pipeline_packet_rx_us(), (int32_t)(uint32_t)now, 0, 0}};
+    put_event(&ev);
+}
+
+void packet_parser_expire(uint64_t now_us) {
+    for (int i = 0; i < HID_SESSIONS; i++) {
+        session *s = &sessions[i];
+        // A text sender may be holding a key without sending anything:
+        // only one that resyncs, or holds nothing, is taken for gone
+        if (s->used && now_us - s->last_us > PARSER_SESSION_IDLE_US &&
+            (s->resyncs || !holds_anything(s))) {
+            close_session(s);
+            stats.sessions_expired++;
+        }
+    }
+}
+
+static void collect_state(const hp_event *ev) {
+    if (ev->value == HP_STATE_END) {
+        for (uint8_t i = 0; i < snapshot.nkeys; i++) emit(HEV_STATE_KEY, snapshot.keys[i], 0);
+        for (uint8_t i = 0; i < snapshot.nconsumer; i++) emit(HEV_STATE_CONSUMER, snapshot.consumer[i], 0);
+        emit(HEV_STATE_END, snapshot.buttons, ev->code == HP_STATE_PARTIAL);
+        snapshot.nkeys = 0;
+        snapshot.nconsumer = 0;
+        snapshot.buttons = 0;
+        return;
+    }
+
+    switch (ev->code) {
+        case 272: snapshot.buttons |= 1; return; // BTN_LEFT
+        case 273: snapshot.buttons |= 2; return; // BTN_RIGHT
+        case 274: snapshot.buttons |= 4; return; // BTN_MIDDLE
+    }
+    keymap_entry e = keymap_lookup(ev->code);
+    if (e.page == KEYMAP_PAGE_CONSUMER) {
+        for (uint8_t i = 0; i < snapshot.nconsumer; i++) {
+            if (snapshot.consumer[i] == e.usage) return;
+        }
+        if (snapshot.nconsumer < CONSUMER_SLOTS) snapshot.consumer[snapshot.nconsumer++] = e.usage;
+        return;
+    }
+    if (e.page != KEYMAP_PAGE_KEYBOARD) return;
+    uint8_t hid = (uint8_t)e.usage;
+    for (uint8_t i = 0; i < snapshot.nkeys; i++) {
+        if (snapshot.keys[i] == hid) return;
+    }
+    if (snapshot.nkeys < HP_MAX_STATE_CODES) snapshot.keys[snapshot.nkeys++] = hid;
+}
+
+static void process_binary_packet(hp_reader *r, bool header_ok, motion_accum *m) {
+    hp_event ev;
+    int rc = -1;
+    if (header_ok) {
+        pipeline_packet_header(r->flags, r->seq, r->send_us, r->age_us);
+        int32_t lost = 0;
+        if (!check_epoch(r)) return;
+        if (r->flags & HP_FLAG_SEQ) {
+            cur->resyncs = true;
+            lost = accept_seq(r->seq);
+            if (lost < 0) return;
+        }
+
+        snapshot.nkeys = 0;
+        snapshot.nconsumer = 0;
+        snapshot.buttons = 0;
+        while ((rc = hp_next(r, &ev)) > 0) {
+            if (ev.type == HP_EV_STATE) {
+                cur->resyncs = true;
+                collect_state(&ev);
+            } else if (ev.type == HP_EV_REDUNDANT) {
+                // Only transitions whose original datagram never arrived
+                if (ev.back <= (uint32_t)lost) {
+                    stats.recovered++;
+                    dispatch_event(HP_EV_KEY, ev.code, ev.value, m);
+                }
+            } else {
+                dispatch_event(ev.type, ev.code, ev.value, m);
+            }
+        }
+    }
+    if (rc < 0) stats.parse_errors++;
+}
+
+// After parsing all commands in a packet, send the fewest reports that keep
+// buttons and motion in order
+static void flush_mouse(motion_accum *m) {
+    queue_motion(m);
+    emit(HEV_FLUSH, 0, 0);
+}
+
+// Datagrams without a known source (tests, benchmarks) share one session
+static const packet_sender no_sender = {0, 0};
+
+void process_packet(const char *data, uint16_t len) {
+    process_packet_from(&no_sender, data, len);
+}
+
+void process_packet_from(const packet_sender *from, const char *data, uint16_t len) {
+    stats.packets++;
+    select_session(from, hid_port_time_us());
+
+    motion_accum m = {0};
+
+    if (hp_is_binary(data, len)) {
+        hp_reader r;
+        process_binary_packet(&r, hp_reader_init(&r, data, len) == 0, &m);
+    } else {
+        hp_text_reader t;
+        hp_text_init(&t, data, len);
+        process_text_packet(&t, &m);
+    }
+
+    flush_mouse(&m);
+}
+
+void process_packet_chain(const void *chain, hp_seg_fn next_seg) {
+    process_packet_chain_from(&no_sender, chain, next_seg);
+}
+
+void process_packet_chain_from(const packet_sender *from, const void *chain, hp_seg_fn next_seg) {
+    stats.packets++;
+    select_session(from, hid_port_time_us());
+
+    motion_accum m = {0};
+
+    const void *seg = chain;
+    const uint8_t *data;
+    size_t len;
+    // Classify by the first byte of the chain, not of its first segment
+    do {
+        if (!next_seg(&seg, &data, &len)) return;
+    } while (len == 0);
+
+    if (data[0] == HP_MAGIC) {
+        hp_reader r;
+        process_binary_packet(&r, hp_reader_init_chain(&r, chain, next_seg) == 0, &m);
+    } else {
+        hp_text_reader t;
+        hp_text_init_chain(&t, chain, next_seg);
+        process_text_packet(&t, &m);
+    }
+
+    flush_mouse(&m);
+}
+
+void packet_parser_reset(void) {
+    memset(&stats, 0, sizeof(stats));
+    memset(sessions, 0, sizeof(sessions));
+    cur = &sessions[0];
+    memset(&applied, 0, sizeof(applied));
+    split = false;
+}
+
+void packet_parser_set_split(bool enable) {
+    split = enable;
+}
+
+uint8_t packet_parser_sessions(void) {
+    uint8_t n = 0;
+    for (int i = 0; i < HID_SESSIONS; i++) n += sessions[i].used;
+    return n;
+}
+
+const parser_stats *packet_parser_stats(void) {
+    return &stats;
+}
@@ -0,0 +1,69 @@
+#ifndef PACKET_PARSER_H
+#define PACKET_PARSER_H
+
+#include <stdint.h>
+#include "hid_proto.h"
+#include "packet_queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t packets;       // datagrams processed
+    uint32_t events;        // events dispatched to the HID core
+    uint32_t parse_errors;  // malformed datagrams or records
+    uint32_t seq_lost;      // datagrams missing from the sequence
+    uint32_t seq_stale;     // duplicate or reordered datagrams dropped
+    uint32_t seq_restarts;  // senders that came back with a new epoch
+    uint32_t resyncs;       // snapshots that corrected the HID state (HID side)
+    uint32_t recovered;     // repeated transitions applied for lost datagrams
+    uint32_t sessions_opened;   // senders seen (again)
+    uint32_t sessions_expired;  // sessions closed after PARSER_SESSION_IDLE_US
+    uint32_t sessions_evicted;  // sessions closed for a new sender, table full
+} parser_stats;
+
+// A sender silent this long has its session closed and everything it held
+// released, if it numbers its datagrams or sends snapshots (binary
+// pi_client sends one every 20 ms while anything is held). Legacy text
+// senders have neither and may hold a key in silence; their session is
+// only closed once they hold nothing.
+#ifndef PARSER_SESSION_IDLE_US
+#define PARSER_SESSION_IDLE_US 5000000
+#endif
+
+// Forgets all sessions and clears the counters
+void packet_parser_reset(void);
+
+// Split pipeline: the parser (core1) decodes datagrams into the event ring
+// and the HID core (core0) applies them with packet_parser_apply_events().
+// Off after packet_parser_reset: events are applied as they are decoded.
+void packet_parser_set_split(bool enable);
+
+// HID side of the split pipeline: applies every queued event, returns how many
+uint32_t packet_parser_apply_events(void);
+
+// Decodes one datagram (binary or legacy text) and drives the HID core.
+// Each sender has its own sequence tracking and held keys and buttons.
+void process_packet_from(const packet_sender *from, const char *data, uint16_t len);
+
+// Same, reading straight out of a chained receive buffer (zero-copy mode)
+void process_packet_chain_from(const packet_sender *from, const void *chain, hp_seg_fn next_seg);
+
+// Unattributed datagrams, all in one session
+void process_packet(const char *data, uint16_t len);
+void process_packet_chain(const void *chain, hp_seg_fn next_seg);
+
+// Closes sessions idle for more than PARSER_SESSION_IDLE_US (parser side)
+void packet_parser_expire(uint64_t now_us);
+
+const parser_stats *packet_parser_stats(void);
+
+// Senders with an open session
+uint8_t packet_parser_sessions(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PACKET_PARSER_H
@@ -0,0 +1,222 @@
+#include "packet_queue.h"
+#include "hid_port.h"
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <string.h>
+
+#define PACKET_QUEUE_MASK (PACKET_QUEUE_BYTES - 1)
+#define REFS_MASK (PACKET_QUEUE_MAX_REFS - 1)
+#define CACHE_LINE_SIZE 64
+#define RECORD_ALIGN _Alignof(Packet)
+#define RECORD_SIZE(len) ((sizeof(Packet) + (len) + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1))
+
+_Static_assert((PACKET_QUEUE_BYTES & PACKET_QUEUE_MASK) == 0,
+               "PACKET_QUEUE_BYTES must be a power of two");
+_Static_assert((PACKET_QUEUE_MAX_REFS & REFS_MASK) == 0,
+               "PACKET_QUEUE_MAX_REFS must be a power of two");
+// An empty ring must take the largest record wherever head happens to be
+_Static_assert(2 * RECORD_SIZE(PACKET_MAX_LEN) <= PACKET_QUEUE_BYTES,
+               "PACKET_QUEUE_BYTES too small for PACKET_MAX_LEN");
+// A skip marker needs the size field, and there is always one alignment unit
+_Static_assert(offsetof(Packet, size) + sizeof(uint16_t) <= RECORD_ALIGN,
+               "skip marker does not fit");
+
+// head/tail are free-running byte counters, published/consumed count
+// packets; each side writes only its own cache line.
+static struct {
+    alignas(CACHE_LINE_SIZE) _Atomic uint32_t head;   // written by producer
+    _Atomic uint32_t published;
+    _Atomic uint32_t enqueued;
+    _Atomic uint32_t dropped;
+    _Atomic uint32_t high_watermark;
+    _Atomic uint32_t bytes_high;
+    _Atomic uint32_t truncated;
+    _Atomic uint32_t refs_queued;
+    uint32_t refs_outstanding;                        // producer only
+    uint32_t reserved_skip, reserved_size;            // producer only
+    packet_sender source;                             // producer only
+    _Atomic uint32_t returned_tail;                   // written by producer
+
+    alignas(CACHE_LINE_SIZE) _Atomic uint32_t tail;   // written by consumer
+    _Atomic uint32_t consumed;
+    _Atomic uint32_t returned_head;                   // written by consumer
+
+    alignas(CACHE_LINE_SIZE) uint8_t buf[PACKET_QUEUE_BYTES];
+
+    // Consumed buffer references travelling back to the producer. At most
+    // PACKET_QUEUE_MAX_REFS are outstanding, so this ring cannot overflow.
+    void *returned[PACKET_QUEUE_MAX_REFS];
+} queue;
+
+static Packet *record_at(uint32_t pos) {
+    return (Packet *)&queue.buf[pos & PACKET_QUEUE_MASK];
+}
+
+uint32_t packet_queue_record_size(uint16_t len) {
+    return (uint32_t)RECORD_SIZE(len);
+}
+
+// ───────────────────────────────
+// Producer (core1)
+// ───────────────────────────────
+Packet *packet_queue_reserve(uint16_t len) {
+    if (len > PACKET_MAX_LEN) return NULL;
+    uint32_t head = atomic_load_explicit(&queue.head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&queue.tail, memory_order_acquire);
+    uint32_t size = (uint32_t)RECORD_SIZE(len);
+    uint32_t to_end = PACKET_QUEUE_BYTES - (head & PACKET_QUEUE_MASK);
+    uint32_t skip = size > to_end ? to_end : 0;
+    if (PACKET_QUEUE_BYTES - (head - tail) < skip + size) return NULL;
+    queue.reserved_skip = skip;
+    queue.reserved_size = size;
+    return record_at(head + skip);
+}
+
+void packet_queue_publish(void) {
+    uint32_t head = atomic_load_explicit(&queue.head, memory_order_relaxed);
+    if (queue.reserved_skip) record_at(head)->size = 0;   // consumer restarts at offset 0
+    head += queue.reserved_skip;
+    Packet *pkt = record_at(head);
+    pkt->size = (uint16_t)queue.reserved_size;
+    pkt->rx_us = (uint32_t)hid_port_time_us();
+    pkt->from = queue.source;
+    head += queue.reserved_size;
+
+    uint32_t depth = atomic_fetch_add_explicit(&queue.published, 1, memory_order_relaxed) + 1 -
+                     atomic_load_explicit(&queue.consumed, memory_order_relaxed);
+    if (depth > atomic_load_explicit(&queue.high_watermark, memory_order_relaxed))
+        atomic_store_explicit(&queue.high_watermark, depth, memory_order_relaxed);
+    uint32_t used = head - atomic_load_explicit(&queue.tail, memory_order_relaxed);
+    if (used > atomic_load_explicit(&queue.bytes_high, memory_order_relaxed))
+        atomic_store_explicit(&queue.bytes_high, used, memory_order_relaxed);
+    atomic_fetch_add_explicit(&queue.enqueued, 1, memory_order_relaxed);
+
+    // Release: the record contents are visible before the new head
+    atomic_store_explicit(&queue.head, head, memory_order_release);
+}
+
+void packet_queue_set_source(uint32_t addr, uint16_t port) {
+    queue.source.addr = addr;
+    queue.source.port = port;
+}
+
+void packet_queue_count_drop(void) {
+    atomic_fetch_add_explicit(&queue.dropped, 1, memory_order_relaxed);
+}
+
+void packet_queue_count_truncated(void) {
+    atomic_fetch_add_explicit(&queue.truncated, 1, memory_order_relaxed);
+}
+
+bool enqueue_packet(const char *data, uint16_t len) {
+    bool truncated = len > PACKET_MAX_LEN;
+    if (truncated) len = PACKET_MAX_LEN;
+    Packet *slot = packet_queue_reserve(len);
+    if (!slot) {
+        packet_queue_count_drop();
+        return false; // full, drop
+    }
+    if (truncated) packet_queue_count_truncated();
+    memcpy(slot->data, data, len);
+    slot->len = len;
+    slot->ref = NULL;
+    packet_queue_publish();
+    return true;
+}
+
+bool enqueue_packet_ref(void *ref, uint16_t len) {
+    if (queue.refs_outstanding >= PACKET_QUEUE_MAX_REFS) return false;
+    Packet *slot = packet_queue_reserve(0);
+    if (!slot) return false;
+    slot->len = len;
+    slot->ref = ref;
+    queue.refs_outstanding++;
+    atomic_fetch_add_explicit(&queue.refs_queued, 1, memory_order_relaxed);
+    packet_queue_publish();
+    return true;
+}
+
+void *packet_queue_reclaim(void) {
+    uint32_t tail = atomic_load_explicit(&queue.returned_tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&queue.returned_head, memory_order_acquire);
+    if (tail == head) return NULL;
+    void *ref = queue.returned[tail & REFS_MASK];
+    atomic_store_explicit(&queue.returned_tail, tail + 1, memory_order_release);
+    queue.refs_outstanding--;
+    return ref;
+}
+
+// ───────────────────────────────
+// Consumer (core0)
+// ───────────────────────────────
+const Packet *packet_queue_peek(void) {
+    uint32_t tail = atomic_load_explicit(&queue.tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&queue.head, memory_order_acquire);
+    if (tail == head) return NULL;
+    if (record_at(tail)->size == 0) {
+        // Skip marker: the record was published together with it at offset 0
+        tail += PACKET_QUEUE_BYTES - (tail & PACKET_QUEUE_MASK);
+        atomic_store_explicit(&queue.tail, tail, memory_order_release);
+    }
+    return record_at(tail);
+}
+
+void packet_queue_release(void) {
+    uint32_t tail = atomic_load_explicit(&queue.tail, memory_order_relaxed);
+    const Packet *pkt = record_at(tail);
+
+    if (pkt->ref) {
+        uint32_t head = atomic_load_explicit(&queue.returned_head, memory_order_relaxed);
+        queue.returned[head & REFS_MASK] = pkt->ref;
+        atomic_store_explicit(&queue.returned_head, head + 1, memory_order_release);
+    }
+
+    // Release: we are done reading the record before the producer may reuse it
+    uint32_t consumed = atomic_load_explicit(&queue.consumed, memory_order_relaxed);
+    atomic_store_explicit(&queue.consumed, consumed + 1, memory_order_release);
+    atomic_store_explicit(&queue.tail, tail + pkt->size, memory_order_release);
+}
+
+// ───────────────────────────────
+// Metrics
+// ───────────────────────────────
+uint32_t packet_queue_depth(void) {
+    // consumed first: a count read after it can only be larger
+    uint32_t consumed = atomic_load_explicit(&queue.consumed, memory_order_acquire);
+    uint32_t published = atomic_load_explicit(&queue.published, memory_order_acquire);
+    return published - consumed;
+}
+
+uint32_t packet_queue_bytes_used(void) {
+    uint32_t head = atomic_load_explicit(&queue.head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&queue.tail, memory_order_acquire);
+    return head - tail;
+}
+
+void packet_queue_get_stats(packet_queue_stats *out) {
+    out->enqueued = atomic_load_explicit(&queue.enqueued, memory_order_relaxed);
+    out->dropped = atomic_load_explicit(&queue.dropped, memory_order_relaxed);
+    out->high_watermark = atomic_load_explicit(&queue.high_watermark, memory_order_relaxed);
+    out->bytes_high = atomic_load_explicit(&queue.bytes_high, memory_order_relaxed);
+    out->truncated = atomic_load_explicit(&queue.truncated, memory_order_relaxed);
+    out->refs_queued = atomic_load_explicit(&queue.refs_queued, memory_order_relaxed);
+}
+
+void packet_queue_reset(void) {
+    atomic_store(&queue.head, 0);
+    atomic_store(&queue.tail, 0);
+    atomic_store(&queue.published, 0);
+    atomic_store(&queue.consumed, 0);
+    atomic_store(&queue.enqueued, 0);
+    atomic_store(&queue.dropped, 0);
+    atomic_store(&queue.high_watermark, 0);
+    atomic_store(&queue.bytes_high, 0);
+    atomic_store(&queue.truncated, 0);
+    atomic_store(&queue.refs_queued, 0);
+    atomic_store(&queue.returned_head, 0);
+    atomic_store(&queue.returned_tail, 0);
+    queue.refs_outstanding = 0;
+    queue.reserved_skip = queue.reserved_size = 0;
+    memset(&queue.source, 0, sizeof(queue.source));
+}
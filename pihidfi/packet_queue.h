@@ -0,0 +1,106 @@
+#ifndef PACKET_QUEUE_H
+#define PACKET_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Longest datagram copied into the queue (pi_client's MAX_PACKET_LEN);
+// anything longer is truncated
+#define PACKET_MAX_LEN 1024
+
+// Record ring: each packet takes its header plus its own length, rounded up
+// to the header alignment. 8 KB holds a few hundred typical 10-40 byte
+// datagrams, or several full-size ones.
+#ifndef PACKET_QUEUE_BYTES
+#define PACKET_QUEUE_BYTES 8192   // must be a power of two
+#endif
+
+// Upper bound on buffers held by reference (zero-copy mode). Keep it below
+// the network stack's receive pool so lwIP never runs dry.
+#ifndef PACKET_QUEUE_MAX_REFS
+#define PACKET_QUEUE_MAX_REFS 16  // must be a power of two
+#endif
+
+// Datagram source; each distinct sender gets its own input session
+typedef struct {
+    uint32_t addr;      // IPv4 address as received
+    uint16_t port;
+} packet_sender;
+
+typedef struct {
+    uint16_t len;       // payload length (total chain length when ref is set)
+    uint16_t size;      // record bytes, header included; set by publish
+    uint32_t rx_us;     // hid_port_time_us() when the packet was published
+    packet_sender from; // source set with packet_queue_set_source()
+    void *ref;          // borrowed receive buffer, or NULL if data holds a copy
+    char data[];        // room for the length passed to packet_queue_reserve()
+} Packet;
+
+typedef struct {
+    uint32_t enqueued;        // packets published by the producer
+    uint32_t dropped;         // packets rejected because the ring was full
+    uint32_t high_watermark;  // most packets queued at once since reset
+    uint32_t bytes_high;      // most ring bytes in use at once since reset
+    uint32_t truncated;       // copied packets longer than PACKET_MAX_LEN
+    uint32_t refs_queued;     // packets handed over by reference
+} packet_queue_stats;
+
+// ───────────────────────────────
+// Single-producer / single-consumer ring
+// ───────────────────────────────
+// Producer: UDP callback on core1. Consumer: the parser, which runs in the
+// core1 loop with PIHIDFI_SPLIT_PIPELINE and in the core0 main loop without.
+// Records are filled and consumed in place; nothing is copied on dequeue.
+// A record never wraps: when it does not fit before the end of the buffer
+// the producer leaves a skip marker there and starts over at offset 0.
+
+// Producer side: returns a record with room for len (<= PACKET_MAX_LEN)
+// payload bytes, or NULL if the ring has no room for it. The record becomes
+// visible to the consumer after packet_queue_publish().
+Packet *packet_queue_reserve(uint16_t len);
+void packet_queue_publish(void);
+
+// Ring bytes a packet with len payload bytes occupies
+uint32_t packet_queue_record_size(uint16_t len);
+
+// Source stamped on the packets published from now on
+void packet_queue_set_source(uint32_t addr, uint16_t port);
+
+// Accounting for producers that fill reserved records themselves
+void packet_queue_count_drop(void);
+void packet_queue_count_truncated(void);
+
+// Copies data into a new record and publishes it. Counts a drop when full.
+bool enqueue_packet(const char *data, uint16_t len);
+
+// Zero-copy: queues a reference to a receive buffer the producer keeps alive
+// until it comes back through packet_queue_reclaim(). Returns false (without
+// counting a drop) when the ring is full or PACKET_QUEUE_MAX_REFS buffers
+// are already outstanding, so the caller can fall back to copying.
+bool enqueue_packet_ref(void *ref, uint16_t len);
+
+// Producer side: returns a consumed buffer reference to free, or NULL
+void *packet_queue_reclaim(void);
+
+// Consumer side: returns the oldest packet or NULL if empty. The record stays
+// owned by the consumer until packet_queue_release(), which also hands any
+// buffer reference back to the producer.
+const Packet *packet_queue_peek(void);
+void packet_queue_release(void);
+
+uint32_t packet_queue_depth(void);        // packets
+uint32_t packet_queue_bytes_used(void);   // ring bytes, skip markers included
+void packet_queue_get_stats(packet_queue_stats *out);
+
+// Empties the ring and clears the counters. Not safe while either side runs.
+void packet_queue_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PACKET_QUEUE_H
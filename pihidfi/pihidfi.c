@@ -5,50 +5,80 @@
 #include "lwip/pbuf.h"
 #include "lwip/ip_addr.h"
 #include "hardware/gpio.h"
+#include "hardware/sync.h"
 #include "tusb.h"
+#include "event_ring.h"
 #include "hid_server.h"
+#include "keymap_table.h"
+#include "packet_queue.h"
+#include "packet_parser.h"
+#include "hid_port.h"
+#include "pipeline_stats.h"
+#include "hid_stats.h"
+#include "telemetry.h"
 #include <stdio.h>
 #include <string.h>
 
 #define UDP_PORT 50037
-#define PACKET_BUF_SIZE 256
-#define PACKET_QUEUE_SIZE 64
+
+// 1: hand pbufs to core0 by reference instead of copying the payload
+#ifndef PIHIDFI_ZERO_COPY
+#define PIHIDFI_ZERO_COPY 1
+#endif
+
+// 1: parse on core1 and hand core0 decoded events, so core0 only applies
+// them and services USB; 0: core1 queues datagrams and core0 parses them
+#ifndef PIHIDFI_SPLIT_PIPELINE
+#define PIHIDFI_SPLIT_PIPELINE 1
+#endif
+
+// Core0 normally wakes on SEV from core1 or the USB interrupt; this bounds
+// the sleep in case an event is missed.
+#define IDLE_WAKE_US 10000
+#define STATS_PRINT_INTERVAL_US 10000000
 
 // For Pico 2 W, LED is controlled by CYW43 chip, not GPIO
 
 // Shared data between cores
-static volatile int udp_packet_count = 0;
-static volatile int processed_packet_count = 0;
+static volatile uint32_t udp_packet_count = 0;
 static volatile bool core1_ready = false;
 
-typedef struct {
-    uint16_t len;
-    char data[PACKET_BUF_SIZE];
-} Packet;
-
-static Packet packet_queue[PACKET_QUEUE_SIZE];
-static volatile int packet_head = 0, packet_tail = 0;
-
 static struct udp_pcb *udp_server;
+static struct udp_pcb *stats_server;
 
 // ───────────────────────────────
-// Utility: ring buffer
+// pbuf helpers
 // ───────────────────────────────
-static bool enqueue_packet(const char *data, uint16_t len) {
-    int next = (packet_head + 1) % PACKET_QUEUE_SIZE;
-    if (next == packet_tail) return false; // full, drop
-    if (len > PACKET_BUF_SIZE) len = PACKET_BUF_SIZE;
-    memcpy(packet_queue[packet_head].data, data, len);
-    packet_queue[packet_head].len = len;
-    packet_head = next;
+// hp_seg_fn over a pbuf chain, used by core0 to parse in place
+static bool pbuf_segment(const void **seg, const uint8_t **data, size_t *len) {
+    const struct pbuf *p = (const struct pbuf *)*seg;
+    if (!p) return false;
+    *data = (const uint8_t *)p->payload;
+    *len = p->len;
+    *seg = p->next;
     return true;
 }
 
-static bool dequeue_packet(Packet *pkt) {
-    if (packet_tail == packet_head) return false;
-    *pkt = packet_queue[packet_tail];
-    packet_tail = (packet_tail + 1) % PACKET_QUEUE_SIZE;
-    return true;
+// Frees pbufs core0 has finished with. Must run in lwIP context on core1.
+static void reclaim_pbufs(void) {
+    void *ref;
+    while ((ref = packet_queue_reclaim()) != NULL) pbuf_free((struct pbuf *)ref);
+}
+
+// Runs every queued datagram through the parser. Returns true if pbufs
+// were handed back for freeing.
+static bool parse_queued_packets(void) {
+    const Packet *pkt;
+    bool returned_ref = false;
+    while ((pkt = packet_queue_peek()) != NULL) {
+        pipeline_packet_begin(pkt->rx_us);
+        if (pkt->ref) process_packet_chain_from(&pkt->from, pkt->ref, pbuf_segment);
+        else process_packet_from(&pkt->from, pkt->data, pkt->len);
+        pipeline_packet_end();
+        returned_ref |= pkt->ref != NULL;
+        packet_queue_release();
+    }
+    return returned_ref;
 }
 
 // ───────────────────────────────
@@ -57,65 +87,71 @@ static bool dequeue_packet(Packet *pkt) {
 static void udp_receive_callback(void *arg, struct udp_pcb *pcb, struct pbuf *p,
                                  const ip_addr_t *addr, u16_t port) {
     if (!p) return;
-    if (p->tot_len > 0 && p->payload) {
-        bool queued = enqueue_packet((char *)p->payload, p->tot_len);
+    udp_packet_count++;
+    reclaim_pbufs();
+
+    if (p->tot_len == 0) {
+        pbuf_free(p);
+        return;
+    }
+    // Per-sender sessions on core0 keep several clients from cancelling
+    // each other's keys
+    packet_queue_set_source(ip4_addr_get_u32(ip_2_ip4(addr)), port);
+
+#if PIHIDFI_ZERO_COPY
+    // Ownership of p passes to the queue; core0 returns it for freeing
+    if (enqueue_packet_ref(p, p->tot_len)) {
+        hid_port_doorbell_ring();
+        return;
+    }
+#endif
+
+    // Copy path (also the fallback when too many pbufs are outstanding)
+    uint16_t len = p->tot_len > PACKET_MAX_LEN ? PACKET_MAX_LEN : p->tot_len;
+    Packet *slot = packet_queue_reserve(len);
+    if (slot) {
+        if (len < p->tot_len) packet_queue_count_truncated();
+        // Walks the chain; p->payload alone only covers the first pbuf
+        slot->len = pbuf_copy_partial(p, slot->data, len, 0);
+        slot->ref = NULL;
+        packet_queue_publish();
+        hid_port_doorbell_ring();
+    } else {
+        packet_queue_count_drop();
     }
-    pbuf_free(p); // must free immediately
+    pbuf_free(p);
 }
 
-static void process_packet(const Packet *pkt) {
-    processed_packet_count++;
-
-    char msg[PACKET_BUF_SIZE + 1];
-    memcpy(msg, pkt->data, pkt->len);
-    msg[pkt->len] = '\0';
-
-    char *saveptr;
-    char *cmd = strtok_r(msg, ";", &saveptr);
-
-    int total_dx = 0;
-    int total_dy = 0;
-    int total_scroll = 0;
-    uint8_t buttons = 0;
-    uint8_t button_changes = 0;
-
-    while (cmd != NULL) {
-        while (*cmd == ' ') cmd++;
-
-        if (cmd[0] == 'M') {
-            int type, value;
-            if (sscanf(cmd, "M,%d,%d", &type, &value) == 2) {
-                switch (type) {
-                    case 0: total_dx += (int8_t)value; break;  // accumulate X
-                    case 1: total_dy += (int8_t)value; break;  // accumulate Y
-                    case 8: total_scroll += (int8_t)value; break;
-                    case 272: // left
-                        hid_send_mouse_button(1, value == 1);
-                        break;
-                    case 273: // right
-                        hid_send_mouse_button(2, value == 1);
-                        break;
-                    case 274: // middle
-                        hid_send_mouse_button(4, value == 1);
-                        break;
-                }
-            }
-        } else if (cmd[0] == 'K') {
-            int code, value;
-            if (sscanf(cmd, "K,%d,%d", &code, &value) == 2) {
-                handle_key_event((uint8_t)code, value == 1);
-            }
-        }
+// ───────────────────────────────
+// Stats channel (HS_PORT): one reply per request datagram
+// ───────────────────────────────
+static void stats_receive_callback(void *arg, struct udp_pcb *pcb, struct pbuf *p,
+                                   const ip_addr_t *addr, u16_t port) {
+    if (!p) return;
+    uint8_t req = HS_REQ_SNAPSHOT;
+    if (p->tot_len > 0) pbuf_copy_partial(p, &req, 1, 0);
+    pbuf_free(p);
 
-        cmd = strtok_r(NULL, ";", &saveptr);
+    struct pbuf *reply = pbuf_alloc(PBUF_TRANSPORT, HS_MAX_REPLY, PBUF_RAM);
+    if (!reply) return;
+
+    // Callbacks run with the lwIP/cyw43 lock held, so the driver is ours
+    telemetry_link link = {udp_packet_count, 0};
+    if (cyw43_wifi_get_rssi(&cyw43_state, &link.rssi_dbm) != 0) link.rssi_dbm = 0;
+
+    hs_writer w;
+    hs_writer_init(&w, (uint8_t *)reply->payload, HS_MAX_REPLY);
+    telemetry_write(&w, &link);
+    size_t len = hs_writer_finish(&w);
+    if (len > 0) {
+        pbuf_realloc(reply, (u16_t)len);
+        udp_sendto(pcb, reply, addr, port);
     }
+    pbuf_free(reply);
 
-    // After parsing all commands in this packet, send one combined report
-    if (total_dx || total_dy || total_scroll)
-        hid_send_mouse_move((int8_t)total_dx, (int8_t)total_dy, (int8_t)total_scroll);
+    if (req == HS_REQ_RESET) pipeline_stats_request_reset();
 }
 
-
 void core1_entry() {
     // Wi-Fi + UDP server here
     if (cyw43_arch_init()) return;
@@ -124,24 +160,101 @@ void core1_entry() {
     udp_server = udp_new_ip_type(IPADDR_TYPE_ANY);
     udp_bind(udp_server, IP_ANY_TYPE, UDP_PORT);
     udp_recv(udp_server, udp_receive_callback, NULL);
+    stats_server = udp_new_ip_type(IPADDR_TYPE_ANY);
+    udp_bind(stats_server, IP_ANY_TYPE, HS_PORT);
+    udp_recv(stats_server, stats_receive_callback, NULL);
+    // With the threadsafe_background arch, cyw43 and lwIP run from interrupts
+    // on this core, so there is nothing to poll.
+#if PIHIDFI_SPLIT_PIPELINE
+    // Parse what the UDP callback queued and wake core0 for the events
     while (true) {
-        cyw43_arch_poll();
-        sleep_us(1000);
+        if (packet_queue_depth() > 0) {
+            parse_queued_packets();
+            hid_port_doorbell_ring();
+        }
+        packet_parser_expire(time_us_64());
+        pipeline_stats_service_parser();
+        cyw43_arch_lwip_begin();
+        reclaim_pbufs();
+        cyw43_arch_lwip_end();
+        hid_port_wait_event(IDLE_WAKE_US);
     }
+#else
+    // Wake only to free pbufs that core0 has returned (it rings the
+    // doorbell after releasing them).
+    while (true) {
+        cyw43_arch_lwip_begin();
+        reclaim_pbufs();
+        cyw43_arch_lwip_end();
+        __wfe();
+    }
+#endif
+}
+
+// ───────────────────────────────
+// Frame callbacks
+// ───────────────────────────────
+// SOF interrupts only while reports wait for an endpoint: an idle device
+// takes no 1 kHz wakeups and the bus can suspend
+static bool sof_enabled = false;
+
+static void update_sof(void) {
+    bool want = hid_server_pending();
+    if (want == sof_enabled) return;
+    tud_sof_cb_enable(want);
+    sof_enabled = want;
 }
 
 int main() {
     stdio_init_all();
+    pipeline_stats_reset();
+    packet_parser_set_split(PIHIDFI_SPLIT_PIPELINE);
     multicore_launch_core1(core1_entry);
 
     tusb_init();
-    init_key_table();
+    hid_server_set_mouse_hires(PIHIDFI_HIRES_MOUSE);
+    hid_server_set_nkro(PIHIDFI_NKRO);
+
+    uint64_t next_stats_us = time_us_64() + STATS_PRINT_INTERVAL_US;
 
     while (true) {
         tud_task();
+
+#if PIHIDFI_SPLIT_PIPELINE
+        // Events core1 decoded
+        packet_parser_apply_events();
+#else
         // Process packet queue populated by UDP callbacks on core1
-        Packet pkt;
-        while (dequeue_packet(&pkt)) process_packet(&pkt);
-        sleep_us(100);
+        if (parse_queued_packets()) hid_port_doorbell_ring(); // let core1 free the pbufs
+        packet_parser_expire(time_us_64());
+#endif
+
+        // Motion the endpoint could not take yet (normally sent from the
+        // report-complete callback)
+        hid_server_service();
+        update_sof();
+
+#if PIHIDFI_SPLIT_PIPELINE
+        pipeline_stats_service_hid();   // core1 clears the parser stages
+#else
+        pipeline_stats_service();
+#endif
+        if (time_us_64() >= next_stats_us) {
+            pipeline_stats_print();
+            const parser_stats *ps = packet_parser_stats();
+            printf("seq: lost=%lu stale=%lu restarts=%lu resyncs=%lu recovered=%lu\n",
+                   (unsigned long)ps->seq_lost, (unsigned long)ps->seq_stale,
+                   (unsigned long)ps->seq_restarts, (unsigned long)ps->resyncs,
+                   (unsigned long)ps->recovered);
+            printf("sessions: opened=%lu expired=%lu evicted=%lu\n",
+                   (unsigned long)ps->sessions_opened, (unsigned long)ps->sessions_expired,
+                   (unsigned long)ps->sessions_evicted);
+            next_stats_us += STATS_PRINT_INTERVAL_US;
+        }
+
+        // Block until core1 rings, USB interrupts, or the safety timeout
+        uint32_t waiting = PIHIDFI_SPLIT_PIPELINE ? event_ring_depth() : packet_queue_depth();
+        if (!tud_task_event_ready() && waiting == 0)
+            hid_port_wait_event(IDLE_WAKE_US);
     }
-}
\ No newline at end of file
+}
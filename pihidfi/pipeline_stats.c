@@ -0,0 +1,151 @@
+#include "pipeline_stats.h"
+#include "hid_port.h"
+#include "hid_proto.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define PIPELINE_MAX_ITF 8
+
+static latency_hist stages[HS_STAGE_COUNT];
+
+// Receive and dequeue time of the datagram being parsed
+static uint32_t cur_rx_us;
+static uint32_t cur_dequeue_us;
+
+// Receive time of the datagram whose events the HID core is applying
+static uint32_t applied_rx_us;
+
+// Lowest (receive - send) clock offset seen; the excess is network queuing
+static bool have_min_offset;
+static int32_t min_offset;
+
+// Origin of the report in flight on each interface
+static struct {
+    bool pending;
+    uint32_t rx_us;
+    uint32_t queued_us;
+} in_flight[PIPELINE_MAX_ITF];
+
+// Pending resets, one per side so each side only clears what it writes
+static atomic_bool parser_reset_requested;
+static atomic_bool hid_reset_requested;
+
+// CLIENT, NETWORK, QUEUE and PARSE are recorded by the parser side
+static void reset_parser_side(void) {
+    latency_hist_reset(&stages[HS_STAGE_CLIENT]);
+    latency_hist_reset(&stages[HS_STAGE_NETWORK]);
+    latency_hist_reset(&stages[HS_STAGE_QUEUE]);
+    latency_hist_reset(&stages[HS_STAGE_PARSE]);
+    have_min_offset = false;
+}
+
+// APPLY, USB and TOTAL by the HID side
+static void reset_hid_side(void) {
+    latency_hist_reset(&stages[HS_STAGE_APPLY]);
+    latency_hist_reset(&stages[HS_STAGE_USB]);
+    latency_hist_reset(&stages[HS_STAGE_TOTAL]);
+    for (unsigned i = 0; i < PIPELINE_MAX_ITF; i++) in_flight[i].pending = false;
+}
+
+void pipeline_stats_reset(void) {
+    reset_parser_side();
+    reset_hid_side();
+}
+
+void pipeline_packet_begin(uint32_t rx_us) {
+    uint32_t now = (uint32_t)hid_port_time_us();
+    cur_rx_us = rx_us;
+    cur_dequeue_us = now;
+    latency_hist_record(&stages[HS_STAGE_QUEUE], now - rx_us);
+}
+
+void pipeline_packet_end(void) {
+    uint32_t now = (uint32_t)hid_port_time_us();
+    latency_hist_record(&stages[HS_STAGE_PARSE], now - cur_dequeue_us);
+}
+
+void pipeline_packet_header(uint8_t flags, uint32_t seq, uint32_t send_us, uint16_t age_us) {
+    (void)seq;
+    if (!(flags & HP_FLAG_TIME)) return;
+
+    latency_hist_record(&stages[HS_STAGE_CLIENT], age_us);
+
+    // Sender and receiver clocks are unrelated; only the variation of the
+    // offset is meaningful.
+    int32_t offset = (int32_t)(cur_rx_us - send_us);
+    if (!have_min_offset || offset < min_offset) {
+        min_offset = offset;
+        have_min_offset = true;
+    }
+    latency_hist_record(&stages[HS_STAGE_NETWORK], (uint32_t)(offset - min_offset));
+}
+
+uint32_t pipeline_packet_rx_us(void) {
+    return cur_rx_us;
+}
+
+void pipeline_packet_applied(uint32_t rx_us, uint32_t decoded_us) {
+    applied_rx_us = rx_us;
+    latency_hist_record(&stages[HS_STAGE_APPLY], (uint32_t)hid_port_time_us() - decoded_us);
+}
+
+void pipeline_report_sent(uint8_t itf) {
+    if (itf >= PIPELINE_MAX_ITF) return;
+    in_flight[itf].pending = true;
+    in_flight[itf].rx_us = applied_rx_us;
+    in_flight[itf].queued_us = (uint32_t)hid_port_time_us();
+}
+
+void pipeline_report_complete(uint8_t itf) {
+    if (itf >= PIPELINE_MAX_ITF || !in_flight[itf].pending) return;
+    uint32_t now = (uint32_t)hid_port_time_us();
+    latency_hist_record(&stages[HS_STAGE_USB], now - in_flight[itf].queued_us);
+    latency_hist_record(&stages[HS_STAGE_TOTAL], now - in_flight[itf].rx_us);
+    in_flight[itf].pending = false;
+}
+
+const latency_hist *pipeline_stage_hist(unsigned stage) {
+    return stage < HS_STAGE_COUNT ? &stages[stage] : NULL;
+}
+
+void pipeline_stats_request_reset(void) {
+    atomic_store_explicit(&parser_reset_requested, true, memory_order_release);
+    atomic_store_explicit(&hid_reset_requested, true, memory_order_release);
+}
+
+void pipeline_stats_service_parser(void) {
+    if (atomic_exchange_explicit(&parser_reset_requested, false, memory_order_acq_rel))
+        reset_parser_side();
+}
+
+void pipeline_stats_service_hid(void) {
+    if (atomic_exchange_explicit(&hid_reset_requested, false, memory_order_acq_rel))
+        reset_hid_side();
+}
+
+void pipeline_stats_service(void) {
+    pipeline_stats_service_parser();
+    pipeline_stats_service_hid();
+}
+
+void pipeline_stats_write(hs_writer *w) {
+    // Read from core1 while core0 records: individual fields may be one
+    // sample apart, which is fine for statistics.
+    hs_begin_section(w, HS_SEC_LATENCY);
+    for (unsigned s = 0; s < HS_STAGE_COUNT; s++) {
+        const latency_hist *h = &stages[s];
+        hs_put_u8(w, (uint8_t)s);
+        hs_put_u32(w, h->count);
+        hs_put_u32(w, h->count ? h->min_us : 0);
+        hs_put_u32(w, h->max_us);
+        hs_put_u64(w, h->sum_us);
+        hs_put_u8(w, LATENCY_HIST_BUCKETS);
+        for (unsigned b = 0; b < LATENCY_HIST_BUCKETS; b++) hs_put_u32(w, h->buckets[b]);
+    }
+    hs_end_section(w);
+}
+
+void pipeline_stats_print(void) {
+    for (unsigned s = 0; s < HS_STAGE_COUNT; s++) latency_hist_print(&stages[s], hs_stage_names[s]);
+}
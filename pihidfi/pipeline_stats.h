@@ -0,0 +1,65 @@
+#ifndef PIPELINE_STATS_H
+#define PIPELINE_STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "hid_stats.h"
+#include "latency_hist.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ───────────────────────────────
+// Per-stage latency tracking
+// ───────────────────────────────
+// Stages are listed in hid_stats.h (HS_STAGE_*). The loop that runs the
+// parser brackets each datagram with begin/end, the parser reports the
+// header timestamps and when the datagram's events reach the HID core,
+// which reports when a report is queued and when the host has read it.
+// With the split pipeline the parser side runs on core1 and the HID side
+// on core0; each stage is written from one side only.
+
+// Clears every stage; only while neither side is recording
+void pipeline_stats_reset(void);
+
+// Called by the main loop around process_packet()
+void pipeline_packet_begin(uint32_t rx_us);
+void pipeline_packet_end(void);
+
+// Called by the parser with the datagram's header extension
+void pipeline_packet_header(uint8_t flags, uint32_t seq, uint32_t send_us, uint16_t age_us);
+
+// Receive time passed to the last pipeline_packet_begin()
+uint32_t pipeline_packet_rx_us(void);
+
+// Called on the HID side when a datagram's events are applied; reports
+// sent from now on are timed from rx_us
+void pipeline_packet_applied(uint32_t rx_us, uint32_t decoded_us);
+
+// Called by the HID core: report accepted by the endpoint / read by the host
+void pipeline_report_sent(uint8_t itf);
+void pipeline_report_complete(uint8_t itf);
+
+const latency_hist *pipeline_stage_hist(unsigned stage);
+
+// Safe from any core or callback. Each side applies its half of the reset
+// on its own core: pipeline_stats_service_parser() clears the parser stages,
+// pipeline_stats_service_hid() the HID stages. A loop that runs both sides
+// calls pipeline_stats_service().
+void pipeline_stats_request_reset(void);
+void pipeline_stats_service_parser(void);
+void pipeline_stats_service_hid(void);
+void pipeline_stats_service(void);
+
+// Writes an HS_SEC_LATENCY section for every stage
+void pipeline_stats_write(hs_writer *w);
+
+// Human-readable dump via printf
+void pipeline_stats_print(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PIPELINE_STATS_H
@@ -0,0 +1,48 @@
+#include "telemetry.h"
+#include "event_ring.h"
+#include "hid_server.h"
+#include "packet_parser.h"
+#include "packet_queue.h"
+#include "pipeline_stats.h"
+
+static void put_counter(hs_writer *w, uint8_t id, uint32_t value) {
+    hs_put_u8(w, id);
+    hs_put_u32(w, value);
+}
+
+void telemetry_write(hs_writer *w, const telemetry_link *link) {
+    pipeline_stats_write(w);
+
+    packet_queue_stats qs;
+    packet_queue_get_stats(&qs);
+    const parser_stats *ps = packet_parser_stats();
+    hid_server_stats hs;
+    hid_server_get_stats(&hs);
+    event_ring_stats es;
+    event_ring_get_stats(&es);
+
+    hs_begin_section(w, HS_SEC_COUNTERS);
+    put_counter(w, HS_CTR_UDP_RX, link->udp_rx);
+    put_counter(w, HS_CTR_PACKETS, ps->packets);
+    put_counter(w, HS_CTR_QUEUE_DEPTH, packet_queue_depth());
+    put_counter(w, HS_CTR_QUEUE_HIGH, qs.high_watermark);
+    put_counter(w, HS_CTR_QUEUE_DROPPED, qs.dropped);
+    put_counter(w, HS_CTR_QUEUE_TRUNCATED, qs.truncated);
+    put_counter(w, HS_CTR_PARSE_ERRORS, ps->parse_errors);
+    put_counter(w, HS_CTR_SEQ_LOST, ps->seq_lost);
+    put_counter(w, HS_CTR_SEQ_STALE, ps->seq_stale);
+    put_counter(w, HS_CTR_RESYNCS, ps->resyncs);
+    put_counter(w, HS_CTR_RECOVERED, ps->recovered);
+    put_counter(w, HS_CTR_REPORTS_SENT, hs.reports_sent);
+    put_counter(w, HS_CTR_READY_STALLS, hs.ready_stalls);
+    put_counter(w, HS_CTR_KBD_OVERWRITTEN, hs.keyboard_overwritten);
+    put_counter(w, HS_CTR_SESSIONS, packet_parser_sessions());
+    put_counter(w, HS_CTR_RSSI, (uint32_t)link->rssi_dbm);
+    put_counter(w, HS_CTR_EVENT_DEPTH, event_ring_depth());
+    put_counter(w, HS_CTR_EVENT_HIGH, es.high_watermark);
+    put_counter(w, HS_CTR_EVENT_WAITS, es.full_waits);
+    put_counter(w, HS_CTR_QUEUE_BYTES, packet_queue_bytes_used());
+    put_counter(w, HS_CTR_QUEUE_BYTES_HIGH, qs.bytes_high);
+    put_counter(w, HS_CTR_SEQ_RESTARTS, ps->seq_restarts);
+    hs_end_section(w);
+}
@@ -0,0 +1,30 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include "hid_stats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ───────────────────────────────
+// Stats channel reply (HS_PORT)
+// ───────────────────────────────
+// Built on core1 in the UDP callback from counters core0 keeps updating;
+// individual values may be one event apart.
+
+// Figures only the network side knows
+typedef struct {
+    uint32_t udp_rx;     // datagrams seen by the UDP callback
+    int32_t rssi_dbm;    // 0 if unknown
+} telemetry_link;
+
+// Writes the HS_SEC_LATENCY and HS_SEC_COUNTERS sections
+void telemetry_write(hs_writer *w, const telemetry_link *link);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TELEMETRY_H
@@ -77,14 +77,32 @@ extern "C" {
 #endif
 
 //------------- CLASS -------------//
-#define CFG_TUD_HID               2  // Number of HID interfaces (keyboard + mouse)
+// NKRO bitmap keyboard as a fourth interface; the boot keyboard stays for BIOS
+#ifndef PIHIDFI_NKRO
+#define PIHIDFI_NKRO              1
+#endif
+
+// keyboard + mouse + consumer control (+ NKRO keyboard)
+#define CFG_TUD_HID               (3 + PIHIDFI_NKRO)
 #define CFG_TUD_CDC               0
 #define CFG_TUD_MSC               0
 #define CFG_TUD_MIDI              0
 #define CFG_TUD_VENDOR            0
 
 // HID buffer size Should be sufficient to hold ID (if any) + Data
-#define CFG_TUD_HID_EP_BUFSIZE    16
+// (29-byte NKRO bitmap report)
+#define CFG_TUD_HID_EP_BUFSIZE    32
+
+// bInterval of both HID endpoints in ms (full speed: 1 = 1000 Hz polling)
+#ifndef PIHIDFI_HID_POLL_MS
+#define PIHIDFI_HID_POLL_MS       1
+#endif
+
+// Mouse interface: 1 = 16-bit X/Y, high-resolution wheel and AC Pan
+// (9-byte report), 0 = TinyUSB's 8-bit boot-style mouse descriptor
+#ifndef PIHIDFI_HIRES_MOUSE
+#define PIHIDFI_HIRES_MOUSE       1
+#endif
 
 #ifdef __cplusplus
 }
@@ -44,14 +44,97 @@ uint8_t const desc_hid_report_keyboard[] = {
 };
 
 /* Mouse */
+#if PIHIDFI_HIRES_MOUSE
+// 5 buttons, 16-bit X/Y, 16-bit wheel and AC Pan. Each wheel sits in its own
+// logical collection with a Resolution Multiplier (1 or 120); hosts that
+// enable it get wheel/pan in 1/120 detents. Feature report byte: bits 0-1
+// wheel multiplier, bits 2-3 pan multiplier (see hid_port_pico.c).
+#define HIRES_AXIS(usage_page, usage)                                      \
+    HID_COLLECTION ( HID_COLLECTION_LOGICAL ),                             \
+      HID_USAGE_PAGE ( HID_USAGE_PAGE_DESKTOP ),                           \
+      HID_USAGE ( HID_USAGE_DESKTOP_RESOLUTION_MULTIPLIER ),               \
+      HID_LOGICAL_MIN ( 0 ), HID_LOGICAL_MAX ( 1 ),                        \
+      HID_PHYSICAL_MIN ( 1 ), HID_PHYSICAL_MAX ( 120 ),                    \
+      HID_REPORT_SIZE ( 2 ), HID_REPORT_COUNT ( 1 ),                       \
+      HID_FEATURE ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ),              \
+      HID_PHYSICAL_MIN ( 0 ), HID_PHYSICAL_MAX ( 0 ),                      \
+      HID_USAGE_PAGE ( usage_page ),                                       \
+      HID_USAGE_N ( usage, 2 ),                                            \
+      HID_LOGICAL_MIN_N ( -32767, 2 ), HID_LOGICAL_MAX_N ( 32767, 2 ),     \
+      HID_REPORT_SIZE ( 16 ), HID_REPORT_COUNT ( 1 ),                      \
+      HID_INPUT ( HID_DATA | HID_VARIABLE | HID_RELATIVE ),                \
+    HID_COLLECTION_END
+
+uint8_t const desc_hid_report_mouse[] = {
+    HID_USAGE_PAGE ( HID_USAGE_PAGE_DESKTOP ),
+    HID_USAGE ( HID_USAGE_DESKTOP_MOUSE ),
+    HID_COLLECTION ( HID_COLLECTION_APPLICATION ),
+      HID_USAGE ( HID_USAGE_DESKTOP_POINTER ),
+      HID_COLLECTION ( HID_COLLECTION_PHYSICAL ),
+        HID_USAGE_PAGE ( HID_USAGE_PAGE_BUTTON ),
+        HID_USAGE_MIN ( 1 ), HID_USAGE_MAX ( 5 ),
+        HID_LOGICAL_MIN ( 0 ), HID_LOGICAL_MAX ( 1 ),
+        HID_REPORT_SIZE ( 1 ), HID_REPORT_COUNT ( 5 ),
+        HID_INPUT ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ),
+        HID_REPORT_SIZE ( 3 ), HID_REPORT_COUNT ( 1 ),
+        HID_INPUT ( HID_CONSTANT ),
+
+        HID_USAGE_PAGE ( HID_USAGE_PAGE_DESKTOP ),
+        HID_USAGE ( HID_USAGE_DESKTOP_X ), HID_USAGE ( HID_USAGE_DESKTOP_Y ),
+        HID_LOGICAL_MIN_N ( -32767, 2 ), HID_LOGICAL_MAX_N ( 32767, 2 ),
+        HID_REPORT_SIZE ( 16 ), HID_REPORT_COUNT ( 2 ),
+        HID_INPUT ( HID_DATA | HID_VARIABLE | HID_RELATIVE ),
+
+        HIRES_AXIS ( HID_USAGE_PAGE_DESKTOP, HID_USAGE_DESKTOP_WHEEL ),
+        HIRES_AXIS ( HID_USAGE_PAGE_CONSUMER, HID_USAGE_CONSUMER_AC_PAN ),
+
+        // Pad the feature report to a whole byte
+        HID_REPORT_SIZE ( 4 ), HID_REPORT_COUNT ( 1 ),
+        HID_FEATURE ( HID_CONSTANT ),
+      HID_COLLECTION_END,
+    HID_COLLECTION_END
+};
+#else
 uint8_t const desc_hid_report_mouse[] = {
     TUD_HID_REPORT_DESC_MOUSE()
 };
+#endif
+
+/* Consumer control (media keys): up to 4 held 16-bit usages */
+uint8_t const desc_hid_report_consumer[] = {
+    HID_USAGE_PAGE ( HID_USAGE_PAGE_CONSUMER ),
+    HID_USAGE ( HID_USAGE_CONSUMER_CONTROL ),
+    HID_COLLECTION ( HID_COLLECTION_APPLICATION ),
+      HID_LOGICAL_MIN ( 0 ), HID_LOGICAL_MAX_N ( 0x03FF, 2 ),
+      HID_USAGE_MIN ( 0 ), HID_USAGE_MAX_N ( 0x03FF, 2 ),
+      HID_REPORT_SIZE ( 16 ), HID_REPORT_COUNT ( 4 ),
+      HID_INPUT ( HID_DATA | HID_ARRAY | HID_ABSOLUTE ),
+    HID_COLLECTION_END
+};
+
+#if PIHIDFI_NKRO
+/* NKRO keyboard: one bit per usage 0x00-0xE7, modifiers in the last byte */
+uint8_t const desc_hid_report_nkro[] = {
+    HID_USAGE_PAGE ( HID_USAGE_PAGE_DESKTOP ),
+    HID_USAGE ( HID_USAGE_DESKTOP_KEYBOARD ),
+    HID_COLLECTION ( HID_COLLECTION_APPLICATION ),
+      HID_USAGE_PAGE ( HID_USAGE_PAGE_KEYBOARD ),
+      HID_USAGE_MIN ( 0 ), HID_USAGE_MAX_N ( 0xE7, 2 ),
+      HID_LOGICAL_MIN ( 0 ), HID_LOGICAL_MAX ( 1 ),
+      HID_REPORT_SIZE ( 1 ), HID_REPORT_COUNT_N ( 0xE8, 2 ),
+      HID_INPUT ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ),
+    HID_COLLECTION_END
+};
+#endif
 
 uint8_t const * tud_hid_descriptor_report_cb(uint8_t itf)
 {
     if(itf == 0) return desc_hid_report_keyboard;
-    else return desc_hid_report_mouse;
+    if(itf == 2) return desc_hid_report_consumer;
+#if PIHIDFI_NKRO
+    if(itf == 3) return desc_hid_report_nkro;
+#endif
+    return desc_hid_report_mouse;
 }
 
 /*--------------------------------------------------------------------+
@@ -60,23 +143,39 @@ uint8_t const * tud_hid_descriptor_report_cb(uint8_t itf)
 enum {
     ITF_NUM_HID_KEYBOARD,
     ITF_NUM_HID_MOUSE,
+    ITF_NUM_HID_CONSUMER,
+#if PIHIDFI_NKRO
+    ITF_NUM_HID_NKRO,
+#endif
     ITF_NUM_TOTAL
 };
 
-#define CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + 2*TUD_HID_DESC_LEN)
+#define CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + CFG_TUD_HID*TUD_HID_DESC_LEN)
 #define EPNUM_HID_KEYBOARD 0x81
 #define EPNUM_HID_MOUSE    0x82
+#define EPNUM_HID_CONSUMER 0x83
+#define EPNUM_HID_NKRO     0x84
 
 uint8_t const desc_configuration[] = {
     TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
 
     // Keyboard interface
     TUD_HID_DESCRIPTOR(ITF_NUM_HID_KEYBOARD, 0, HID_ITF_PROTOCOL_KEYBOARD,
-                       sizeof(desc_hid_report_keyboard), EPNUM_HID_KEYBOARD, CFG_TUD_HID_EP_BUFSIZE, 10),
+                       sizeof(desc_hid_report_keyboard), EPNUM_HID_KEYBOARD, CFG_TUD_HID_EP_BUFSIZE, PIHIDFI_HID_POLL_MS),
 
     // Mouse interface
     TUD_HID_DESCRIPTOR(ITF_NUM_HID_MOUSE, 0, HID_ITF_PROTOCOL_MOUSE,
-                       sizeof(desc_hid_report_mouse), EPNUM_HID_MOUSE, CFG_TUD_HID_EP_BUFSIZE, 10)
+                       sizeof(desc_hid_report_mouse), EPNUM_HID_MOUSE, CFG_TUD_HID_EP_BUFSIZE, PIHIDFI_HID_POLL_MS),
+
+    // Consumer control interface
+    TUD_HID_DESCRIPTOR(ITF_NUM_HID_CONSUMER, 0, HID_ITF_PROTOCOL_NONE,
+                       sizeof(desc_hid_report_consumer), EPNUM_HID_CONSUMER, CFG_TUD_HID_EP_BUFSIZE, PIHIDFI_HID_POLL_MS),
+
+#if PIHIDFI_NKRO
+    // NKRO keyboard interface (no boot protocol)
+    TUD_HID_DESCRIPTOR(ITF_NUM_HID_NKRO, 0, HID_ITF_PROTOCOL_NONE,
+                       sizeof(desc_hid_report_nkro), EPNUM_HID_NKRO, CFG_TUD_HID_EP_BUFSIZE, PIHIDFI_HID_POLL_MS),
+#endif
 };
 
 uint8_t const * tud_descriptor_configuration_cb(uint8_t index)
@@ -0,0 +1,37 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+// Minimal assertion helpers for the host test binary
+
+extern int test_failures;
+extern int test_checks;
+
+#define CHECK(cond) do { \
+    test_checks++; \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+        test_failures++; \
+    } \
+} while (0)
+
+#define CHECK_EQ(a, b) do { \
+    long long _a = (long long)(a), _b = (long long)(b); \
+    test_checks++; \
+    if (_a != _b) { \
+        fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", \
+                __FILE__, __LINE__, #a, #b, _a, _b); \
+        test_failures++; \
+    } \
+} while (0)
+
+// Test suites (one per source file)
+void test_proto(void);
+void test_core(void);
+void test_queue(void);
+void test_client(void);
+void test_keymap(void);
+void test_server(void);
+
+#endif // TEST_H
@@ -0,0 +1,59 @@
+#include "test.h"
+#include "flush_policy.h"
+#include <linux/input-event-codes.h>
+
+static void test_flush_keys_immediate(void) {
+    flush_config cfg = {1000, 5000, true};
+    flush_policy fp;
+    flush_policy_init(&fp, &cfg);
+    CHECK_EQ(flush_deadline(&fp), 0);
+
+    // Key frame goes out at its SYN_REPORT, not before
+    flush_note_event(&fp, EV_KEY, 100000);
+    CHECK(!flush_due(&fp, 100000));
+    CHECK(flush_frame_end(&fp, 100000));
+    flush_sent(&fp, 100000);
+    CHECK_EQ(flush_deadline(&fp), 0);
+
+    // Empty frames (filtered events) never trigger a send
+    CHECK(!flush_frame_end(&fp, 100010));
+
+    // With -K keys are paced like motion
+    cfg.key_immediate = false;
+    flush_policy_init(&fp, &cfg);
+    flush_sent(&fp, 200000);
+    flush_note_event(&fp, EV_KEY, 200100);
+    CHECK(!flush_frame_end(&fp, 200100));
+    CHECK_EQ(flush_deadline(&fp), 200000 + 1000 - 125);
+}
+
+static void test_flush_motion_paced(void) {
+    flush_config cfg = {1000, 5000, true};
+    flush_policy fp;
+    flush_policy_init(&fp, &cfg);
+    flush_sent(&fp, 50000);
+
+    // Frames closer than the pace wait and travel together
+    flush_note_event(&fp, EV_REL, 50200);
+    CHECK(!flush_frame_end(&fp, 50200));
+    flush_note_event(&fp, EV_REL, 50600);
+    CHECK(!flush_frame_end(&fp, 50600));
+    CHECK_EQ(flush_deadline(&fp), 50875);
+    CHECK(!flush_due(&fp, 50874));
+    CHECK(flush_due(&fp, 50875));
+    flush_sent(&fp, 50875);
+
+    // A frame after a quiet period goes out at once
+    flush_note_event(&fp, EV_REL, 60000);
+    CHECK(flush_frame_end(&fp, 60000));
+    flush_sent(&fp, 60000);
+
+    // An unterminated frame is bounded by max_delay
+    flush_note_event(&fp, EV_REL, 70000);
+    CHECK_EQ(flush_deadline(&fp), 75000);
+}
+
+void test_client(void) {
+    test_flush_keys_immediate();
+    test_flush_motion_paced();
+}
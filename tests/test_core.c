@@ -0,0 +1,1204 @@
+#include "test.h"
+#include "hid_port_host.h"
+#include "hid_server.h"
+#include "hid_keycodes.h"
+#include "keymap_table.h"
+#include "latency_hist.h"
+#include "hid_port.h"
+#include "packet_parser.h"
+#include "hid_proto.h"
+#include "event_ring.h"
+#include "pipeline_stats.h"
+#include "telemetry.h"
+#include <stdio.h>
+#include <string.h>
+
+static void reset_core(void) {
+    hid_port_host_reset();
+    hid_port_host_set_time(1000000);
+    hid_server_reset();
+    packet_parser_reset();
+}
+
+static void send_text(const char *s) {
+    process_packet(s, (uint16_t)strlen(s));
+}
+
+static void test_text_keyboard(void) {
+    reset_core();
+    send_text("K,42,1;");
+    hid_port_host_advance(2000);
+    send_text("K,30,1;");
+
+    CHECK_EQ(hid_port_host_report_count(), 2);
+    const host_report *r = hid_port_host_report(1);
+    CHECK_EQ(r->kind, HOST_REPORT_KEYBOARD);
+    CHECK_EQ(r->itf, ITF_KEYBOARD);
+    CHECK_EQ(r->kbd.modifier, 1 << (HID_KEY_SHIFT_LEFT - HID_KEY_CONTROL_LEFT));
+    CHECK_EQ(r->kbd.keycode[0], HID_KEY_A);   // modifiers only in the modifier byte
+
+    // Busy endpoint: nothing is sent
+    hid_port_host_set_ready(ITF_KEYBOARD, false);
+    hid_port_host_advance(2000);
+    send_text("K,30,0;");
+    CHECK_EQ(hid_port_host_report_count(), 2);
+}
+
+static void test_binary_matches_text(void) {
+    reset_core();
+    send_text("M,272,1;M,0,5;M,1,-3;M,8,1;");
+    size_t text_reports = hid_port_host_report_count();
+    host_report text_last = *hid_port_host_report(text_reports - 1);
+
+    reset_core();
+    uint8_t buf[64];
+    hp_writer w;
+    hp_writer_init(&w, buf, sizeof(buf));
+    hp_put_event(&w, HP_EV_KEY, 272, 1);
+    hp_put_event(&w, HP_EV_REL, 0, 5);
+    hp_put_event(&w, HP_EV_REL, 1, -3);
+    hp_put_event(&w, HP_EV_REL, 8, 1);
+    process_packet((const char *)buf, (uint16_t)w.len);
+
+    CHECK_EQ(hid_port_host_report_count(), text_reports);
+    const host_report *r = hid_port_host_report(text_reports - 1);
+    CHECK_EQ(r->kind, HOST_REPORT_MOUSE);
+    CHECK_EQ(r->mouse.buttons, text_last.mouse.buttons);
+    CHECK_EQ(r->mouse.buttons, 1);
+    CHECK_EQ(r->mouse.x, 5);
+    CHECK_EQ(r->mouse.y, -3);
+    CHECK_EQ(r->mouse.vertical, 1);
+}
+
+typedef struct seg {
+    const struct seg *next;
+    const uint8_t *data;
+    size_t len;
+} seg;
+
+static bool seg_next(const void **s, const uint8_t **data, size_t *len) {
+    const seg *cur = (const seg *)*s;
+    if (!cur) return false;
+    *data = cur->data;
+    *len = cur->len;
+    *s = cur->next;
+    return true;
+}
+
+static void test_chained_packets(void) {
+    // Text split across segments is reassembled before parsing
+    reset_core();
+    const char *text = "M,0,5;M,1,-3;";
+    seg t2 = {NULL, (const uint8_t *)text + 4, strlen(text) - 4};
+    seg t1 = {&t2, (const uint8_t *)text, 4};
+    process_packet_chain(&t1, seg_next);
+    CHECK_EQ(hid_port_host_report_count(), 1);
+    CHECK_EQ(hid_port_host_report(0)->mouse.x, 5);
+    CHECK_EQ(hid_port_host_report(0)->mouse.y, -3);
+
+    // A binary batch spread over two segments is not truncated
+    reset_core();
+    uint8_t buf[1024];
+    hp_writer w;
+    hp_writer_init(&w, buf, sizeof(buf));
+    for (int i = 0; i < 130; i++) hp_put_event(&w, HP_EV_REL, 0, (i & 1) ? -1 : 2);
+    hp_put_event(&w, HP_EV_REL, 1, 7);
+    CHECK(w.len > 256);
+    seg b2 = {NULL, buf + 200, w.len - 200};
+    seg b1 = {&b2, buf, 200};
+    process_packet_chain(&b1, seg_next);
+    CHECK_EQ(hid_port_host_report_count(), 1);
+    CHECK_EQ(hid_port_host_report(0)->mouse.x, 65);
+    CHECK_EQ(hid_port_host_report(0)->mouse.y, 7);
+
+    // An empty first segment does not hide the binary magic
+    reset_core();
+    hp_writer_init(&w, buf, sizeof(buf));
+    hp_put_event(&w, HP_EV_KEY, 30, 1);
+    seg e2 = {NULL, buf, w.len};
+    seg e1 = {&e2, buf, 0};
+    process_packet_chain(&e1, seg_next);
+    CHECK_EQ(packet_parser_stats()->parse_errors, 0);
+    CHECK_EQ(hid_port_host_report_count(), 1);
+    CHECK_EQ(hid_port_host_report(0)->kbd.keycode[0], HID_KEY_A);
+}
+
+static void test_parse_errors(void) {
+    reset_core();
+    uint32_t before = packet_parser_stats()->parse_errors;
+    send_text("K,abc;");
+    const uint8_t bad[] = {HP_MAGIC, HP_VERSION, 0, 0xF0};
+    process_packet((const char *)bad, sizeof(bad));
+    CHECK_EQ(packet_parser_stats()->parse_errors, before + 2);
+    CHECK_EQ(hid_port_host_report_count(), 0);
+}
+
+static void test_latency_hist(void) {
+    latency_hist h;
+    latency_hist_reset(&h);
+    CHECK_EQ(latency_hist_percentile(&h, 50), 0);
+
+    for (int i = 0; i < 98; i++) latency_hist_record(&h, 100);   // bucket <=127
+    latency_hist_record(&h, 0);
+    latency_hist_record(&h, 5000);
+    CHECK_EQ(h.count, 100);
+    CHECK_EQ(h.min_us, 0);
+    CHECK_EQ(h.max_us, 5000);
+    CHECK_EQ(latency_hist_percentile(&h, 50), 127);
+    CHECK_EQ(latency_hist_percentile(&h, 99), 127);
+    CHECK_EQ(latency_hist_percentile(&h, 100), 5000);
+
+    latency_hist_record(&h, UINT32_MAX);
+    CHECK_EQ(h.buckets[LATENCY_HIST_BUCKETS - 1], 1);
+}
+
+static void test_doorbell_latched(void) {
+    // A ring before the wait must not be lost (SEV/WFE semantics)
+    hid_port_host_use_real_clock(true);
+    hid_port_doorbell_ring();
+    uint64_t t0 = hid_port_time_us();
+    hid_port_wait_event(1000000);
+    CHECK(hid_port_time_us() - t0 < 500000);
+
+    // Without a ring the wait times out
+    t0 = hid_port_time_us();
+    hid_port_wait_event(2000);
+    CHECK(hid_port_time_us() - t0 >= 1000);
+    hid_port_host_use_real_clock(false);
+}
+
+// Binary datagram with a sequence number; a NULL key list adds no snapshot
+static void send_seq(uint32_t seq, uint16_t key, int pressed,
+                     const uint16_t *held, size_t nheld) {
+    uint8_t buf[128];
+    hp_writer w;
+    hp_writer_init_flags(&w, buf, sizeof(buf), HP_FLAG_SEQ);
+    if (key) hp_put_event(&w, HP_EV_KEY, key, pressed);
+    if (held) hp_put_state(&w, held, nheld);
+    hp_writer_stamp(&w, seq, 0, 0);
+    process_packet((const char *)buf, (uint16_t)w.len);
+}
+
+static void test_seq_tracking(void) {
+    reset_core();
+    send_seq(5000, 30, 1, NULL, 0);
+    hid_port_host_advance(2000);
+    send_seq(5001, 30, 0, NULL, 0);
+    hid_port_host_advance(2000);
+    send_seq(5004, 0, 0, NULL, 0);         // 5002 and 5003 lost
+    send_seq(5003, 31, 1, NULL, 0);        // late: dropped, no stuck key
+    send_seq(5004, 31, 1, NULL, 0);        // duplicate
+    const parser_stats *ps = packet_parser_stats();
+    CHECK_EQ(ps->seq_lost, 2);
+    CHECK_EQ(ps->seq_stale, 2);
+    CHECK_EQ(ps->parse_errors, 0);
+    CHECK_EQ(hid_port_host_report(hid_port_host_report_count() - 1)->kbd.keycode[0], 0);
+
+    // A far jump backwards is a restarted sender, not a duplicate
+    send_seq(0, 0, 0, NULL, 0);
+    send_seq(1, 0, 0, NULL, 0);
+    CHECK_EQ(ps->seq_stale, 2);
+    CHECK_EQ(ps->seq_lost, 2);
+}
+
+static const host_report *last_report(host_report_kind kind) {
+    for (size_t i = hid_port_host_report_count(); i > 0; i--) {
+        const host_report *r = hid_port_host_report(i - 1);
+        if (r->kind == kind) return r;
+    }
+    return NULL;
+}
+
+// Datagram from one run (epoch) of a sender
+static void send_epoch(uint16_t epoch, uint32_t seq, uint16_t key, int pressed) {
+    uint8_t buf[64];
+    hp_writer w;
+    hp_writer_init_flags(&w, buf, sizeof(buf), HP_FLAG_SEQ | HP_FLAG_EPOCH);
+    hp_writer_set_epoch(&w, epoch);
+    hp_put_event(&w, HP_EV_KEY, key, pressed);
+    hp_writer_stamp(&w, seq, 0, 0);
+    process_packet((const char *)buf, (uint16_t)w.len);
+}
+
+static void test_sender_restart(void) {
+    // pi_client restarted on the same address: seq starts over at 0 well
+    // inside the stale window, but the new epoch gives it away
+    reset_core();
+    send_epoch(1, 5, 30, 1);               // A held when the old run died
+    send_epoch(1, 4, 31, 1);               // reordered: still stale
+    const parser_stats *ps = packet_parser_stats();
+    CHECK_EQ(ps->seq_stale, 1);
+    hid_port_host_advance(2000);
+    send_epoch(2, 0, 48, 1);
+    hid_port_host_advance(2000);
+    send_epoch(2, 1, 48, 0);
+    CHECK_EQ(ps->seq_stale, 1);
+    CHECK_EQ(ps->seq_restarts, 1);
+    CHECK_EQ(ps->seq_lost, 0);
+
+    // The old run's A was released, B from the new run went through
+    bool b_down = false;
+    for (size_t i = 0; i < hid_port_host_report_count(); i++) {
+        const host_report *r = hid_port_host_report(i);
+        if (r->kind == HOST_REPORT_KEYBOARD && r->kbd.keycode[0] == 0x05) {
+            CHECK_EQ(r->kbd.keycode[1], 0);
+            b_down = true;
+        }
+    }
+    CHECK(b_down);
+    CHECK_EQ(hid_port_host_report(hid_port_host_report_count() - 1)->kbd.keycode[0], 0);
+
+    // Same epoch again: ordinary sequence tracking
+    send_epoch(2, 1, 48, 1);
+    CHECK_EQ(ps->seq_stale, 2);
+    CHECK_EQ(ps->seq_restarts, 1);
+
+    // A late datagram of the old run is stale: nothing released, and the
+    // new run's next datagram is no second restart
+    send_epoch(2, 2, 48, 1);
+    size_t reports = hid_port_host_report_count();
+    send_epoch(1, 6, 30, 0);
+    CHECK_EQ(ps->seq_stale, 3);
+    CHECK_EQ(ps->seq_restarts, 1);
+    CHECK_EQ(hid_port_host_report_count(), reports);
+    CHECK_EQ(last_report(HOST_REPORT_KEYBOARD)->kbd.keycode[0], HID_KEY_B);
+    send_epoch(2, 3, 30, 1);
+    CHECK_EQ(ps->seq_restarts, 1);
+    CHECK_EQ(ps->seq_lost, 0);
+    CHECK_EQ(last_report(HOST_REPORT_KEYBOARD)->kbd.keycode[0], HID_KEY_A);
+    CHECK_EQ(last_report(HOST_REPORT_KEYBOARD)->kbd.keycode[1], HID_KEY_B);
+}
+
+static void test_snapshot_resync(void) {
+    reset_core();
+    const uint16_t shift_a[] = {42, 30};
+    send_seq(1, 42, 1, NULL, 0);
+    hid_port_host_advance(2000);
+    send_seq(2, 30, 1, NULL, 0);
+    // seq 3 (release of A) is lost; the next snapshot only holds shift
+    hid_port_host_advance(2000);
+    const uint16_t shift[] = {42};
+    send_seq(4, 0, 0, shift, 1);
+    const parser_stats *ps = packet_parser_stats();
+    CHECK_EQ(ps->seq_lost, 1);
+    CHECK_EQ(ps->resyncs, 1);
+    const host_report *r = hid_port_host_report(hid_port_host_report_count() - 1);
+    CHECK_EQ(r->kind, HOST_REPORT_KEYBOARD);
+    CHECK_EQ(r->kbd.modifier, 1 << (HID_KEY_SHIFT_LEFT - HID_KEY_CONTROL_LEFT));
+    CHECK_EQ(r->kbd.keycode[0], 0);
+
+    // Matching snapshot: nothing to correct, nothing sent
+    size_t reports = hid_port_host_report_count();
+    hid_port_host_advance(2000);
+    send_seq(5, 0, 0, shift, 1);
+    CHECK_EQ(ps->resyncs, 1);
+    CHECK_EQ(hid_port_host_report_count(), reports);
+
+    // Lost press: the snapshot adds the key and a held button
+    hid_port_host_advance(2000);
+    const uint16_t with_button[] = {42, 30, 272};
+    send_seq(6, 0, 0, with_button, 3);
+    CHECK_EQ(ps->resyncs, 2);
+    r = hid_port_host_report(hid_port_host_report_count() - 2);
+    CHECK_EQ(r->kbd.keycode[0], HID_KEY_A);
+    r = hid_port_host_report(hid_port_host_report_count() - 1);
+    CHECK_EQ(r->kind, HOST_REPORT_MOUSE);
+    CHECK_EQ(r->mouse.buttons, 1);
+
+    // Empty snapshot releases everything
+    hid_port_host_advance(2000);
+    send_seq(7, 0, 0, shift_a, 0);
+    CHECK_EQ(ps->resyncs, 3);
+    r = hid_port_host_report(hid_port_host_report_count() - 2);
+    CHECK_EQ(r->kbd.modifier, 0);
+    CHECK_EQ(r->kbd.keycode[0], 0);
+    r = hid_port_host_report(hid_port_host_report_count() - 1);
+    CHECK_EQ(r->mouse.buttons, 0);
+}
+
+static void test_redundant_recovery(void) {
+    reset_core();
+    hp_history h = {0};
+    uint8_t buf[128];
+    hp_writer w;
+
+    // seq 1 presses A, seq 2 releases it, seq 3 presses S; 2 is lost
+    for (uint32_t seq = 1; seq <= 3; seq++) {
+        uint16_t code = seq == 3 ? 31 : 30;
+        bool pressed = seq != 2;
+        hp_writer_init_flags(&w, buf, sizeof(buf), HP_FLAG_SEQ);
+        hp_put_history(&w, &h, seq, 4);
+        hp_put_event(&w, HP_EV_KEY, code, pressed);
+        hp_history_add(&h, seq, code, pressed);
+        hp_writer_stamp(&w, seq, 0, 0);
+        hid_port_host_advance(2000);
+        if (seq != 2) process_packet((const char *)buf, (uint16_t)w.len);
+    }
+
+    // Only the release from seq 2 is replayed, the press from 1 is not
+    const parser_stats *ps = packet_parser_stats();
+    CHECK_EQ(ps->seq_lost, 1);
+    CHECK_EQ(ps->recovered, 1);
+    hid_port_host_advance(2000);
+    hid_send_report();
+    const host_report *r = hid_port_host_report(hid_port_host_report_count() - 1);
+    CHECK_EQ(r->kbd.keycode[0], HID_KEY_S);
+    CHECK_EQ(r->kbd.keycode[1], 0);
+}
+
+static void test_motion_split(void) {
+    // 200 counts used to wrap to -56 in the int8 cast
+    reset_core();
+    send_text("M,0,100;M,0,100;M,1,-300;");
+    CHECK_EQ(hid_port_host_report_count(), 3);
+    int x = 0, y = 0;
+    for (size_t i = 0; i < hid_port_host_report_count(); i++) {
+        const host_report *r = hid_port_host_report(i);
+        CHECK(r->mouse.x >= 0);
+        CHECK(r->mouse.y <= 0);
+        CHECK(r->mouse.x >= -127 && r->mouse.y >= -127);
+        x += r->mouse.x;
+        y += r->mouse.y;
+    }
+    CHECK_EQ(x, 200);
+    CHECK_EQ(y, -300);
+    CHECK(!hid_server_pending());
+
+    // Busy endpoint: the remainder waits for the next report-complete
+    reset_core();
+    hid_port_host_set_ready(ITF_MOUSE, false);
+    send_text("M,0,400;M,8,-2;");
+    CHECK_EQ(hid_port_host_report_count(), 0);
+    CHECK(hid_server_pending());
+    hid_port_host_set_ready(ITF_MOUSE, true);
+    hid_server_report_complete(ITF_MOUSE);
+    CHECK_EQ(hid_port_host_report_count(), 4);
+    CHECK_EQ(hid_port_host_report(0)->mouse.x, 127);
+    CHECK_EQ(hid_port_host_report(0)->mouse.vertical, -2);
+    CHECK_EQ(hid_port_host_report(3)->mouse.x, 400 - 3 * 127);
+    CHECK_EQ(hid_port_host_report(3)->mouse.vertical, 0);
+    CHECK(!hid_server_pending());
+
+    // Binary values beyond int8 are no longer truncated per record
+    reset_core();
+    uint8_t buf[32];
+    hp_writer w;
+    hp_writer_init(&w, buf, sizeof(buf));
+    hp_put_event(&w, HP_EV_REL, 0, 1000);
+    process_packet((const char *)buf, (uint16_t)w.len);
+    x = 0;
+    for (size_t i = 0; i < hid_port_host_report_count(); i++) x += hid_port_host_report(i)->mouse.x;
+    CHECK_EQ(x, 1000);
+}
+
+static void test_hires_mouse(void) {
+    // 16-bit layout: one report where the boot layout needs eight
+    reset_core();
+    hid_server_set_mouse_hires(true);
+    send_text("M,0,1000;M,1,-40000;M,6,1;");
+    CHECK_EQ(hid_port_host_report_count(), 2);
+    const host_report *r = hid_port_host_report(0);
+    CHECK(r->mouse.hires);
+    CHECK_EQ(r->mouse.x, 1000);
+    CHECK_EQ(r->mouse.y, -32767);
+    CHECK_EQ(r->mouse.horizontal, 1);    // REL_HWHEEL used to be dropped
+    CHECK_EQ(hid_port_host_report(1)->mouse.y, -40000 + 32767);
+    CHECK_EQ(hid_port_host_report(1)->mouse.horizontal, 0);
+
+    // Kernels send REL_WHEEL and REL_WHEEL_HI_RES for the same notch;
+    // without the host's multiplier only whole detents are reported
+    reset_core();
+    hid_server_set_mouse_hires(true);
+    send_text("M,8,1;M,11,60;");
+    CHECK_EQ(hid_port_host_report_count(), 0);
+    CHECK(!hid_server_pending());
+    send_text("M,8,1;M,11,60;");
+    CHECK_EQ(hid_port_host_report_count(), 1);
+    CHECK_EQ(hid_port_host_report(0)->mouse.vertical, 1);
+
+    // Multiplier enabled: hi-res units pass straight through
+    reset_core();
+    hid_server_set_mouse_hires(true);
+    hid_server_set_wheel_resolution(true, true);
+    send_text("M,11,-30;M,12,15;");
+    CHECK_EQ(hid_port_host_report_count(), 1);
+    CHECK_EQ(hid_port_host_report(0)->mouse.vertical, -30);
+    CHECK_EQ(hid_port_host_report(0)->mouse.horizontal, 15);
+
+    // Detent-only senders are scaled to the multiplier
+    send_text("M,8,2;");
+    CHECK_EQ(hid_port_host_report(1)->mouse.vertical, 2 * HID_WHEEL_UNIT);
+
+    // Host chose boot protocol (BIOS): 8-bit boot reports despite hi-res
+    reset_core();
+    hid_server_set_mouse_hires(true);
+    hid_server_set_wheel_resolution(true, true);
+    hid_server_set_mouse_boot_protocol(true);
+    send_text("M,0,300;M,11,120;");
+    CHECK_EQ(hid_port_host_report_count(), 3);
+    CHECK(!hid_port_host_report(0)->mouse.hires);
+    CHECK_EQ(hid_port_host_report(0)->mouse.x, 127);
+    CHECK_EQ(hid_port_host_report(0)->mouse.vertical, 1);
+    hid_server_set_mouse_boot_protocol(false);
+    send_text("M,0,1;");
+    CHECK(hid_port_host_report(3)->mouse.hires);
+
+    // Boot layout still reports detents, hi-res input included
+    reset_core();
+    send_text("M,11,240;M,12,-120;");
+    CHECK_EQ(hid_port_host_report_count(), 1);
+    CHECK(!hid_port_host_report(0)->mouse.hires);
+    CHECK_EQ(hid_port_host_report(0)->mouse.vertical, 2);
+    CHECK_EQ(hid_port_host_report(0)->mouse.horizontal, -1);
+}
+
+static void check_mouse(size_t i, uint8_t buttons, int x, int y) {
+    const host_report *r = hid_port_host_report(i);
+    CHECK_EQ(r->kind, HOST_REPORT_MOUSE);
+    CHECK_EQ(r->mouse.buttons, buttons);
+    CHECK_EQ(r->mouse.x, x);
+    CHECK_EQ(r->mouse.y, y);
+}
+
+static void test_mouse_builder(void) {
+    // Click and drag in one packet: motion is split only at the edges that
+    // need it, motion after a change rides in that change's report
+    reset_core();
+    send_text("M,0,5;M,272,1;M,0,10;M,1,4;M,272,0;M,0,3;");
+    CHECK_EQ(hid_port_host_report_count(), 3);
+    check_mouse(0, 0, 5, 0);
+    check_mouse(1, 1, 10, 4);
+    check_mouse(2, 0, 3, 0);
+
+    // Two buttons pressed together: one report
+    reset_core();
+    send_text("M,272,1;M,273,1;M,0,2;");
+    CHECK_EQ(hid_port_host_report_count(), 1);
+    check_mouse(0, 3, 2, 0);
+
+    // A click inside one packet while the endpoint is busy is not lost
+    reset_core();
+    hid_port_host_set_ready(ITF_MOUSE, false);
+    send_text("M,272,1;M,272,0;");
+    CHECK_EQ(hid_port_host_report_count(), 0);
+    hid_port_host_set_ready(ITF_MOUSE, true);
+    hid_server_report_complete(ITF_MOUSE);
+    CHECK_EQ(hid_port_host_report_count(), 2);
+    check_mouse(0, 1, 0, 0);
+    check_mouse(1, 0, 0, 0);
+    CHECK(!hid_server_pending());
+
+    // 1 ms polling: one report per frame, in order, motion conserved
+    reset_core();
+    hid_port_host_usb_poll(1);
+    send_text("M,0,1;M,272,1;M,0,2;M,272,0;M,272,1;M,0,4;M,272,0;");
+    send_text("M,0,8;");
+    for (int i = 0; i < 6; i++) hid_port_host_frame();
+    CHECK_EQ(hid_port_host_report_count(), 5);
+    check_mouse(0, 0, 1, 0);
+    check_mouse(1, 1, 2, 0);
+    check_mouse(2, 0, 0, 0);
+    check_mouse(3, 1, 4, 0);
+    check_mouse(4, 0, 8, 0);
+    CHECK(!hid_server_pending());
+
+    // Sub-detent wheel carried across a click still adds up to a detent
+    reset_core();
+    send_text("M,11,60;M,272,1;M,272,0;M,11,60;");
+    int32_t wheel = 0;
+    for (size_t i = 0; i < hid_port_host_report_count(); i++) wheel += hid_port_host_report(i)->mouse.vertical;
+    CHECK_EQ(wheel, 1);
+
+    // Full queue: further changes merge into the newest entry, state stays right
+    reset_core();
+    hid_port_host_set_ready(ITF_MOUSE, false);
+    for (int i = 0; i < 20; i++) send_text("M,272,1;M,272,0;");
+    send_text("M,273,1;");
+    hid_server_stats hs;
+    hid_server_get_stats(&hs);
+    CHECK(hs.mouse_merged > 0);
+    hid_port_host_set_ready(ITF_MOUSE, true);
+    hid_server_service();
+    CHECK_EQ(hid_port_host_report(hid_port_host_report_count() - 1)->mouse.buttons, 2);
+    CHECK(!hid_server_pending());
+}
+
+// Keys 30..33 held according to the last delivered keyboard report
+static unsigned delivered_keys(void) {
+    for (size_t i = hid_port_host_report_count(); i > 0; i--) {
+        const host_report *r = hid_port_host_report(i - 1);
+        if (r->kind != HOST_REPORT_KEYBOARD || !r->delivered_us) continue;
+        unsigned mask = 0;
+        for (int k = 0; k < 6; k++) {
+            for (int t = 0; t < 4; t++) {
+                if (r->kbd.keycode[k] && r->kbd.keycode[k] == keymap_linux_to_hid(30 + t))
+                    mask |= 1u << t;
+            }
+        }
+        return mask;
+    }
+    return 0;
+}
+
+static void test_frame_scheduler(void) {
+    // 1 ms polling: events land anywhere inside a frame, the host reads at
+    // most one report per interface per frame
+    reset_core();
+    hid_port_host_usb_poll(1);
+    uint32_t rng = 12345;
+    unsigned held = 0;
+    int32_t moved = 0;
+    int stale = 0;
+
+    for (int frame = 0; frame < 600; frame++) {
+        uint64_t start = hid_port_time_us();
+        if (frame % 4 == 0) {
+            for (int e = 0; e < 3; e++) {
+                rng = rng * 1103515245u + 12345u;
+                hid_port_host_set_time(start + e * 300 + (rng >> 8) % 300);
+                int t = (int)((rng >> 20) & 3);
+                char msg[32];
+                snprintf(msg, sizeof(msg), "K,%d,%d;M,0,%d;", 30 + t, !(held & (1u << t)), e + 1);
+                send_text(msg);
+                held ^= 1u << t;
+                moved += e + 1;
+            }
+        } else if (frame % 4 == 3 && delivered_keys() != held) {
+            stale++;   // one frame per queued state must be enough to catch up
+        }
+        hid_port_host_frame();
+    }
+    for (int i = 0; i < 3; i++) hid_port_host_frame();
+
+    CHECK_EQ(stale, 0);
+    CHECK_EQ(delivered_keys(), held);
+    CHECK(!hid_server_pending());
+
+    uint64_t last[2] = {0, 0};
+    const host_report *prev_kbd = NULL;
+    int32_t delivered_dx = 0;
+    bool all_delivered = true, one_per_frame = true, duplicate = false;
+    for (size_t i = 0; i < hid_port_host_report_count(); i++) {
+        const host_report *r = hid_port_host_report(i);
+        all_delivered &= r->delivered_us != 0;
+        one_per_frame &= r->delivered_us > last[r->itf];
+        last[r->itf] = r->delivered_us;
+        if (r->kind == HOST_REPORT_MOUSE) {
+            delivered_dx += r->mouse.x;
+        } else {
+            if (prev_kbd && !memcmp(&prev_kbd->kbd, &r->kbd, sizeof(r->kbd))) duplicate = true;
+            prev_kbd = r;
+        }
+    }
+    CHECK(all_delivered);
+    CHECK(one_per_frame);
+    CHECK(!duplicate);
+    CHECK_EQ(delivered_dx, moved);
+
+    // Continuous motion keeps the mouse endpoint busy every frame: 1000 Hz
+    reset_core();
+    hid_port_host_usb_poll(1);
+    for (int frame = 0; frame < 100; frame++) {
+        hid_port_host_advance(300);
+        send_text("M,0,1;");
+        hid_port_host_advance(300);
+        send_text("M,0,1;");
+        hid_port_host_frame();
+    }
+    hid_port_host_frame();
+    CHECK_EQ(hid_port_host_report_count(), 101);
+    CHECK(!hid_server_pending());
+}
+
+typedef struct {
+    uint8_t code;      // HID usage
+    bool pressed;
+} transition;
+
+// Held usages of a keyboard report as a bitmap, modifiers included
+static void report_bits(const host_report *r, uint8_t bits[NKRO_REPORT_LEN]) {
+    memset(bits, 0, NKRO_REPORT_LEN);
+    if (r->kind == HOST_REPORT_NKRO) {
+        memcpy(bits, r->nkro.bits, NKRO_REPORT_LEN);
+        return;
+    }
+    bits[HID_KEY_CONTROL_LEFT / 8] = r->kbd.modifier;
+    for (int k = 0; k < 6; k++) bits[r->kbd.keycode[k] / 8] |= (uint8_t)(1u << (r->kbd.keycode[k] % 8));
+    bits[0] &= (uint8_t)~1u;   // HID_KEY_NONE
+}
+
+// Rebuilds the transition sequence the host saw from consecutive keyboard
+// reports. Returns -1 if a report carried more than one transition.
+static int replay_reports(transition *out, int cap) {
+    uint8_t prev[NKRO_REPORT_LEN] = {0};
+    int n = 0;
+    for (size_t i = 0; i < hid_port_host_report_count(); i++) {
+        const host_report *r = hid_port_host_report(i);
+        if (r->kind == HOST_REPORT_MOUSE || !r->delivered_us) continue;
+        uint8_t bits[NKRO_REPORT_LEN];
+        report_bits(r, bits);
+        int changes = 0;
+        for (int u = 0; u < NKRO_USAGE_COUNT; u++) {
+            bool was = prev[u / 8] & (1u << (u % 8)), is = bits[u / 8] & (1u << (u % 8));
+            if (was == is) continue;
+            if (n < cap) out[n++] = (transition){(uint8_t)u, is};
+            changes++;
+        }
+        if (changes != 1) return -1;
+        memcpy(prev, bits, NKRO_REPORT_LEN);
+    }
+    return n;
+}
+
+// Moves the clock forward, running every USB frame boundary crossed
+static void advance_frames(uint64_t us) {
+    uint64_t end = hid_port_time_us() + us;
+    while ((hid_port_time_us() / HOST_FRAME_US + 1) * HOST_FRAME_US <= end) hid_port_host_frame();
+    hid_port_host_set_time(end);
+}
+
+static void test_keyboard_replay(void) {
+    // "Hello world" macro: 24 transitions in one datagram, then the same
+    // again typed at 700 µs per transition, faster than the endpoint polls
+    static const uint16_t macro[] = {42, 35, 42, 18, 38, 38, 24, 57, 17, 24, 19, 38, 32};
+    transition expected[128];
+    int nexp = 0;
+
+    reset_core();
+    hid_port_host_usb_poll(1);
+
+    uint8_t buf[256];
+    hp_writer w;
+    hp_writer_init(&w, buf, sizeof(buf));
+    for (size_t i = 0; i < sizeof(macro) / sizeof(macro[0]); i++) {
+        bool shift = macro[i] == 42;
+        // Shift is held across the next key, everything else is a tap
+        bool pressed = shift ? (i == 0) : true;
+        hp_put_event(&w, HP_EV_KEY, macro[i], pressed);
+        expected[nexp++] = (transition){keymap_linux_to_hid((uint8_t)macro[i]), pressed};
+        if (!shift) {
+            hp_put_event(&w, HP_EV_KEY, macro[i], 0);
+            expected[nexp++] = (transition){keymap_linux_to_hid((uint8_t)macro[i]), false};
+        }
+    }
+    process_packet((const char *)buf, (uint16_t)w.len);
+    int burst = nexp;
+
+    for (int i = 0; i < 64 && hid_server_pending(); i++) hid_port_host_frame();
+
+    for (int i = 0; i < burst; i++) {
+        advance_frames(700);
+        char msg[16];
+        uint8_t linux_code = 0;
+        for (int c = 0; c < 256 && !linux_code; c++) {
+            if (c && keymap_linux_to_hid((uint8_t)c) == expected[i].code) linux_code = (uint8_t)c;
+        }
+        snprintf(msg, sizeof(msg), "K,%d,%d;", linux_code, expected[i].pressed);
+        send_text(msg);
+        expected[nexp++] = expected[i];
+    }
+    for (int i = 0; i < 64 && hid_server_pending(); i++) hid_port_host_frame();
+    hid_port_host_frame();
+
+    transition seen[128];
+    int nseen = replay_reports(seen, 128);
+    CHECK_EQ(nseen, nexp);
+    CHECK(nseen == nexp && !memcmp(seen, expected, sizeof(transition) * (size_t)nexp));
+    CHECK_EQ(hid_server_keyboard_overwritten(), 0);
+
+    // A burst beyond the queue still ends in the right state
+    reset_core();
+    hid_port_host_usb_poll(1);
+    hp_writer_init(&w, buf, sizeof(buf));
+    for (int i = 0; i < 40; i++) {
+        hp_put_event(&w, HP_EV_KEY, 30, 1);
+        hp_put_event(&w, HP_EV_KEY, 30, 0);
+    }
+    hp_put_event(&w, HP_EV_KEY, 31, 1);
+    process_packet((const char *)buf, (uint16_t)w.len);
+    CHECK(hid_server_keyboard_overwritten() > 0);
+    for (int i = 0; i < 64 && hid_server_pending(); i++) hid_port_host_frame();
+    hid_port_host_frame();
+    const host_report *last = hid_port_host_report(hid_port_host_report_count() - 1);
+    CHECK_EQ(last->kbd.keycode[0], HID_KEY_S);
+    CHECK_EQ(last->kbd.keycode[1], 0);
+}
+
+static void test_nkro(void) {
+    // Ten keys at once: all of them in the bitmap, nothing on the boot itf
+    reset_core();
+    hid_server_set_nkro(true);
+    static const uint8_t keys[] = {30, 31, 32, 33, 34, 35, 36, 37, 38, 42};
+    for (size_t i = 0; i < sizeof(keys); i++) {
+        char msg[16];
+        snprintf(msg, sizeof(msg), "K,%d,1;", keys[i]);
+        send_text(msg);
+    }
+    CHECK_EQ(hid_port_host_report_count(), sizeof(keys));
+    const host_report *r = hid_port_host_report(hid_port_host_report_count() - 1);
+    CHECK_EQ(r->kind, HOST_REPORT_NKRO);
+    CHECK_EQ(r->itf, ITF_NKRO);
+    int held = 0;
+    for (int u = 0; u < NKRO_USAGE_COUNT; u++) held += (r->nkro.bits[u / 8] >> (u % 8)) & 1;
+    CHECK_EQ(held, (int)sizeof(keys));
+    CHECK(r->nkro.bits[HID_KEY_SHIFT_LEFT / 8] & (1u << (HID_KEY_SHIFT_LEFT % 8)));
+
+    // BIOS selected boot protocol: 6KRO with ErrorRollOver beyond six keys
+    hid_server_set_boot_protocol(true);
+    send_text("K,30,0;");
+    r = hid_port_host_report(hid_port_host_report_count() - 1);
+    CHECK_EQ(r->kind, HOST_REPORT_KEYBOARD);
+    CHECK_EQ(r->kbd.modifier, 1 << (HID_KEY_SHIFT_LEFT - HID_KEY_CONTROL_LEFT));
+    CHECK_EQ(r->kbd.keycode[0], HID_KEY_ERROR_ROLLOVER);
+    CHECK_EQ(r->kbd.keycode[5], HID_KEY_ERROR_ROLLOVER);
+
+    static const uint8_t release[] = {31, 32, 33, 34, 35};
+    for (size_t i = 0; i < sizeof(release); i++) {
+        char msg[16];
+        snprintf(msg, sizeof(msg), "K,%d,0;", release[i]);
+        send_text(msg);
+    }
+    r = hid_port_host_report(hid_port_host_report_count() - 1);
+    CHECK_EQ(r->kbd.keycode[0], HID_KEY_J);
+    CHECK_EQ(r->kbd.keycode[1], HID_KEY_K);
+    CHECK_EQ(r->kbd.keycode[2], HID_KEY_L);
+    CHECK_EQ(r->kbd.keycode[3], 0);
+
+    // Snapshot on the NKRO path: one straight bitmap, more than six keys
+    reset_core();
+    hid_server_set_nkro(true);
+    const uint8_t snap[] = {HID_KEY_A, HID_KEY_B, HID_KEY_C, HID_KEY_D, HID_KEY_E,
+                            HID_KEY_F, HID_KEY_G, HID_KEY_CONTROL_LEFT};
+    CHECK(hid_server_sync_state(snap, sizeof(snap), 0));
+    CHECK_EQ(hid_port_host_report_count(), 1);
+    r = hid_port_host_report(0);
+    CHECK_EQ(r->nkro.bits[0], 0xF0);   // A-D
+    CHECK_EQ(r->nkro.bits[1], 0x07);   // E-G
+    CHECK_EQ(r->nkro.bits[HID_KEY_CONTROL_LEFT / 8], 0x01);
+    CHECK(!hid_server_sync_state(snap, sizeof(snap), 0));
+}
+
+// Keys set in an NKRO report, modifiers included
+static int nkro_held(const host_report *r) {
+    int held = 0;
+    for (int u = 0; u < NKRO_USAGE_COUNT; u++) held += (r->nkro.bits[u / 8] >> (u % 8)) & 1;
+    return held;
+}
+
+// Partial snapshot with the sender's full state in one datagram; seq > 1
+static void send_partial(uint32_t seq, const uint16_t *held, size_t nheld) {
+    uint8_t buf[256];
+    hp_writer w;
+    hp_writer_init_flags(&w, buf, sizeof(buf), HP_FLAG_SEQ);
+    CHECK(hp_put_partial_state(&w, held, nheld));
+    hp_writer_stamp(&w, seq, 0, 0);
+    process_packet((const char *)buf, (uint16_t)w.len);
+}
+
+static void test_partial_snapshot(void) {
+    // 40 keys held (Linux 2..41): more than a snapshot can list
+    reset_core();
+    hid_server_set_nkro(true);
+    uint8_t buf[512];
+    hp_writer w;
+    hp_writer_init_flags(&w, buf, sizeof(buf), HP_FLAG_SEQ);
+    for (uint16_t code = 2; code < 42; code++) hp_put_event(&w, HP_EV_KEY, code, 1);
+    hp_writer_stamp(&w, 1, 0, 0);
+    process_packet((const char *)buf, (uint16_t)w.len);
+    CHECK_EQ(nkro_held(last_report(HOST_REPORT_NKRO)), 40);
+
+    // The first 32 of them, marked partial: the other 8 stay down
+    uint16_t listed[HP_MAX_STATE_CODES];
+    for (size_t i = 0; i < HP_MAX_STATE_CODES; i++) listed[i] = (uint16_t)(2 + i);
+    size_t reports = hid_port_host_report_count();
+    send_partial(2, listed, HP_MAX_STATE_CODES);
+    const parser_stats *ps = packet_parser_stats();
+    CHECK_EQ(ps->resyncs, 0);
+    CHECK_EQ(hid_port_host_report_count(), reports);
+
+    // A lost press shows up in a partial snapshot: added, nothing released
+    listed[HP_MAX_STATE_CODES - 1] = 44;   // Z
+    send_partial(3, listed, HP_MAX_STATE_CODES);
+    CHECK_EQ(ps->resyncs, 1);
+    const host_report *r = last_report(HOST_REPORT_NKRO);
+    CHECK_EQ(nkro_held(r), 41);
+    CHECK(r->nkro.bits[HID_KEY_Z / 8] & (1u << (HID_KEY_Z % 8)));
+
+    // A full snapshot still replaces the state
+    const uint16_t z[] = {44};
+    send_seq(4, 0, 0, z, 1);
+    CHECK_EQ(ps->resyncs, 2);
+    r = last_report(HOST_REPORT_NKRO);
+    CHECK_EQ(nkro_held(r), 1);
+    CHECK(r->nkro.bits[HID_KEY_Z / 8] & (1u << (HID_KEY_Z % 8)));
+}
+
+static void test_consumer(void) {
+    // Volume up (KEY_VOLUMEUP 115): press and release on the consumer itf,
+    // nothing on the keyboard
+    reset_core();
+    send_text("K,115,1;");
+    CHECK_EQ(hid_port_host_report_count(), 1);
+    const host_report *r = hid_port_host_report(0);
+    CHECK_EQ(r->kind, HOST_REPORT_CONSUMER);
+    CHECK_EQ(r->itf, ITF_CONSUMER);
+    CHECK_EQ(r->consumer.usages[0], 0xE9);
+    CHECK_EQ(r->consumer.usages[1], 0);
+
+    // Mute held with it, then volume released: remaining usage moves up
+    send_text("K,113,1;K,115,0;");
+    CHECK_EQ(hid_port_host_report_count(), 3);
+    r = hid_port_host_report(2);
+    CHECK_EQ(r->consumer.usages[0], 0xE2);
+    CHECK_EQ(r->consumer.usages[1], 0);
+
+    // Repeated presses of a held key send nothing
+    send_text("K,113,1;K,113,1;");
+    CHECK_EQ(hid_port_host_report_count(), 3);
+    send_text("K,113,0;");
+    r = hid_port_host_report(3);
+    CHECK_EQ(r->consumer.usages[0], 0);
+
+    // A tap inside one poll interval is queued, not coalesced away
+    reset_core();
+    hid_port_host_usb_poll(1);
+    send_text("K,164,1;K,164,0;");   // KEY_PLAYPAUSE
+    advance_frames(3 * HOST_FRAME_US);
+    CHECK_EQ(hid_port_host_report_count(), 2);
+    CHECK_EQ(hid_port_host_report(0)->consumer.usages[0], 0xCD);
+    CHECK_EQ(hid_port_host_report(1)->consumer.usages[0], 0);
+    CHECK(hid_port_host_report(1)->delivered_us > hid_port_host_report(0)->delivered_us);
+    CHECK(!hid_server_pending());
+    hid_port_host_usb_poll(0);
+
+    // Lost release: the next snapshot frees the stuck media key
+    reset_core();
+    send_seq(1, 114, 1, NULL, 0);    // KEY_VOLUMEDOWN
+    const uint16_t none[] = {0};
+    send_seq(3, 0, 0, none, 0);
+    r = hid_port_host_report(hid_port_host_report_count() - 1);
+    CHECK_EQ(r->kind, HOST_REPORT_CONSUMER);
+    CHECK_EQ(r->consumer.usages[0], 0);
+    CHECK_EQ(packet_parser_stats()->resyncs, 1);
+
+    // Held in the snapshot: kept, no extra report
+    send_seq(4, 114, 1, NULL, 0);
+    size_t n = hid_port_host_report_count();
+    const uint16_t held[] = {114};
+    send_seq(5, 0, 0, held, 1);
+    CHECK_EQ(hid_port_host_report_count(), n);
+}
+
+static void send_from(const packet_sender *from, const char *s) {
+    process_packet_from(from, s, (uint16_t)strlen(s));
+}
+
+static void test_sessions(void) {
+    // Keyboard Pi and mouse Pi: keys and buttons are merged, and one
+    // sender's release does not cancel the other's key
+    reset_core();
+    const packet_sender kbd = {0x0A00000A, 40001}, mouse = {0x0B00000A, 40001};
+    send_from(&kbd, "K,42,1;K,30,1;");
+    send_from(&mouse, "K,42,1;M,272,1;");
+    send_from(&kbd, "K,42,0;");
+    const host_report *r = last_report(HOST_REPORT_KEYBOARD);
+    CHECK_EQ(r->kbd.modifier, 1 << (HID_KEY_SHIFT_LEFT - HID_KEY_CONTROL_LEFT));
+    CHECK_EQ(r->kbd.keycode[0], HID_KEY_A);
+    CHECK_EQ(last_report(HOST_REPORT_MOUSE)->mouse.buttons, 1);
+    send_from(&mouse, "K,42,0;M,272,0;");
+    r = last_report(HOST_REPORT_KEYBOARD);
+    CHECK_EQ(r->kbd.modifier, 0);
+    CHECK_EQ(r->kbd.keycode[0], HID_KEY_A);
+    CHECK_EQ(last_report(HOST_REPORT_MOUSE)->mouse.buttons, 0);
+
+    // Separate sequence numbers: the second sender starting low is not stale
+    reset_core();
+    uint8_t buf[32];
+    hp_writer w;
+    hp_writer_init_flags(&w, buf, sizeof(buf), HP_FLAG_SEQ);
+    hp_put_event(&w, HP_EV_KEY, 30, 1);
+    hp_writer_stamp(&w, 500, 0, 0);
+    process_packet_from(&kbd, (const char *)buf, (uint16_t)w.len);
+    hp_writer_init_flags(&w, buf, sizeof(buf), HP_FLAG_SEQ);
+    hp_put_event(&w, HP_EV_KEY, 48, 1);
+    hp_writer_stamp(&w, 1, 0, 0);
+    process_packet_from(&mouse, (const char *)buf, (uint16_t)w.len);
+    CHECK_EQ(packet_parser_stats()->seq_stale, 0);
+    CHECK_EQ(packet_parser_stats()->seq_lost, 0);
+    CHECK_EQ(last_report(HOST_REPORT_KEYBOARD)->kbd.keycode[1], HID_KEY_B);
+
+    // An empty snapshot from one sender only clears its own keys
+    const uint16_t none[] = {0};
+    hp_writer_init_flags(&w, buf, sizeof(buf), HP_FLAG_SEQ);
+    hp_put_state(&w, none, 0);
+    hp_writer_stamp(&w, 2, 0, 0);
+    process_packet_from(&mouse, (const char *)buf, (uint16_t)w.len);
+    r = last_report(HOST_REPORT_KEYBOARD);
+    CHECK_EQ(r->kbd.keycode[0], HID_KEY_A);
+    CHECK_EQ(r->kbd.keycode[1], 0);
+
+    // Idle sender expires and its keys are released
+    hid_port_host_advance(PARSER_SESSION_IDLE_US / 2);
+    send_from(&mouse, "K,48,1;");
+    hid_port_host_advance(PARSER_SESSION_IDLE_US / 2 + 1000);
+    packet_parser_expire(hid_port_time_us());
+    CHECK_EQ(packet_parser_stats()->sessions_expired, 1);
+    r = last_report(HOST_REPORT_KEYBOARD);
+    CHECK_EQ(r->kbd.keycode[0], HID_KEY_B);
+    CHECK_EQ(r->kbd.keycode[1], 0);
+
+    // A text sender has no snapshots to resend: a key held in silence for
+    // longer than the idle timeout stays down, and the session stays open
+    reset_core();
+    send_from(&kbd, "K,17,1;K,30,1;K,30,0;");
+    size_t reports = hid_port_host_report_count();
+    hid_port_host_advance(PARSER_SESSION_IDLE_US + 1000000);
+    packet_parser_expire(hid_port_time_us());
+    CHECK_EQ(packet_parser_stats()->sessions_expired, 0);
+    CHECK_EQ(hid_port_host_report_count(), reports);
+    CHECK_EQ(last_report(HOST_REPORT_KEYBOARD)->kbd.keycode[0], HID_KEY_W);
+    CHECK_EQ(packet_parser_sessions(), 1);
+
+    // Once it holds nothing, its idle session is closed
+    send_from(&kbd, "K,17,0;");
+    hid_port_host_advance(PARSER_SESSION_IDLE_US + 1000);
+    packet_parser_expire(hid_port_time_us());
+    CHECK_EQ(packet_parser_stats()->sessions_expired, 1);
+    CHECK_EQ(packet_parser_sessions(), 0);
+
+    // Full table: a new sender replaces the least recently heard one
+    reset_core();
+    for (int i = 0; i < HID_SESSIONS; i++) {
+        packet_sender s = {0x0A00000A, (uint16_t)(40000 + i)};
+        hid_port_host_advance(1000);
+        send_from(&s, i == 0 ? "K,30,1;" : "K,48,1;");
+    }
+    packet_sender late = {0x0C00000A, 40000};
+    hid_port_host_advance(1000);
+    send_from(&late, "K,46,1;");
+    CHECK_EQ(packet_parser_stats()->sessions_opened, HID_SESSIONS + 1);
+    CHECK_EQ(packet_parser_stats()->sessions_evicted, 1);
+    r = last_report(HOST_REPORT_KEYBOARD);
+    CHECK_EQ(r->kbd.keycode[0], HID_KEY_B);
+    CHECK_EQ(r->kbd.keycode[1], HID_KEY_C);
+    CHECK_EQ(r->kbd.keycode[2], 0);
+}
+
+// Mixed traffic from two senders: typing, a lost release healed by a
+// snapshot, clicks with motion, then one sender going idle
+static void run_split_script(bool split) {
+    reset_core();
+    event_ring_reset();
+    packet_parser_set_split(split);
+    const packet_sender other = {0x0B00000A, 40001};
+    const uint16_t shift[] = {42};
+
+    send_seq(1, 42, 1, NULL, 0);
+    send_seq(2, 30, 1, NULL, 0);
+    send_seq(4, 0, 0, shift, 1);                        // release of A lost
+    send_from(&other, "M,0,5;M,272,1;M,1,-3;M,272,0;");
+    uint8_t buf[32];
+    hp_writer w;
+    hp_writer_init_flags(&w, buf, sizeof(buf), HP_FLAG_SEQ);   // resyncs: may expire
+    hp_put_event(&w, HP_EV_KEY, 115, 1);
+    hp_writer_stamp(&w, 1, 0, 0);
+    process_packet_from(&other, (const char *)buf, (uint16_t)w.len);
+    hid_port_host_advance(PARSER_SESSION_IDLE_US / 2);
+    send_seq(5, 48, 1, NULL, 0);
+    hid_port_host_advance(PARSER_SESSION_IDLE_US / 2 + 1000);
+    packet_parser_expire(hid_port_time_us());          // other: volume up released
+    if (split) {
+        CHECK_EQ(hid_port_host_report_count(), 0);
+        packet_parser_apply_events();
+        CHECK_EQ(event_ring_depth(), 0);
+    }
+}
+
+static void test_split_pipeline(void) {
+    // Decoded on one side, applied on the other: same reports as direct mode
+    host_report direct[32];
+    run_split_script(false);
+    size_t n = hid_port_host_report_count();
+    CHECK(n > 0 && n <= 32);
+    for (size_t i = 0; i < n && i < 32; i++) direct[i] = *hid_port_host_report(i);
+    uint32_t resyncs = packet_parser_stats()->resyncs;
+
+    pipeline_stats_reset();
+    run_split_script(true);
+    CHECK_EQ(hid_port_host_report_count(), n);
+    bool same = true;
+    for (size_t i = 0; i < n && i < 32 && i < hid_port_host_report_count(); i++) {
+        const host_report *r = hid_port_host_report(i), *d = &direct[i];
+        same &= r->kind == d->kind;
+        if (r->kind == HOST_REPORT_MOUSE) {
+            same &= r->mouse.buttons == d->mouse.buttons && r->mouse.x == d->mouse.x &&
+                    r->mouse.y == d->mouse.y && r->mouse.vertical == d->mouse.vertical;
+        } else if (r->kind == HOST_REPORT_KEYBOARD) {
+            same &= !memcmp(&r->kbd, &d->kbd, sizeof(r->kbd));
+        } else if (r->kind == HOST_REPORT_CONSUMER) {
+            same &= !memcmp(r->consumer.usages, d->consumer.usages, sizeof(r->consumer.usages));
+        }
+    }
+    CHECK(same);
+    CHECK_EQ(packet_parser_stats()->resyncs, resyncs);
+    CHECK_EQ(pipeline_stage_hist(HS_STAGE_APPLY)->count, 6);
+
+    event_ring_stats es;
+    event_ring_get_stats(&es);
+    CHECK(es.pushed > 0);
+    CHECK_EQ(es.full_waits, 0);
+    packet_parser_reset();
+}
+
+static void test_pipeline_stages(void) {
+    reset_core();
+    pipeline_stats_reset();
+
+    uint8_t buf[32];
+    hp_writer w;
+    hp_writer_init_flags(&w, buf, sizeof(buf), HP_FLAG_SEQ | HP_FLAG_TIME);
+    hp_put_event(&w, HP_EV_REL, 0, 5);
+
+    // Two datagrams, the second delayed 300 µs more on the network
+    for (int i = 0; i < 2; i++) {
+        uint32_t rx = 1000000 + i * 10000;
+        hp_writer_stamp(&w, i, 5000 + i * 10000 - i * 300, 40);
+        hid_port_host_set_time(rx + 20);            // dequeued 20 µs later
+        pipeline_packet_begin(rx);
+        hid_port_host_advance(5);
+        process_packet((const char *)buf, (uint16_t)w.len);
+        pipeline_packet_end();
+        hid_port_host_advance(1000);                // host polls 1 ms later
+        hid_server_report_complete(ITF_MOUSE);
+        hid_server_report_complete(ITF_MOUSE);      // nothing pending: ignored
+    }
+
+    const latency_hist *h = pipeline_stage_hist(HS_STAGE_QUEUE);
+    CHECK_EQ(h->count, 2); CHECK_EQ(h->max_us, 20);
+    h = pipeline_stage_hist(HS_STAGE_PARSE);
+    CHECK_EQ(h->count, 2); CHECK_EQ(h->max_us, 5);
+    h = pipeline_stage_hist(HS_STAGE_CLIENT);
+    CHECK_EQ(h->count, 2); CHECK_EQ(h->min_us, 40);
+    h = pipeline_stage_hist(HS_STAGE_NETWORK);
+    CHECK_EQ(h->count, 2); CHECK_EQ(h->min_us, 0); CHECK_EQ(h->max_us, 300);
+    h = pipeline_stage_hist(HS_STAGE_USB);
+    CHECK_EQ(h->count, 2); CHECK_EQ(h->max_us, 1000);
+    h = pipeline_stage_hist(HS_STAGE_TOTAL);
+    CHECK_EQ(h->count, 2); CHECK_EQ(h->max_us, 1025);
+
+    // Serialized snapshot decodes back to the same numbers
+    uint8_t reply[HS_MAX_REPLY];
+    hs_writer sw;
+    hs_writer_init(&sw, reply, sizeof(reply));
+    pipeline_stats_write(&sw);
+    size_t len = hs_writer_finish(&sw);
+    CHECK(len > 0);
+    hs_reader r, sec;
+    uint8_t id;
+    hs_latency lat;
+    int stages = 0;
+    CHECK_EQ(hs_reader_init(&r, reply, len), 0);
+    CHECK_EQ(hs_next_section(&r, &id, &sec), 1);
+    CHECK_EQ(id, HS_SEC_LATENCY);
+    while (hs_next_latency(&sec, &lat) == 1) {
+        if (lat.stage == HS_STAGE_TOTAL) CHECK_EQ(lat.sum_us, 2 * 1025);
+        stages++;
+    }
+    CHECK_EQ(stages, HS_STAGE_COUNT);
+
+    // Each side clears only the stages it records
+    pipeline_stats_request_reset();
+    CHECK_EQ(pipeline_stage_hist(HS_STAGE_TOTAL)->count, 2);
+    pipeline_stats_service_hid();
+    CHECK_EQ(pipeline_stage_hist(HS_STAGE_TOTAL)->count, 0);
+    CHECK_EQ(pipeline_stage_hist(HS_STAGE_USB)->count, 0);
+    CHECK_EQ(pipeline_stage_hist(HS_STAGE_QUEUE)->count, 2);
+    pipeline_stats_service_parser();
+    CHECK_EQ(pipeline_stage_hist(HS_STAGE_QUEUE)->count, 0);
+    CHECK_EQ(pipeline_stage_hist(HS_STAGE_NETWORK)->count, 0);
+
+    // A loop running both sides applies both halves
+    pipeline_packet_begin(1000000);
+    pipeline_stats_request_reset();
+    pipeline_stats_service();
+    CHECK_EQ(pipeline_stage_hist(HS_STAGE_QUEUE)->count, 0);
+}
+
+static void test_telemetry(void) {
+    reset_core();
+    packet_queue_reset();
+    enqueue_packet("K,30,1;", 7);
+    const Packet *pkt = packet_queue_peek();
+    process_packet_from(&pkt->from, pkt->data, pkt->len);
+    packet_queue_release();
+    send_text("K,30,0;Garbage");
+
+    // A report waiting on a busy endpoint is one stall, however often retried
+    hid_port_host_set_ready(ITF_KEYBOARD, false);
+    send_text("K,31,1;");
+    hid_server_service();
+    hid_server_service();
+    hid_port_host_set_ready(ITF_KEYBOARD, true);
+    hid_server_service();
+
+    uint8_t reply[HS_MAX_REPLY];
+    hs_writer w;
+    hs_writer_init(&w, reply, sizeof(reply));
+    telemetry_link link = {5, -58};
+    telemetry_write(&w, &link);
+    size_t len = hs_writer_finish(&w);
+    CHECK(len > 0);
+
+    uint32_t ctr[HS_CTR_COUNT];
+    memset(ctr, 0xFF, sizeof(ctr));
+    hs_reader r, sec;
+    uint8_t id;
+    bool have_latency = false;
+    CHECK_EQ(hs_reader_init(&r, reply, len), 0);
+    while (hs_next_section(&r, &id, &sec) == 1) {
+        have_latency |= id == HS_SEC_LATENCY;
+        if (id != HS_SEC_COUNTERS) continue;
+        uint8_t c;
+        uint32_t v;
+        while (hs_next_counter(&sec, &c, &v) == 1) {
+            if (c < HS_CTR_COUNT) ctr[c] = v;
+        }
+    }
+    CHECK(have_latency);
+    CHECK_EQ(ctr[HS_CTR_UDP_RX], 5);
+    CHECK_EQ(ctr[HS_CTR_PACKETS], 3);
+    CHECK_EQ(ctr[HS_CTR_QUEUE_HIGH], 1);
+    CHECK_EQ(ctr[HS_CTR_QUEUE_DEPTH], 0);
+    CHECK_EQ(ctr[HS_CTR_QUEUE_BYTES], 0);
+    CHECK_EQ(ctr[HS_CTR_QUEUE_BYTES_HIGH], packet_queue_record_size(7));
+    CHECK_EQ(ctr[HS_CTR_PARSE_ERRORS], 0);   // text parser skips unknown commands
+    CHECK_EQ(ctr[HS_CTR_REPORTS_SENT], 3);
+    CHECK_EQ(ctr[HS_CTR_READY_STALLS], 1);
+    CHECK_EQ(ctr[HS_CTR_SESSIONS], 1);
+    CHECK_EQ((int32_t)ctr[HS_CTR_RSSI], -58);
+}
+
+void test_core(void) {
+    test_text_keyboard();
+    test_binary_matches_text();
+    test_chained_packets();
+    test_parse_errors();
+    test_latency_hist();
+    test_doorbell_latched();
+    test_seq_tracking();
+    test_sender_restart();
+    test_partial_snapshot();
+    test_snapshot_resync();
+    test_redundant_recovery();
+    test_motion_split();
+    test_hires_mouse();
+    test_mouse_builder();
+    test_frame_scheduler();
+    test_keyboard_replay();
+    test_nkro();
+    test_consumer();
+    test_sessions();
+    test_split_pipeline();
+    test_pipeline_stages();
+    test_telemetry();
+}
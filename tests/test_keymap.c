@@ -0,0 +1,128 @@
+#include "test.h"
+#include "keymap_table.h"
+#include "hid_keycodes.h"
+#include <linux/input-event-codes.h>
+#include <stdbool.h>
+
+static void test_lookup(void) {
+    CHECK_EQ(keymap_linux_to_hid(KEY_A), HID_KEY_A);
+    CHECK_EQ(keymap_linux_to_hid(KEY_LEFTSHIFT), HID_KEY_SHIFT_LEFT);
+    CHECK_EQ(keymap_linux_to_hid(KEY_COMMA), 0x36);
+    CHECK_EQ(keymap_linux_to_vk(KEY_A), 'A');
+    CHECK_EQ(keymap_linux_to_vk(KEY_LEFTMETA), 0x5B);   // VK_LWIN
+
+    // Consumer keys are not keyboard usages
+    CHECK_EQ(keymap_lookup(KEY_VOLUMEUP).page, KEYMAP_PAGE_CONSUMER);
+    CHECK_EQ(keymap_lookup(KEY_VOLUMEUP).usage, 0xE9);
+    CHECK_EQ(keymap_linux_to_hid(KEY_VOLUMEUP), 0);
+
+    CHECK_EQ(KEYMAP_SIZE, KEY_MAX + 1);
+    CHECK_EQ(keymap_lookup(KEY_RESERVED).page, KEYMAP_PAGE_NONE);
+    CHECK_EQ(keymap_lookup(BTN_LEFT).page, KEYMAP_PAGE_NONE);   // mouse, not a key
+    CHECK_EQ(keymap_lookup(KEYMAP_SIZE).page, KEYMAP_PAGE_NONE);
+    CHECK_EQ(keymap_linux_to_hid(0xFFFF), 0);
+}
+
+static void test_coverage(void) {
+    // The whole AT-101 block, KEY_ESC .. KEY_F12 (84 is unassigned)
+    int unmapped = 0;
+    for (int code = KEY_ESC; code <= KEY_F12; code++) {
+        if (code != 84 && keymap_lookup((uint16_t)code).page == KEYMAP_PAGE_NONE) unmapped++;
+    }
+    CHECK_EQ(unmapped, 0);
+
+    // Keys the old runtime table dropped
+    static const uint16_t extra[] = {
+        KEY_UP, KEY_DOWN, KEY_LEFT, KEY_RIGHT, KEY_HOME, KEY_END, KEY_PAGEUP,
+        KEY_PAGEDOWN, KEY_INSERT, KEY_DELETE, KEY_SYSRQ, KEY_PAUSE, KEY_KPENTER,
+        KEY_KPSLASH, KEY_RIGHTCTRL, KEY_RIGHTALT, KEY_LEFTMETA, KEY_RIGHTMETA,
+        KEY_COMPOSE, KEY_F13, KEY_F24, KEY_KPEQUAL, KEY_102ND,
+    };
+    for (size_t i = 0; i < sizeof(extra) / sizeof(extra[0]); i++)
+        CHECK_EQ(keymap_lookup(extra[i]).page, KEYMAP_PAGE_KEYBOARD);
+
+    static const uint16_t consumer[] = {
+        KEY_MUTE, KEY_VOLUMEDOWN, KEY_VOLUMEUP, KEY_PLAYPAUSE, KEY_NEXTSONG,
+        KEY_PREVIOUSSONG, KEY_STOPCD, KEY_BACK, KEY_FORWARD, KEY_REFRESH,
+        KEY_HOMEPAGE, KEY_SEARCH, KEY_MAIL, KEY_CALC, KEY_BRIGHTNESSUP,
+        KEY_BRIGHTNESSDOWN,
+    };
+    for (size_t i = 0; i < sizeof(consumer) / sizeof(consumer[0]); i++)
+        CHECK_EQ(keymap_lookup(consumer[i]).page, KEYMAP_PAGE_CONSUMER);
+
+    // Every key hid-input.c reports from the Consumer page, in usage order
+    // (BTN_MISC and the non-key usages left out), plus the CD tray and
+    // media launcher keys that share a usage with one of them
+    static const uint16_t kernel_consumer[] = {
+        KEY_POWER, KEY_RESTART, KEY_SLEEP, KEY_KBDILLUMTOGGLE, KEY_MENU, KEY_SELECT, KEY_UP,
+        KEY_DOWN, KEY_LEFT, KEY_RIGHT, KEY_ESC, KEY_KPPLUS, KEY_KPMINUS, KEY_INFO, KEY_SUBTITLE,
+        KEY_VCR, KEY_CAMERA, KEY_RED, KEY_GREEN, KEY_BLUE, KEY_YELLOW, KEY_ASPECT_RATIO,
+        KEY_BRIGHTNESSUP, KEY_BRIGHTNESSDOWN, KEY_BRIGHTNESS_TOGGLE, KEY_BRIGHTNESS_MIN,
+        KEY_BRIGHTNESS_MAX, KEY_BRIGHTNESS_AUTO, KEY_KBDILLUMUP, KEY_KBDILLUMDOWN,
+        KEY_VIDEO_NEXT, KEY_LAST, KEY_ENTER, KEY_PC, KEY_TV, KEY_WWW, KEY_DVD, KEY_PHONE,
+        KEY_PROGRAM, KEY_VIDEOPHONE, KEY_GAMES, KEY_MEMO, KEY_CD, KEY_TUNER, KEY_EXIT, KEY_HELP,
+        KEY_TAPE, KEY_TV2, KEY_SAT, KEY_PVR, KEY_CHANNELUP, KEY_CHANNELDOWN, KEY_VCR2, KEY_PLAY,
+        KEY_PAUSE, KEY_RECORD, KEY_FASTFORWARD, KEY_REWIND, KEY_NEXTSONG, KEY_PREVIOUSSONG,
+        KEY_STOPCD, KEY_EJECTCD, KEY_SHUFFLE, KEY_MEDIA_REPEAT, KEY_SLOW, KEY_PLAYPAUSE,
+        KEY_VOICECOMMAND, KEY_MUTE, KEY_BASSBOOST, KEY_VOLUMEUP, KEY_VOLUMEDOWN,
+        KEY_BUTTONCONFIG, KEY_BOOKMARKS, KEY_CONFIG, KEY_WORDPROCESSOR, KEY_EDITOR,
+        KEY_SPREADSHEET, KEY_GRAPHICSEDITOR, KEY_PRESENTATION, KEY_DATABASE, KEY_MAIL, KEY_NEWS,
+        KEY_VOICEMAIL, KEY_ADDRESSBOOK, KEY_CALENDAR, KEY_TASKMANAGER, KEY_JOURNAL, KEY_FINANCE,
+        KEY_CALC, KEY_PLAYER, KEY_FILE, KEY_CHAT, KEY_LOGOFF, KEY_COFFEE, KEY_CONTROLPANEL,
+        KEY_APPSELECT, KEY_NEXT, KEY_PREVIOUS, KEY_DOCUMENTS, KEY_SPELLCHECK, KEY_KEYBOARD,
+        KEY_SCREENSAVER, KEY_IMAGES, KEY_AUDIO, KEY_VIDEO, KEY_MESSENGER, KEY_ASSISTANT,
+        KEY_NEW, KEY_OPEN, KEY_CLOSE, KEY_SAVE, KEY_PRINT, KEY_PROPS, KEY_UNDO, KEY_COPY,
+        KEY_CUT, KEY_PASTE, KEY_FIND, KEY_SEARCH, KEY_GOTO, KEY_HOMEPAGE, KEY_BACK, KEY_FORWARD,
+        KEY_STOP, KEY_REFRESH, KEY_ZOOMIN, KEY_ZOOMOUT, KEY_ZOOMRESET, KEY_FULL_SCREEN,
+        KEY_SCROLLUP, KEY_SCROLLDOWN, KEY_EDIT, KEY_CANCEL, KEY_INSERT, KEY_DELETE, KEY_REDO,
+        KEY_REPLY, KEY_FORWARDMAIL, KEY_SEND, KEY_KBD_LAYOUT_NEXT, KEY_SCALE,
+        KEY_KBDINPUTASSIST_PREV, KEY_KBDINPUTASSIST_NEXT, KEY_KBDINPUTASSIST_PREVGROUP,
+        KEY_KBDINPUTASSIST_NEXTGROUP, KEY_KBDINPUTASSIST_ACCEPT, KEY_KBDINPUTASSIST_CANCEL,
+        KEY_CLOSECD, KEY_MEDIA,
+    };
+    int consumer_unmapped = 0;
+    for (size_t i = 0; i < sizeof(kernel_consumer) / sizeof(kernel_consumer[0]); i++) {
+        if (keymap_lookup(kernel_consumer[i]).page == KEYMAP_PAGE_NONE) consumer_unmapped++;
+    }
+    CHECK_EQ(consumer_unmapped, 0);
+    CHECK_EQ(keymap_lookup(KEY_CHANNELUP).usage, 0x9C);
+    CHECK_EQ(keymap_lookup(KEY_SCREENSAVER).usage, 0x1B1);
+
+    // Every usage of a standard keyboard (A .. Keypad =, modifiers) is
+    // produced by exactly one Linux code. 0x32 (Non-US #) arrives from Linux
+    // as KEY_BACKSLASH and is not sent.
+    int producers[256] = {0};
+    int bad = 0;
+    for (int code = 0; code < KEYMAP_SIZE; code++) {
+        keymap_entry e = keymap_table[code];
+        if (e.page == KEYMAP_PAGE_KEYBOARD) {
+            if (e.usage < HID_KEY_A || e.usage > HID_KEY_GUI_RIGHT) bad++;
+            else producers[e.usage]++;
+        } else if (e.page == KEYMAP_PAGE_CONSUMER) {
+            if (e.usage == 0 || e.usage > 0x3FF) bad++;
+        } else if (e.page != KEYMAP_PAGE_NONE || e.usage || e.vk) {
+            bad++;
+        }
+    }
+    CHECK_EQ(bad, 0);
+    int missing = 0, duplicated = 0;
+    for (int u = HID_KEY_A; u <= HID_KEY_GUI_RIGHT; u++) {
+        bool standard = u <= 0x67 || u >= HID_KEY_CONTROL_LEFT;
+        if (standard && u != 0x32 && producers[u] == 0) missing++;
+        if (producers[u] > 1) duplicated++;
+    }
+    CHECK_EQ(missing, 0);
+    CHECK_EQ(duplicated, 0);
+
+    // The Windows server can type everything on a standard keyboard
+    int no_vk = 0;
+    for (int code = KEY_ESC; code <= KEY_F12; code++) {
+        if (code != 84 && code != KEY_ZENKAKUHANKAKU && !keymap_linux_to_vk((uint16_t)code)) no_vk++;
+    }
+    CHECK_EQ(no_vk, 0);
+}
+
+void test_keymap(void) {
+    test_lookup();
+    test_coverage();
+}
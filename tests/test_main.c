@@ -0,0 +1,16 @@
+#include "test.h"
+
+int test_failures = 0;
+int test_checks = 0;
+
+int main(void) {
+    test_proto();
+    test_core();
+    test_queue();
+    test_client();
+    test_keymap();
+    test_server();
+
+    printf("%d checks, %d failures\n", test_checks, test_failures);
+    return test_failures ? 1 : 0;
+}
@@ -0,0 +1,380 @@
+#include "test.h"
+#include "hid_proto.h"
+#include "hid_stats.h"
+#include <string.h>
+
+static void test_roundtrip(void) {
+    uint8_t buf[64];
+    hp_writer w;
+    hp_writer_init(&w, buf, sizeof(buf));
+    CHECK(hp_writer_empty(&w));
+
+    CHECK(hp_put_event(&w, HP_EV_KEY, 30, 1));
+    CHECK(hp_put_event(&w, HP_EV_KEY, 272, 0));
+    CHECK(hp_put_event(&w, HP_EV_REL, 0, -1));
+    CHECK(hp_put_event(&w, HP_EV_REL, 1, 300));
+    CHECK(hp_put_event(&w, HP_EV_REL, 8, -2147483647 - 1));
+    CHECK(!hp_writer_empty(&w));
+
+    hp_reader r;
+    hp_event ev;
+    CHECK_EQ(hp_reader_init(&r, buf, w.len), 0);
+
+    CHECK_EQ(hp_next(&r, &ev), 1);
+    CHECK_EQ(ev.type, HP_EV_KEY); CHECK_EQ(ev.code, 30); CHECK_EQ(ev.value, 1);
+    CHECK_EQ(hp_next(&r, &ev), 1);
+    CHECK_EQ(ev.type, HP_EV_KEY); CHECK_EQ(ev.code, 272); CHECK_EQ(ev.value, 0);
+    CHECK_EQ(hp_next(&r, &ev), 1);
+    CHECK_EQ(ev.type, HP_EV_REL); CHECK_EQ(ev.code, 0); CHECK_EQ(ev.value, -1);
+    CHECK_EQ(hp_next(&r, &ev), 1);
+    CHECK_EQ(ev.code, 1); CHECK_EQ(ev.value, 300);
+    CHECK_EQ(hp_next(&r, &ev), 1);
+    CHECK_EQ(ev.code, 8); CHECK_EQ(ev.value, -2147483647 - 1);
+    CHECK_EQ(hp_next(&r, &ev), 0);
+}
+
+static void test_compact_encoding(void) {
+    uint8_t buf[16];
+    hp_writer w;
+    hp_writer_init(&w, buf, sizeof(buf));
+    CHECK(hp_put_event(&w, HP_EV_KEY, 30, 1));   // "K,30,1;" is 7 bytes
+    CHECK_EQ(w.len, HP_HEADER_LEN + 2);
+    CHECK(hp_put_event(&w, HP_EV_REL, 0, -5));   // "M,0,-5;" is 7 bytes
+    CHECK_EQ(w.len, HP_HEADER_LEN + 4);
+}
+
+static void test_rejects(void) {
+    uint8_t buf[HP_HEADER_LEN + 2];
+    hp_writer w;
+    hp_writer_init(&w, buf, sizeof(buf));
+    CHECK(!hp_put_event(&w, HP_EV_KEY, 30, 2));   // autorepeat
+    CHECK(!hp_put_event(&w, HP_EV_REL, 16, 1));   // beyond REL_MAX
+    CHECK(!hp_put_event(&w, 4, 0, 0));            // EV_MSC
+    CHECK(hp_put_event(&w, HP_EV_KEY, 30, 1));
+    CHECK(!hp_put_event(&w, HP_EV_KEY, 31, 1));   // full
+    hp_writer_reset(&w);
+    CHECK(hp_writer_empty(&w));
+
+    hp_reader r;
+    hp_event ev;
+    const char *text = "K,30,1;";
+    CHECK(!hp_is_binary(text, strlen(text)));
+    CHECK_EQ(hp_reader_init(&r, text, strlen(text)), -1);
+
+    const uint8_t bad_version[] = {HP_MAGIC, 99, 0};
+    CHECK_EQ(hp_reader_init(&r, bad_version, sizeof(bad_version)), -1);
+
+    const uint8_t truncated[] = {HP_MAGIC, HP_VERSION, 0, HP_REC_KEY | 1, 0x80};
+    CHECK_EQ(hp_reader_init(&r, truncated, sizeof(truncated)), 0);
+    CHECK_EQ(hp_next(&r, &ev), -1);
+
+    const uint8_t bad_tag[] = {HP_MAGIC, HP_VERSION, 0, 0xF0};
+    CHECK_EQ(hp_reader_init(&r, bad_tag, sizeof(bad_tag)), 0);
+    CHECK_EQ(hp_next(&r, &ev), -1);
+}
+
+// Minimal stand-in for an lwIP pbuf chain
+typedef struct seg {
+    const struct seg *next;
+    const uint8_t *data;
+    size_t len;
+} seg;
+
+static bool seg_next(const void **s, const uint8_t **data, size_t *len) {
+    const seg *cur = (const seg *)*s;
+    if (!cur) return false;
+    *data = cur->data;
+    *len = cur->len;
+    *s = cur->next;
+    return true;
+}
+
+static void test_chain_reader(void) {
+    uint8_t buf[64];
+    hp_writer w;
+    hp_writer_init(&w, buf, sizeof(buf));
+    hp_put_event(&w, HP_EV_KEY, 300, 1);       // multi-byte varint
+    hp_put_event(&w, HP_EV_REL, 1, -100000);
+    hp_put_event(&w, HP_EV_KEY, 30, 0);
+
+    // Split the datagram at every possible position, with an empty middle segment
+    for (size_t cut = 1; cut < w.len; cut++) {
+        seg tail = {NULL, buf + cut, w.len - cut};
+        seg empty = {&tail, buf + cut, 0};
+        seg head = {&empty, buf, cut};
+
+        hp_reader r;
+        hp_event ev;
+        CHECK_EQ(hp_reader_init_chain(&r, &head, seg_next), 0);
+        CHECK_EQ(hp_next(&r, &ev), 1);
+        CHECK_EQ(ev.code, 300); CHECK_EQ(ev.value, 1);
+        CHECK_EQ(hp_next(&r, &ev), 1);
+        CHECK_EQ(ev.code, 1); CHECK_EQ(ev.value, -100000);
+        CHECK_EQ(hp_next(&r, &ev), 1);
+        CHECK_EQ(ev.code, 30); CHECK_EQ(ev.value, 0);
+        CHECK_EQ(hp_next(&r, &ev), 0);
+    }
+
+    seg only_text = {NULL, (const uint8_t *)"K,1,1;", 6};
+    hp_reader r;
+    CHECK_EQ(hp_reader_init_chain(&r, &only_text, seg_next), -1);
+}
+
+static void test_text_reader(void) {
+    hp_text_reader t;
+    hp_event ev;
+    const char *text = "K,30,1; M,0,-5;M,272,1;;M,11,+120 \r\n;K,42,0";
+    hp_text_init(&t, text, strlen(text));
+    CHECK_EQ(hp_text_next(&t, &ev), 1);
+    CHECK_EQ(ev.type, HP_EV_KEY); CHECK_EQ(ev.code, 30); CHECK_EQ(ev.value, 1);
+    CHECK_EQ(hp_text_next(&t, &ev), 1);
+    CHECK_EQ(ev.type, HP_EV_REL); CHECK_EQ(ev.code, 0); CHECK_EQ(ev.value, -5);
+    CHECK_EQ(hp_text_next(&t, &ev), 1);
+    CHECK_EQ(ev.type, HP_EV_KEY); CHECK_EQ(ev.code, 272); CHECK_EQ(ev.value, 1);
+    CHECK_EQ(hp_text_next(&t, &ev), 1);
+    CHECK_EQ(ev.type, HP_EV_REL); CHECK_EQ(ev.code, 11); CHECK_EQ(ev.value, 120);
+    CHECK_EQ(hp_text_next(&t, &ev), 1);          // last token needs no ';'
+    CHECK_EQ(ev.code, 42); CHECK_EQ(ev.value, 0);
+    CHECK_EQ(hp_text_next(&t, &ev), 0);
+    CHECK_EQ(t.errors, 0);
+
+    // Bad tokens are counted and skipped; other kinds are only ignored
+    const char *bad = "K,abc;K,1;M,1,2x;K,70000,1;M,0,2147483648;X,1,1;M,0,-2147483648;";
+    hp_text_init(&t, bad, strlen(bad));
+    CHECK_EQ(hp_text_next(&t, &ev), 1);
+    CHECK_EQ(ev.value, -2147483647 - 1);
+    CHECK_EQ(hp_text_next(&t, &ev), 0);
+    CHECK_EQ(t.errors, 5);
+    CHECK_EQ(t.ignored, 1);
+
+    // Length-bounded: never reads past len, and a NUL ends the text
+    hp_text_init(&t, "K,30,1;K,31,1", 11);
+    CHECK_EQ(hp_text_next(&t, &ev), 1);
+    CHECK_EQ(hp_text_next(&t, &ev), 0);
+    CHECK_EQ(t.errors, 1);
+    hp_text_init(&t, "K,30,1;\0K,31,1;", 15);
+    CHECK_EQ(hp_text_next(&t, &ev), 1);
+    CHECK_EQ(hp_text_next(&t, &ev), 0);
+
+    // Tokens split across segments at every position
+    const char *chained = "M,1,-300;K,272,0;";
+    size_t len = strlen(chained);
+    for (size_t cut = 1; cut < len; cut++) {
+        seg tail = {NULL, (const uint8_t *)chained + cut, len - cut};
+        seg head = {&tail, (const uint8_t *)chained, cut};
+        hp_text_init_chain(&t, &head, seg_next);
+        CHECK_EQ(hp_text_next(&t, &ev), 1);
+        CHECK_EQ(ev.code, 1); CHECK_EQ(ev.value, -300);
+        CHECK_EQ(hp_text_next(&t, &ev), 1);
+        CHECK_EQ(ev.type, HP_EV_KEY); CHECK_EQ(ev.code, 272); CHECK_EQ(ev.value, 0);
+        CHECK_EQ(hp_text_next(&t, &ev), 0);
+        CHECK_EQ(t.errors, 0);
+    }
+}
+
+static void test_header_extension(void) {
+    uint8_t buf[64];
+    hp_writer w;
+    hp_writer_init_flags(&w, buf, sizeof(buf), HP_FLAG_SEQ | HP_FLAG_TIME | HP_FLAG_EPOCH);
+    CHECK_EQ(w.hdr_len, HP_HEADER_LEN + HP_MAX_EXT_LEN);
+    CHECK(hp_writer_empty(&w));
+    hp_writer_set_epoch(&w, 0xBEEF);
+    CHECK(hp_put_event(&w, HP_EV_KEY, 30, 1));
+    hp_writer_stamp(&w, 0x01020304, 0xDEADBEEF, 100000);   // age saturates
+
+    hp_reader r;
+    hp_event ev;
+    CHECK_EQ(hp_reader_init(&r, buf, w.len), 0);
+    CHECK_EQ(r.flags, HP_FLAG_SEQ | HP_FLAG_TIME | HP_FLAG_EPOCH);
+    CHECK_EQ(r.seq, 0x01020304);
+    CHECK_EQ(r.send_us, 0xDEADBEEF);
+    CHECK_EQ(r.age_us, 0xFFFF);
+    CHECK_EQ(r.epoch, 0xBEEF);
+    CHECK_EQ(hp_next(&r, &ev), 1);
+    CHECK_EQ(ev.code, 30);
+    CHECK_EQ(hp_next(&r, &ev), 0);
+
+    // Sequence only
+    hp_writer_init_flags(&w, buf, sizeof(buf), HP_FLAG_SEQ);
+    hp_writer_stamp(&w, 7, 1, 1);
+    CHECK_EQ(hp_reader_init(&r, buf, w.len), 0);
+    CHECK_EQ(r.seq, 7);
+    CHECK_EQ(r.send_us, 0);
+    CHECK_EQ(hp_next(&r, &ev), 0);
+
+    // Epoch without a timestamp, kept across reset and stamp
+    hp_writer_init_flags(&w, buf, sizeof(buf), HP_FLAG_SEQ | HP_FLAG_EPOCH);
+    hp_writer_set_epoch(&w, 513);
+    hp_writer_reset(&w);
+    hp_writer_stamp(&w, 8, 0, 0);
+    CHECK_EQ(hp_reader_init(&r, buf, w.len), 0);
+    CHECK_EQ(r.seq, 8);
+    CHECK_EQ(r.epoch, 513);
+
+    // Truncated extension and unknown flags are rejected
+    CHECK_EQ(hp_reader_init(&r, buf, HP_HEADER_LEN + 2), -1);
+    const uint8_t unknown[] = {HP_MAGIC, HP_VERSION, 0x80};
+    CHECK_EQ(hp_reader_init(&r, unknown, sizeof(unknown)), -1);
+}
+
+static void test_stats_format(void) {
+    uint8_t buf[HS_MAX_REPLY];
+    hs_writer w;
+    hs_writer_init(&w, buf, sizeof(buf));
+    hs_begin_section(&w, 0x7F);                  // unknown to readers
+    hs_put_u32(&w, 42);
+    hs_end_section(&w);
+    hs_begin_section(&w, HS_SEC_LATENCY);
+    hs_put_u8(&w, HS_STAGE_USB);
+    hs_put_u32(&w, 3);
+    hs_put_u32(&w, 10);
+    hs_put_u32(&w, 900);
+    hs_put_u64(&w, 5000000000ull);
+    hs_put_u8(&w, 2);
+    hs_put_u32(&w, 1);
+    hs_put_u32(&w, 2);
+    hs_end_section(&w);
+    hs_begin_section(&w, HS_SEC_COUNTERS);
+    hs_put_u8(&w, HS_CTR_READY_STALLS);
+    hs_put_u32(&w, 7);
+    hs_put_u8(&w, HS_CTR_RSSI);
+    hs_put_u32(&w, (uint32_t)-61);
+    hs_end_section(&w);
+    size_t len = hs_writer_finish(&w);
+    CHECK(len > HS_HEADER_LEN);
+
+    hs_reader r, sec;
+    uint8_t id;
+    hs_latency lat;
+    CHECK_EQ(hs_reader_init(&r, buf, len), 0);
+    CHECK_EQ(hs_next_section(&r, &id, &sec), 1);
+    CHECK_EQ(id, 0x7F);
+    CHECK_EQ(hs_next_section(&r, &id, &sec), 1);
+    CHECK_EQ(id, HS_SEC_LATENCY);
+    CHECK_EQ(hs_next_latency(&sec, &lat), 1);
+    CHECK_EQ(lat.stage, HS_STAGE_USB);
+    CHECK_EQ(lat.count, 3);
+    CHECK_EQ(lat.max_us, 900);
+    CHECK_EQ(lat.sum_us, 5000000000ull);
+    CHECK_EQ(lat.nbuckets, 2);
+    CHECK_EQ(lat.buckets[1], 2);
+    CHECK_EQ(hs_latency_percentile(&lat, 10), 0);
+    CHECK_EQ(hs_latency_percentile(&lat, 99), 1);
+    CHECK_EQ(hs_next_latency(&sec, &lat), 0);
+    CHECK_EQ(hs_next_section(&r, &id, &sec), 1);
+    CHECK_EQ(id, HS_SEC_COUNTERS);
+    uint32_t v;
+    CHECK_EQ(hs_next_counter(&sec, &id, &v), 1);
+    CHECK_EQ(id, HS_CTR_READY_STALLS);
+    CHECK_EQ(v, 7);
+    CHECK_EQ(hs_next_counter(&sec, &id, &v), 1);
+    CHECK_EQ((int32_t)v, -61);
+    CHECK_EQ(hs_next_counter(&sec, &id, &v), 0);
+    CHECK_EQ(hs_next_section(&r, &id, &sec), 0);
+
+    // Truncated reply and overflowing writer
+    CHECK_EQ(hs_reader_init(&r, buf, len - 1), 0);
+    CHECK_EQ(hs_next_section(&r, &id, &sec), 1);
+    CHECK_EQ(hs_next_section(&r, &id, &sec), 1);
+    CHECK_EQ(hs_next_section(&r, &id, &sec), -1);
+    uint8_t small[8];
+    hs_writer_init(&w, small, sizeof(small));
+    hs_begin_section(&w, HS_SEC_LATENCY);
+    hs_put_u64(&w, 1);
+    hs_end_section(&w);
+    CHECK_EQ(hs_writer_finish(&w), 0);
+}
+
+static void test_state_record(void) {
+    uint8_t buf[256];
+    hp_writer w;
+    hp_writer_init(&w, buf, sizeof(buf));
+    const uint16_t held[] = {42, 300, 272};
+    CHECK(hp_put_event(&w, HP_EV_KEY, 30, 0));
+    CHECK(hp_put_state(&w, held, 3));
+    CHECK(hp_put_state(&w, NULL, 0));
+    uint16_t many[HP_MAX_STATE_CODES + 1] = {0};
+    CHECK(!hp_put_state(&w, many, HP_MAX_STATE_CODES + 1));
+
+    hp_reader r;
+    hp_event ev;
+    CHECK_EQ(hp_reader_init(&r, buf, w.len), 0);
+    CHECK_EQ(hp_next(&r, &ev), 1);
+    CHECK_EQ(ev.type, HP_EV_KEY);
+    for (int i = 0; i < 3; i++) {
+        CHECK_EQ(hp_next(&r, &ev), 1);
+        CHECK_EQ(ev.type, HP_EV_STATE);
+        CHECK_EQ(ev.value, HP_STATE_HELD);
+        CHECK_EQ(ev.code, held[i]);
+    }
+    CHECK_EQ(hp_next(&r, &ev), 1);
+    CHECK_EQ(ev.type, HP_EV_STATE); CHECK_EQ(ev.value, HP_STATE_END);
+    CHECK_EQ(ev.code, 0);
+    CHECK_EQ(hp_next(&r, &ev), 1);
+    CHECK_EQ(ev.type, HP_EV_STATE); CHECK_EQ(ev.value, HP_STATE_END);
+    CHECK_EQ(hp_next(&r, &ev), 0);
+
+    // A partial snapshot says so on its END event, and only there
+    hp_writer_init(&w, buf, sizeof(buf));
+    CHECK(hp_put_partial_state(&w, held, 2));
+    CHECK(hp_put_state(&w, held, 1));
+    CHECK_EQ(hp_reader_init(&r, buf, w.len), 0);
+    CHECK_EQ(hp_next(&r, &ev), 1); CHECK_EQ(ev.code, 42);
+    CHECK_EQ(hp_next(&r, &ev), 1); CHECK_EQ(ev.code, 300);
+    CHECK_EQ(hp_next(&r, &ev), 1);
+    CHECK_EQ(ev.value, HP_STATE_END); CHECK_EQ(ev.code, HP_STATE_PARTIAL);
+    CHECK_EQ(hp_next(&r, &ev), 1); CHECK_EQ(ev.code, 42);
+    CHECK_EQ(hp_next(&r, &ev), 1);
+    CHECK_EQ(ev.value, HP_STATE_END); CHECK_EQ(ev.code, 0);
+    CHECK_EQ(hp_next(&r, &ev), 0);
+    const uint8_t bad_state[] = {HP_MAGIC, HP_VERSION, 0, HP_REC_STATE | 2, 0};
+    CHECK_EQ(hp_reader_init(&r, bad_state, sizeof(bad_state)), 0);
+    CHECK_EQ(hp_next(&r, &ev), -1);
+
+    // Count larger than the codes that follow, or than the limit
+    const uint8_t short_state[] = {HP_MAGIC, HP_VERSION, 0, HP_REC_STATE, 2, 30};
+    CHECK_EQ(hp_reader_init(&r, short_state, sizeof(short_state)), 0);
+    CHECK_EQ(hp_next(&r, &ev), 1);
+    CHECK_EQ(hp_next(&r, &ev), -1);
+    const uint8_t big_state[] = {HP_MAGIC, HP_VERSION, 0, HP_REC_STATE, HP_MAX_STATE_CODES + 1};
+    CHECK_EQ(hp_reader_init(&r, big_state, sizeof(big_state)), 0);
+    CHECK_EQ(hp_next(&r, &ev), -1);
+}
+
+static void test_redundant_history(void) {
+    hp_history h = {0};
+    for (uint32_t i = 0; i < HP_MAX_REDUNDANT + 2; i++) hp_history_add(&h, i, (uint16_t)(100 + i), i & 1);
+    hp_history_add(&h, 20, 300, true);   // belongs to the datagram being built
+
+    uint8_t buf[128];
+    hp_writer w;
+    hp_writer_init(&w, buf, sizeof(buf));
+    CHECK_EQ(hp_put_history(&w, &h, 20, 3), 2);
+    CHECK(!hp_put_redundant(&w, 0, 30, true));
+
+    hp_reader r;
+    hp_event ev;
+    CHECK_EQ(hp_reader_init(&r, buf, w.len), 0);
+    CHECK_EQ(hp_next(&r, &ev), 1);
+    CHECK_EQ(ev.type, HP_EV_REDUNDANT);
+    CHECK_EQ(ev.code, 116); CHECK_EQ(ev.value, 0); CHECK_EQ(ev.back, 4);
+    CHECK_EQ(hp_next(&r, &ev), 1);
+    CHECK_EQ(ev.code, 117); CHECK_EQ(ev.value, 1); CHECK_EQ(ev.back, 3);
+    CHECK_EQ(hp_next(&r, &ev), 0);
+
+    const uint8_t zero_back[] = {HP_MAGIC, HP_VERSION, 0, HP_REC_REDUNDANT | 1, 0, 30};
+    CHECK_EQ(hp_reader_init(&r, zero_back, sizeof(zero_back)), 0);
+    CHECK_EQ(hp_next(&r, &ev), -1);
+}
+
+void test_proto(void) {
+    test_roundtrip();
+    test_compact_encoding();
+    test_rejects();
+    test_chain_reader();
+    test_text_reader();
+    test_header_extension();
+    test_stats_format();
+    test_state_record();
+    test_redundant_history();
+}
@@ -0,0 +1,197 @@
+#include "test.h"
+#include "packet_queue.h"
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#define STRESS_PACKETS 200000
+
+static void test_single_thread(void) {
+    packet_queue_reset();
+    CHECK(packet_queue_peek() == NULL);
+
+    CHECK(enqueue_packet("abc", 3));
+    CHECK_EQ(packet_queue_depth(), 1);
+    const Packet *pkt = packet_queue_peek();
+    CHECK(pkt != NULL);
+    CHECK_EQ(pkt->len, 3);
+    CHECK(memcmp(pkt->data, "abc", 3) == 0);
+    packet_queue_release();
+    CHECK(packet_queue_peek() == NULL);
+
+    // Small packets: the ring fills up by bytes, not by a fixed slot count
+    int capacity = (int)(PACKET_QUEUE_BYTES / packet_queue_record_size(1));
+    int queued = 0;
+    while (enqueue_packet("x", 1)) queued++;
+    CHECK_EQ(queued, capacity);
+    CHECK(!enqueue_packet("y", 1));
+    CHECK_EQ(packet_queue_bytes_used(), PACKET_QUEUE_BYTES - PACKET_QUEUE_BYTES % packet_queue_record_size(1));
+
+    packet_queue_stats st;
+    packet_queue_get_stats(&st);
+    CHECK_EQ(st.enqueued, capacity + 1);
+    CHECK_EQ(st.dropped, 2);
+    CHECK_EQ(st.high_watermark, capacity);
+    CHECK_EQ(st.bytes_high, packet_queue_bytes_used());
+
+    while (packet_queue_peek()) packet_queue_release();
+    CHECK_EQ(packet_queue_depth(), 0);
+    CHECK_EQ(packet_queue_bytes_used(), 0);
+
+    // Typical pi_client datagrams: a few hundred fit
+    packet_queue_reset();
+    char typical[32] = {0};
+    for (queued = 0; enqueue_packet(typical, sizeof(typical)); queued++) {}
+    CHECK(queued >= 128);
+    packet_queue_reset();
+}
+
+static void test_wrap(void) {
+    // Every size up to the largest, at every offset: records never straddle
+    // the end, contents survive the skip to offset 0
+    packet_queue_reset();
+    static char data[PACKET_MAX_LEN];
+    uint32_t bad = 0;
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < 3000; i++) {
+        uint16_t len = (uint16_t)(1 + (i * 37) % PACKET_MAX_LEN);
+        memset(data, (int)(i & 0xFF), len);
+        if (!enqueue_packet(data, len)) bad++;
+        // Up to three stay queued, so the skip happens under a live record
+        const Packet *pkt;
+        while (packet_queue_depth() > i % 4 && (pkt = packet_queue_peek()) != NULL) {
+            uint16_t want = (uint16_t)(1 + (next * 37) % PACKET_MAX_LEN);
+            if (pkt->len != want || (uint8_t)pkt->data[0] != (next & 0xFF) ||
+                (uint8_t)pkt->data[want - 1] != (next & 0xFF))
+                bad++;
+            packet_queue_release();
+            next++;
+        }
+    }
+    CHECK_EQ(bad, 0);
+    packet_queue_stats st;
+    packet_queue_get_stats(&st);
+    CHECK_EQ(st.dropped, 0);
+    CHECK(st.bytes_high <= PACKET_QUEUE_BYTES);
+
+    // Full of the largest records: refused without disturbing the queue, and
+    // once drained the largest fits again wherever head ended up
+    packet_queue_reset();
+    memset(data, 0x5A, sizeof(data));
+    int n = 0;
+    while (enqueue_packet(data, PACKET_MAX_LEN)) n++;
+    CHECK(n >= 2);
+    uint32_t used = packet_queue_bytes_used();
+    CHECK(!enqueue_packet(data, PACKET_MAX_LEN));
+    CHECK_EQ(packet_queue_bytes_used(), used);
+    const Packet *pkt;
+    while ((pkt = packet_queue_peek()) != NULL) {
+        if (pkt->len != PACKET_MAX_LEN || pkt->data[PACKET_MAX_LEN - 1] != 0x5A) bad++;
+        packet_queue_release();
+        n--;
+    }
+    CHECK_EQ(n, 0);
+    CHECK_EQ(bad, 0);
+    CHECK(enqueue_packet(data, PACKET_MAX_LEN));
+    packet_queue_reset();
+}
+
+static void test_refs(void) {
+    packet_queue_reset();
+    int bufs[PACKET_QUEUE_MAX_REFS + 1];
+
+    for (int i = 0; i < PACKET_QUEUE_MAX_REFS; i++) CHECK(enqueue_packet_ref(&bufs[i], 100));
+    // Too many outstanding: caller falls back to copying, not a drop
+    CHECK(!enqueue_packet_ref(&bufs[PACKET_QUEUE_MAX_REFS], 100));
+    CHECK(enqueue_packet("copy", 4));
+
+    packet_queue_stats st;
+    packet_queue_get_stats(&st);
+    CHECK_EQ(st.dropped, 0);
+    CHECK_EQ(st.refs_queued, PACKET_QUEUE_MAX_REFS);
+
+    // Nothing comes back until the consumer is done with it
+    CHECK(packet_queue_reclaim() == NULL);
+    const Packet *pkt = packet_queue_peek();
+    CHECK(pkt->ref == &bufs[0]);
+    CHECK_EQ(pkt->len, 100);
+    packet_queue_release();
+    CHECK(packet_queue_reclaim() == &bufs[0]);
+    CHECK(packet_queue_reclaim() == NULL);
+    CHECK(enqueue_packet_ref(&bufs[PACKET_QUEUE_MAX_REFS], 100));
+
+    // Drain: every reference is returned exactly once, copies are not
+    int returned = 0;
+    while ((pkt = packet_queue_peek()) != NULL) {
+        packet_queue_release();
+        while (packet_queue_reclaim()) returned++;
+    }
+    CHECK_EQ(returned, PACKET_QUEUE_MAX_REFS);
+
+    static char oversize[PACKET_MAX_LEN + 1];
+    CHECK(enqueue_packet(oversize, sizeof(oversize)));
+    packet_queue_get_stats(&st);
+    CHECK_EQ(st.truncated, 1);
+    CHECK_EQ(packet_queue_peek()->len, PACKET_MAX_LEN);
+    packet_queue_reset();
+}
+
+// Core1 stand-in: every packet carries its sequence number in every byte
+// position so a torn read shows up as mixed content.
+static void *producer(void *arg) {
+    (void)arg;
+    uint32_t seq = 0;
+    while (seq < STRESS_PACKETS) {
+        uint16_t len = (uint16_t)(4 + seq % (PACKET_MAX_LEN - 4));
+        Packet *slot = packet_queue_reserve(len);
+        if (!slot) { sched_yield(); continue; }
+        for (uint16_t i = 0; i < len; i += 4) memcpy(slot->data + i, &seq, 4);
+        slot->len = len;
+        packet_queue_publish();
+        seq++;
+    }
+    return NULL;
+}
+
+static void test_two_threads(void) {
+    packet_queue_reset();
+
+    pthread_t tid;
+    pthread_create(&tid, NULL, producer, NULL);
+
+    uint32_t expect = 0;
+    uint32_t torn = 0, out_of_order = 0;
+    while (expect < STRESS_PACKETS) {
+        const Packet *pkt = packet_queue_peek();
+        if (!pkt) { sched_yield(); continue; }
+
+        uint32_t seq;
+        memcpy(&seq, pkt->data, 4);
+        if (seq != expect) out_of_order++;
+        if (pkt->len != 4 + expect % (PACKET_MAX_LEN - 4)) torn++;
+        for (uint16_t i = 0; i + 4 <= pkt->len; i += 4) {
+            uint32_t v;
+            memcpy(&v, pkt->data + i, 4);
+            if (v != seq) { torn++; break; }
+        }
+        packet_queue_release();
+        expect++;
+    }
+    pthread_join(tid, NULL);
+
+    CHECK_EQ(torn, 0);
+    CHECK_EQ(out_of_order, 0);
+    CHECK(packet_queue_peek() == NULL);
+
+    packet_queue_stats st;
+    packet_queue_get_stats(&st);
+    CHECK_EQ(st.enqueued, STRESS_PACKETS);
+    CHECK(st.bytes_high <= PACKET_QUEUE_BYTES);
+}
+
+void test_queue(void) {
+    test_single_thread();
+    test_wrap();
+    test_refs();
+    test_two_threads();
+}
@@ -0,0 +1,177 @@
+#include "test.h"
+#include "hid_proto.h"
+#include "hid_stats.h"
+#include "receive_engine.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define TEST_PORT       51337
+#define TEST_STATS_PORT 51338
+
+// Sink that keeps the last batch
+typedef struct {
+    int calls;
+    size_t n;
+    rx_action last[RX_MAX_ACTIONS];
+} record_sink;
+
+static size_t record_inject(void *ctx, const rx_action *actions, size_t n) {
+    record_sink *s = (record_sink *)ctx;
+    s->calls++;
+    s->n = n;
+    memcpy(s->last, actions, n * sizeof(*actions));
+    return n;
+}
+
+static void check_key(const rx_action *a, uint16_t code, int32_t value) {
+    CHECK_EQ(a->type, RX_ACT_KEY);
+    CHECK_EQ(a->code, code);
+    CHECK_EQ(a->value, value);
+}
+
+static void check_motion(const rx_action *a, int32_t dx, int32_t dy, int32_t wheel) {
+    CHECK_EQ(a->type, RX_ACT_MOTION);
+    CHECK_EQ(a->dx, dx);
+    CHECK_EQ(a->dy, dy);
+    CHECK_EQ(a->wheel, wheel);
+}
+
+static void test_engine_batches(void) {
+    record_sink rs = {0};
+    rx_sink sink = {record_inject, &rs};
+    static rx_engine e;
+    rx_engine_init(&e, &sink);
+
+    // Every text record, motion merged up to each button change, one batch
+    const char *text = "M,0,5;M,1,-3;M,272,1;M,0,2;M,272,0;K,30,1;";
+    CHECK_EQ(rx_engine_datagram(&e, text, strlen(text)), 5);
+    CHECK_EQ(rs.calls, 1);
+    CHECK_EQ(rs.n, 5);
+    check_motion(&rs.last[0], 5, -3, 0);
+    check_key(&rs.last[1], 272, 1);
+    check_motion(&rs.last[2], 2, 0, 0);
+    check_key(&rs.last[3], 272, 0);
+    check_key(&rs.last[4], 30, 1);
+    CHECK_EQ(e.stats.events, 6);
+    CHECK_EQ(e.stats.merged, 1);
+
+    // Binary: hi-res wheel wins over the detents reported with it
+    uint8_t buf[2048];
+    hp_writer w;
+    hp_writer_init(&w, buf, sizeof(buf));
+    hp_put_event(&w, HP_EV_REL, 8, 1);
+    hp_put_event(&w, HP_EV_REL, 11, 120);
+    hp_put_event(&w, HP_EV_REL, 6, -2);
+    CHECK_EQ(rx_engine_datagram(&e, (const char *)buf, w.len), 1);
+    check_motion(&rs.last[0], 0, 0, 120);
+    CHECK_EQ(rs.last[0].hwheel, -2 * RX_WHEEL_UNIT);
+
+    // Nothing to inject: no sink call; garbage counts as malformed
+    const uint16_t none[] = {0};
+    hp_writer_init(&w, buf, sizeof(buf));
+    hp_put_state(&w, none, 0);
+    CHECK_EQ(rx_engine_datagram(&e, (const char *)buf, w.len), 0);
+    CHECK_EQ(rx_engine_datagram(&e, "Garbage", 7), -1);
+    CHECK_EQ(rs.calls, 2);
+    CHECK_EQ(e.stats.malformed, 1);
+
+    // Datagrams past the old 200-byte buffer decode to the end
+    char big[RX_MAX_DATAGRAM];
+    size_t len = 0;
+    int records = 0;
+    while (len + 14 <= sizeof(big)) {
+        memcpy(big + len, "K,30,1;K,30,0;", 14);
+        len += 14;
+        records += 2;
+    }
+    CHECK_EQ(rx_engine_datagram(&e, big, len), records);
+    check_key(&rs.last[records - 1], 30, 0);
+
+    // More records than a batch holds: the rest are counted, not injected
+    hp_writer_init(&w, buf, sizeof(buf));
+    for (int i = 0; i < RX_MAX_ACTIONS + 10; i++) hp_put_event(&w, HP_EV_KEY, 30, i & 1);
+    CHECK_EQ(rx_engine_datagram(&e, (const char *)buf, w.len), RX_MAX_ACTIONS);
+    CHECK_EQ(e.stats.overflow, 10);
+    CHECK_EQ(e.stats.batches, 4);
+    CHECK_EQ(e.stats.rejected, 0);
+}
+
+typedef struct {
+    rx_engine *e;
+    int rc;
+} serve_ctx;
+
+static void *serve_thread(void *arg) {
+    serve_ctx *ctx = (serve_ctx *)arg;
+    ctx->rc = rx_engine_serve(ctx->e, TEST_PORT, TEST_STATS_PORT);
+    return NULL;
+}
+
+// UDP_RX as reported on the stats port, or -1 without an answer
+static long query_udp_rx(int fd, const struct sockaddr_in *stats) {
+    uint8_t req = HS_REQ_SNAPSHOT, reply[HS_MAX_REPLY];
+    sendto(fd, &req, 1, 0, (const struct sockaddr *)stats, sizeof(*stats));
+    ssize_t len = recv(fd, reply, sizeof(reply), 0);
+    hs_reader r, sec;
+    uint8_t id, c;
+    uint32_t v;
+    if (len <= 0 || hs_reader_init(&r, reply, (size_t)len) < 0) return -1;
+    while (hs_next_section(&r, &id, &sec) == 1) {
+        while (id == HS_SEC_COUNTERS && hs_next_counter(&sec, &c, &v) == 1) {
+            if (c == HS_CTR_UDP_RX) return v;
+        }
+    }
+    return -1;
+}
+
+static void test_serve_oversize(void) {
+    // An oversize datagram is cut, counted and decoded; the loop keeps going
+    record_sink rs = {0};
+    rx_sink sink = {record_inject, &rs};
+    static rx_engine e;
+    rx_engine_init(&e, &sink);
+    serve_ctx ctx = {&e, 1};
+    pthread_t tid;
+    pthread_create(&tid, NULL, serve_thread, &ctx);
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct timeval tv = {0, 100000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    struct sockaddr_in hid = {0}, stats;
+    hid.sin_family = AF_INET;
+    hid.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    stats = hid;
+    hid.sin_port = htons(TEST_PORT);
+    stats.sin_port = htons(TEST_STATS_PORT);
+
+    // Wait until the server answers before sending anything to it
+    long rx = -1;
+    for (int i = 0; i < 50 && rx < 0; i++) rx = query_udp_rx(fd, &stats);
+    CHECK_EQ(rx, 0);
+
+    static char big[RX_MAX_DATAGRAM + 300];
+    for (size_t i = 0; i + 7 <= sizeof(big); i += 7) memcpy(big + i, "K,30,1;", 7);
+    sendto(fd, big, sizeof(big), 0, (struct sockaddr *)&hid, sizeof(hid));
+    sendto(fd, "K,31,1;", 7, 0, (struct sockaddr *)&hid, sizeof(hid));
+    for (int i = 0; i < 50 && rx < 2; i++) rx = query_udp_rx(fd, &stats);
+    CHECK_EQ(rx, 2);
+
+    rx_engine_stop(&e);
+    pthread_join(tid, NULL);
+    close(fd);
+    CHECK_EQ(ctx.rc, 0);
+    CHECK_EQ(e.stats.truncated, 1);
+    CHECK_EQ(e.stats.malformed, 0);
+    CHECK_EQ(rs.calls, 2);
+    check_key(&rs.last[0], 31, 1);
+}
+
+void test_server(void) {
+    test_engine_batches();
+    test_serve_oversize();
+}
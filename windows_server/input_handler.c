@@ -1,26 +1,62 @@
 #include "input_handler.h"
+#include "linux_to_windows.h"
 #include <windows.h>
 
-int simulate_key_event(WORD virtual_key, int is_keyup) {
-    INPUT input;
-    input.type = INPUT_KEYBOARD;
-    input.ki.wVk = virtual_key;
-    input.ki.wScan = 0; // Let system determine scan code
-    input.ki.dwFlags = is_keyup ? KEYEVENTF_KEYUP : 0;
-    input.ki.time = 0; // Current time
-    input.ki.dwExtraInfo = 0; // No extra info
+// Motion can expand to a move, a wheel and a horizontal wheel input
+#define MAX_INPUTS (RX_MAX_ACTIONS * 3)
 
-    return SendInput(1, &input, sizeof(INPUT));
+static void mouse_input(INPUT *in, LONG dx, LONG dy, DWORD data, DWORD flags) {
+    ZeroMemory(in, sizeof(*in));
+    in->type = INPUT_MOUSE;
+    in->mi.dx = dx;
+    in->mi.dy = dy;
+    in->mi.mouseData = data;
+    in->mi.dwFlags = flags;
 }
-int simulate_mouse_event(int dx, int dy, int wheel, DWORD flags) {
-    INPUT input;
-    input.type = INPUT_MOUSE;
-    input.mi.dx = dx;
-    input.mi.dy = dy;
-    input.mi.mouseData = wheel;
-    input.mi.dwFlags = flags;
-    input.mi.time = 0;
-    input.mi.dwExtraInfo = 0;
 
-    return SendInput(1, &input, sizeof(INPUT));
-}
\ No newline at end of file
+static UINT button_input(INPUT *in, const rx_action *a) {
+    DWORD flags;
+    switch (a->code) {
+        case 272: flags = a->value ? MOUSEEVENTF_LEFTDOWN : MOUSEEVENTF_LEFTUP; break;     // BTN_LEFT
+        case 273: flags = a->value ? MOUSEEVENTF_RIGHTDOWN : MOUSEEVENTF_RIGHTUP; break;   // BTN_RIGHT
+        case 274: flags = a->value ? MOUSEEVENTF_MIDDLEDOWN : MOUSEEVENTF_MIDDLEUP; break; // BTN_MIDDLE
+        default: return 0;
+    }
+    mouse_input(in, 0, 0, 0, flags);
+    return 1;
+}
+
+static UINT key_input(INPUT *in, const rx_action *a) {
+    if (a->code >= 272 && a->code <= 274) return button_input(in, a);
+    WORD vk = get_windows_vk(a->code);
+    if (vk == 0) return 0;
+    ZeroMemory(in, sizeof(*in));
+    in->type = INPUT_KEYBOARD;
+    in->ki.wVk = vk;                // scan code left to the system
+    in->ki.dwFlags = a->value == 0 ? KEYEVENTF_KEYUP : 0;
+    return 1;
+}
+
+static UINT motion_inputs(INPUT *in, const rx_action *a) {
+    UINT n = 0;
+    if (a->dx || a->dy) mouse_input(&in[n++], a->dx, a->dy, 0, MOUSEEVENTF_MOVE);
+    if (a->wheel) mouse_input(&in[n++], 0, 0, (DWORD)a->wheel, MOUSEEVENTF_WHEEL);
+    if (a->hwheel) mouse_input(&in[n++], 0, 0, (DWORD)a->hwheel, MOUSEEVENTF_HWHEEL);
+    return n;
+}
+
+size_t input_handler_inject(void *ctx, const rx_action *actions, size_t n) {
+    (void)ctx;
+    static INPUT inputs[MAX_INPUTS];
+    UINT count = 0;
+    size_t mapped = 0;
+    for (size_t i = 0; i < n; i++) {
+        UINT added = actions[i].type == RX_ACT_KEY ? key_input(&inputs[count], &actions[i])
+                                                   : motion_inputs(&inputs[count], &actions[i]);
+        count += added;
+        mapped += added > 0;
+    }
+    if (count == 0) return 0;
+    // SendInput returns how many inputs went in; all or nothing in practice
+    return SendInput(count, inputs, sizeof(INPUT)) == count ? mapped : 0;
+}
@@ -1,9 +1,9 @@
 #ifndef INPUT_HANDLER_H
 #define INPUT_HANDLER_H
 
-#include <windows.h>
+#include "receive_engine.h"
 
-// Function declarations
-int simulate_key_event(WORD virtual_key, int is_keyup);
-int simulate_mouse_event(int dx, int dy, int wheel, DWORD flags);
-#endif // INPUT_HANDLER_H
\ No newline at end of file
+// rx_sink backend: one SendInput call per datagram. ctx is unused.
+size_t input_handler_inject(void *ctx, const rx_action *actions, size_t n);
+
+#endif // INPUT_HANDLER_H
@@ -0,0 +1,275 @@
+#include "receive_engine.h"
+#include "hid_proto.h"
+#include "hid_stats.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+typedef SOCKET rx_socket;
+typedef int socklen_t;
+#define RX_NO_SOCKET INVALID_SOCKET
+#define rx_close closesocket
+#define rx_errno() WSAGetLastError()
+#define RX_EMSGSIZE WSAEMSGSIZE
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int rx_socket;
+#define RX_NO_SOCKET (-1)
+#define rx_close close
+#define rx_errno() errno
+#define RX_EMSGSIZE EMSGSIZE
+#endif
+
+// How often a blocked serve loop looks at the stop flag
+#define RX_STOP_POLL_MS 100
+
+void rx_engine_init(rx_engine *e, const rx_sink *sink) {
+    memset(e, 0, sizeof(*e));
+    e->sink = *sink;
+    atomic_init(&e->stop, false);
+}
+
+void rx_engine_stop(rx_engine *e) {
+    atomic_store(&e->stop, true);
+}
+
+// ───────────────────────────────
+// Decoding and motion coalescing
+// ───────────────────────────────
+// Same wheel rule as the firmware parser: kernels report detents and hi-res
+// units for the same movement, so hi-res values win when both are present.
+typedef struct {
+    int32_t dx, dy;
+    int32_t wheel, hwheel;         // REL_WHEEL / REL_HWHEEL detents
+    int32_t wheel_hr, hwheel_hr;   // REL_WHEEL_HI_RES / REL_HWHEEL_HI_RES
+    bool has_wheel_hr, has_hwheel_hr;
+    bool open;                     // a record went in since the last close
+} motion_accum;
+
+static int32_t sat_add(int32_t a, int32_t b) {
+    int64_t v = (int64_t)a + b;
+    return v > INT32_MAX ? INT32_MAX : (v < INT32_MIN ? INT32_MIN : (int32_t)v);
+}
+
+static int32_t detents_to_units(int32_t v) {
+    const int32_t max = INT32_MAX / RX_WHEEL_UNIT;
+    return (v > max ? max : (v < -max ? -max : v)) * RX_WHEEL_UNIT;
+}
+
+static rx_action *next_action(rx_engine *e, size_t *n) {
+    if (*n == RX_MAX_ACTIONS) {
+        e->stats.overflow++;
+        return NULL;
+    }
+    return &e->batch[(*n)++];
+}
+
+static void close_motion(rx_engine *e, motion_accum *m, size_t *n) {
+    int32_t wheel = m->has_wheel_hr ? m->wheel_hr : detents_to_units(m->wheel);
+    int32_t hwheel = m->has_hwheel_hr ? m->hwheel_hr : detents_to_units(m->hwheel);
+    if (m->dx || m->dy || wheel || hwheel) {
+        rx_action *a = next_action(e, n);
+        if (a) *a = (rx_action){RX_ACT_MOTION, 0, 0, m->dx, m->dy, wheel, hwheel};
+    }
+    memset(m, 0, sizeof(*m));
+}
+
+static void add_event(rx_engine *e, const hp_event *ev, motion_accum *m, size_t *n) {
+    e->stats.events++;
+    if (ev->type == HP_EV_REL) {
+        if (m->open) e->stats.merged++;
+        m->open = true;
+        switch (ev->code) {
+            case 0: m->dx = sat_add(m->dx, ev->value); break;          // REL_X
+            case 1: m->dy = sat_add(m->dy, ev->value); break;          // REL_Y
+            case 6: m->hwheel = sat_add(m->hwheel, ev->value); break;  // REL_HWHEEL
+            case 8: m->wheel = sat_add(m->wheel, ev->value); break;    // REL_WHEEL
+            case 11:                                                   // REL_WHEEL_HI_RES
+                m->wheel_hr = sat_add(m->wheel_hr, ev->value);
+                m->has_wheel_hr = true;
+                break;
+            case 12:                                                   // REL_HWHEEL_HI_RES
+                m->hwheel_hr = sat_add(m->hwheel_hr, ev->value);
+                m->has_hwheel_hr = true;
+                break;
+        }
+    } else if (ev->type == HP_EV_KEY) {
+        // Motion before a key or button change reaches the host before it
+        close_motion(e, m, n);
+        rx_action *a = next_action(e, n);
+        if (a) *a = (rx_action){RX_ACT_KEY, ev->code, ev->value, 0, 0, 0, 0};
+    }
+}
+
+int rx_engine_decode(rx_engine *e, const char *data, size_t len) {
+    motion_accum m;
+    memset(&m, 0, sizeof(m));
+    size_t n = 0;
+    hp_event ev;
+    bool malformed;
+
+    if (!hp_is_binary(data, len)) {
+        // Legacy text format, every record in the datagram
+        hp_text_reader t;
+        hp_text_init(&t, data, len);
+        while (hp_text_next(&t, &ev) > 0) add_event(e, &ev, &m, &n);
+        malformed = t.errors || t.ignored;
+    } else {
+        hp_reader r;
+        int rc = hp_reader_init(&r, data, len);
+        if (rc == 0) {
+            // Snapshots and repeated transitions need sequence tracking; skip them
+            while ((rc = hp_next(&r, &ev)) > 0) {
+                if (ev.type == HP_EV_KEY || ev.type == HP_EV_REL) add_event(e, &ev, &m, &n);
+            }
+        }
+        malformed = rc < 0;
+    }
+    close_motion(e, &m, &n);
+
+    if (n == 0 && malformed) {
+        e->stats.malformed++;
+        return -1;
+    }
+    return (int)n;
+}
+
+static void print_action(const rx_action *a) {
+    if (a->type == RX_ACT_KEY) printf("key %u %d\n", a->code, (int)a->value);
+    else printf("motion %d %d wheel %d %d\n", (int)a->dx, (int)a->dy, (int)a->wheel, (int)a->hwheel);
+}
+
+int rx_engine_datagram(rx_engine *e, const char *data, size_t len) {
+    e->stats.datagrams++;
+    int n = rx_engine_decode(e, data, len);
+    if (n <= 0) return n;
+
+    if (e->verbose) {
+        for (int i = 0; i < n; i++) print_action(&e->batch[i]);
+        fflush(stdout);
+    }
+    size_t done = e->sink.inject(e->sink.ctx, e->batch, (size_t)n);
+    e->stats.batches++;
+    e->stats.actions += (uint32_t)n;
+    if (done < (size_t)n) e->stats.rejected += (uint32_t)((size_t)n - done);
+    return n;
+}
+
+// ───────────────────────────────
+// UDP receive loop and stats channel
+// ───────────────────────────────
+static void put_counter(hs_writer *w, uint8_t id, uint32_t value) {
+    hs_put_u8(w, id);
+    hs_put_u32(w, value);
+}
+
+static void answer_stats(const rx_engine *e, rx_socket fd) {
+    uint8_t req;
+    struct sockaddr_in from;
+    socklen_t flen = sizeof(from);
+    if (recvfrom(fd, (char *)&req, 1, 0, (struct sockaddr *)&from, &flen) < 0) return;
+
+    const rx_stats *s = &e->stats;
+    uint8_t reply[HS_MAX_REPLY];
+    hs_writer w;
+    hs_writer_init(&w, reply, sizeof(reply));
+    hs_begin_section(&w, HS_SEC_COUNTERS);
+    put_counter(&w, HS_CTR_UDP_RX, s->datagrams);
+    put_counter(&w, HS_CTR_PACKETS, s->datagrams - s->malformed);
+    put_counter(&w, HS_CTR_PARSE_ERRORS, s->malformed);
+    put_counter(&w, HS_CTR_QUEUE_TRUNCATED, s->truncated);
+    put_counter(&w, HS_CTR_REPORTS_SENT, s->actions - s->rejected);
+    hs_end_section(&w);
+    size_t len = hs_writer_finish(&w);
+    if (len > 0) sendto(fd, (const char *)reply, (int)len, 0, (struct sockaddr *)&from, flen);
+}
+
+// Receive failures that concern one datagram (or none): a signal, an ICMP
+// port-unreachable reported on the socket, a spurious wakeup
+static bool transient_error(int err) {
+#ifdef _WIN32
+    return err == WSAEINTR || err == WSAECONNRESET || err == WSAEWOULDBLOCK;
+#else
+    return err == EINTR || err == ECONNREFUSED || err == EAGAIN || err == EWOULDBLOCK;
+#endif
+}
+
+static rx_socket bind_udp(uint16_t port) {
+    rx_socket fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (fd == RX_NO_SOCKET) {
+        perror("socket");
+        return RX_NO_SOCKET;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "bind to port %u failed\n", port);
+        rx_close(fd);
+        return RX_NO_SOCKET;
+    }
+    return fd;
+}
+
+int rx_engine_serve(rx_engine *e, uint16_t port, uint16_t stats_port) {
+    rx_socket fd = bind_udp(port);
+    if (fd == RX_NO_SOCKET) return -1;
+    rx_socket stats_fd = bind_udp(stats_port);
+    if (stats_fd == RX_NO_SOCKET) {
+        rx_close(fd);
+        return -1;
+    }
+    int maxfd = (int)(fd > stats_fd ? fd : stats_fd);
+
+    // One byte more than the largest datagram tells truncation apart
+    char buf[RX_MAX_DATAGRAM + 1];
+    int rc = 0;
+    while (rc == 0 && !atomic_load(&e->stop)) {
+        fd_set set;
+        FD_ZERO(&set);
+        FD_SET(fd, &set);
+        FD_SET(stats_fd, &set);
+        struct timeval tv = {0, RX_STOP_POLL_MS * 1000};
+        int ready = select(maxfd + 1, &set, NULL, NULL, &tv);
+        if (ready < 0 && !transient_error(rx_errno())) {
+            perror("select");
+            rc = -1;
+        }
+        if (ready <= 0) continue;
+        if (FD_ISSET(stats_fd, &set)) answer_stats(e, stats_fd);
+        if (!FD_ISSET(fd, &set)) continue;
+
+        int len = (int)recv(fd, buf, (int)sizeof(buf), 0);
+        if (len < 0) {
+            int err = rx_errno();
+            if (err == RX_EMSGSIZE) {
+                len = (int)sizeof(buf);     // Winsock: filled the buffer, dropped the rest
+            } else if (transient_error(err)) {
+                e->stats.rx_errors++;       // lost that datagram, not the socket
+                continue;
+            } else {
+                fprintf(stderr, "recv failed: %d\n", err);
+                rc = -1;
+                continue;
+            }
+        }
+        if (len == 0) continue;
+        if (len > RX_MAX_DATAGRAM) {
+            e->stats.truncated++;
+            len = RX_MAX_DATAGRAM;
+        }
+        if (rx_engine_datagram(e, buf, (size_t)len) < 0 && e->verbose)
+            fprintf(stderr, "Failed to parse datagram (%d bytes)\n", len);
+    }
+    rx_close(stats_fd);
+    rx_close(fd);
+    return rc;
+}
@@ -0,0 +1,91 @@
+#ifndef RECEIVE_ENGINE_H
+#define RECEIVE_ENGINE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ───────────────────────────────
+// Host-side receive engine
+// ───────────────────────────────
+// Shared by windows_server (SendInput) and linux_server (uinput). Every
+// record of a datagram (binary or legacy text) is decoded. Relative motion
+// between key/button changes is merged into one motion action. The whole
+// datagram then goes to the sink as one ordered batch.
+
+#define RX_DEFAULT_PORT 50037
+#define RX_MAX_DATAGRAM 1024   // pi_client MAX_PACKET_LEN
+#define RX_MAX_ACTIONS  256    // per datagram
+#define RX_WHEEL_UNIT   120    // wheel steps per detent (WHEEL_DELTA, REL_WHEEL_HI_RES)
+
+enum {
+    RX_ACT_KEY,      // code: Linux KEY_* / BTN_* code, value: 0 up, 1 down, 2 repeat
+    RX_ACT_MOTION,   // dx, dy in counts; wheel, hwheel in RX_WHEEL_UNIT per detent
+};
+
+typedef struct {
+    uint8_t type;    // RX_ACT_*
+    uint16_t code;
+    int32_t value;
+    int32_t dx, dy, wheel, hwheel;
+} rx_action;
+
+// Injects one datagram's actions, in order. Returns how many took effect.
+typedef size_t (*rx_inject_fn)(void *ctx, const rx_action *actions, size_t n);
+
+typedef struct {
+    rx_inject_fn inject;
+    void *ctx;
+} rx_sink;
+
+typedef struct {
+    uint32_t datagrams;     // handed to the engine
+    uint32_t truncated;     // received datagrams longer than RX_MAX_DATAGRAM
+    uint32_t rx_errors;     // receives that failed for one datagram only
+    uint32_t malformed;     // datagrams that decoded to nothing usable
+    uint32_t events;        // input records decoded
+    uint32_t merged;        // motion records folded into an earlier action
+    uint32_t overflow;      // records dropped past RX_MAX_ACTIONS
+    uint32_t batches;       // sink calls
+    uint32_t actions;       // actions handed to the sink
+    uint32_t rejected;      // actions the sink could not inject
+} rx_stats;
+
+typedef struct {
+    rx_sink sink;
+    bool verbose;           // print every action before it is injected
+    atomic_bool stop;       // set by rx_engine_stop()
+    rx_stats stats;
+    rx_action batch[RX_MAX_ACTIONS];
+} rx_engine;
+
+void rx_engine_init(rx_engine *e, const rx_sink *sink);
+
+// Decodes a datagram into e->batch. Returns the number of actions, or -1 if
+// the datagram is malformed and yields nothing.
+int rx_engine_decode(rx_engine *e, const char *data, size_t len);
+
+// Decodes a datagram and hands the batch to the sink (not called for an
+// empty batch). Returns the number of actions, or -1 if malformed.
+int rx_engine_datagram(rx_engine *e, const char *data, size_t len);
+
+// Receives on UDP port and answers stats requests (hid_stats.h counters)
+// on stats_port. Oversize datagrams are decoded up to RX_MAX_DATAGRAM and
+// counted; a receive error that only loses one datagram is counted and
+// skipped. Windows callers run WSAStartup first. Returns 0 once stopped,
+// -1 if the sockets cannot be set up or the socket fails.
+int rx_engine_serve(rx_engine *e, uint16_t port, uint16_t stats_port);
+
+// Makes rx_engine_serve() return within about 100 ms; callable from any thread
+void rx_engine_stop(rx_engine *e);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RECEIVE_ENGINE_H